@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "scpi.h"
+
+// Numeric argument conversion benchmark.
+// Compares the library conversions with sscanf(), and measures a whole
+// command with numeric arguments through scpi_handle_buffer() - converted,
+// or forwarded as text with .lazy_args.
+
+#define ROUNDS 200000
+
+static const char *floats[] = {
+	"50", "1.0", "2.17", "-0.125", "1.5E-3", "3.3", "1000", "12.345678", "6.02E23", "0.001"
+};
+
+#define FLOAT_COUNT (sizeof(floats) / sizeof(floats[0]))
+
+static const char *ints[] = {
+	"0", "1", "-1", "36", "255", "1000", "-32768", "65535", "123456789", "-2147483648"
+};
+
+#define INT_COUNT (sizeof(ints) / sizeof(ints[0]))
+
+static volatile float fsink;
+static volatile double dsink;
+static volatile int32_t isink;
+
+static scpi_ctx_t session;
+
+static double now_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void report(const char *what, double ns, double count)
+{
+	printf("args     %-32s %8.1f ns\n", what, ns / count);
+}
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	const double n = (double)ROUNDS * FLOAT_COUNT;
+	float f;
+	double d;
+	int32_t i32;
+
+	double t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < FLOAT_COUNT; i++) {
+			sscanf(floats[i], "%f", &f);
+			fsink = f;
+		}
+	}
+	report("sscanf(\"%f\")", now_ns() - t0, n);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < FLOAT_COUNT; i++) {
+			scpi_parse_float(floats[i], &f);
+			fsink = f;
+		}
+	}
+	report("scpi_parse_float()", now_ns() - t0, n);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < FLOAT_COUNT; i++) {
+			sscanf(floats[i], "%lf", &d);
+			dsink = d;
+		}
+	}
+	report("sscanf(\"%lf\")", now_ns() - t0, n);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < FLOAT_COUNT; i++) {
+			scpi_parse_double(floats[i], &d);
+			dsink = d;
+		}
+	}
+	report("scpi_parse_double()", now_ns() - t0, n);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < FLOAT_COUNT; i++) {
+			scpi_parse_fixed(floats[i], SCPI_FIXED_Q(8), &i32);
+			isink = i32;
+		}
+	}
+	report("scpi_parse_fixed(Q8)", now_ns() - t0, n);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < INT_COUNT; i++) {
+			sscanf(ints[i], "%" SCNd32, &i32);
+			isink = i32;
+		}
+	}
+	report("sscanf(\"%d\")", now_ns() - t0, (double)ROUNDS * INT_COUNT);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < INT_COUNT; i++) {
+			scpi_parse_int(ints[i], &i32);
+			isink = i32;
+		}
+	}
+	report("scpi_parse_int()", now_ns() - t0, (double)ROUNDS * INT_COUNT);
+
+	static const char cmd[] = "APPL:SIN 50, 1.0, 2.17\n";
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		scpi_handle_buffer(&session, (const uint8_t *) cmd, sizeof(cmd) - 1);
+	}
+	report("command \"APPL:SIN 50, 1.0, 2.17\"", now_ns() - t0, ROUNDS);
+
+	static const char fwd[] = "FWD:EAG 1.5E-3, 2.17, 6.02E23, 12.345678\n";
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		scpi_handle_buffer(&session, (const uint8_t *) fwd, sizeof(fwd) - 1);
+	}
+	report("forward 4 DOUBLE args, converted", now_ns() - t0, ROUNDS);
+
+	static const char fwd_lazy[] = "FWD:LAZY 1.5E-3, 2.17, 6.02E23, 12.345678\n";
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		scpi_handle_buffer(&session, (const uint8_t *) fwd_lazy, sizeof(fwd_lazy) - 1);
+	}
+	report("forward 4 DOUBLE args, lazy (raw)", now_ns() - t0, ROUNDS);
+
+	return 0;
+}
+
+
+// ---- stubs ----
+
+static void cmd_appl_sin(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	fsink = args[1].FLOAT + args[2].FLOAT;
+}
+
+static volatile size_t fwd_sink;
+
+static void cmd_fwd_eager(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	dsink = args[0].DOUBLE + args[1].DOUBLE + args[2].DOUBLE + args[3].DOUBLE;
+}
+
+static void cmd_fwd_lazy(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)args;
+	for (uint8_t i = 0; i < 4; i++) {
+		fwd_sink = strlen(scpi_arg_raw(ctx, i)); // passed on as text
+	}
+}
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"APPLy", "SINe"},
+		.params = {SCPI_DT_FLOAT, SCPI_DT_FLOAT, SCPI_DT_FLOAT},
+		.callback = cmd_appl_sin
+	},
+	{
+		.levels = {"FWD", "EAGer"},
+		.params = {SCPI_DT_DOUBLE, SCPI_DT_DOUBLE, SCPI_DT_DOUBLE, SCPI_DT_DOUBLE},
+		.callback = cmd_fwd_eager
+	},
+	{
+		.levels = {"FWD", "LAZY"},
+		.params = {SCPI_DT_DOUBLE, SCPI_DT_DOUBLE, SCPI_DT_DOUBLE, SCPI_DT_DOUBLE},
+		.callback = cmd_fwd_lazy,
+		.lazy_args = true
+	},
+	{/*END*/}
+};
+
+const char *scpi_eol = "\r\n";
+
+const SCPI_error_desc scpi_user_errors[] = {
+	{/*END*/}
+};
+
+void scpi_send_byte_impl(scpi_ctx_t *ctx, uint8_t b)
+{
+	(void)ctx;
+	(void)b;
+}
+
+const char *scpi_user_IDN(scpi_ctx_t *ctx)
+{
+	(void)ctx;
+	return "bench";
+}
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "scpi.h"
+
+// Command lookup benchmark.
+// Sends every header of a synthetic command table (see mkcmds.py) and reports
+// the mean time per command. Built once per lookup method - see the Makefile.
+
+#ifndef BENCH_METHOD
+#define BENCH_METHOD "?"
+#endif
+
+#define BENCH_TOTAL_CMDS 300000
+
+extern const char *bench_headers[];
+
+static volatile uint32_t cb_count;
+
+static scpi_ctx_t session;
+
+void bench_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	(void)args;
+	cb_count++;
+}
+
+int main(void)
+{
+	uint32_t n = 0;
+	while (bench_headers[n] != NULL) n++;
+
+	if (!scpi_init()) { // builds the automaton, if used
+		fprintf(stderr, "%s: %u commands don't fit in the automaton\n", BENCH_METHOD, (unsigned)n);
+		return 1;
+	}
+
+	scpi_ctx_init(&session, NULL);
+
+	// warm up
+	for (uint32_t i = 0; i < n; i++) {
+		scpi_handle_string(&session, bench_headers[i]);
+	}
+
+	if (cb_count != n) {
+		fprintf(stderr, "%s: only %u of %u commands matched\n", BENCH_METHOD, (unsigned)cb_count, (unsigned)n);
+		return 1;
+	}
+
+	const uint32_t rounds = BENCH_TOTAL_CMDS / n;
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for (uint32_t r = 0; r < rounds; r++) {
+		for (uint32_t i = 0; i < n; i++) {
+			scpi_handle_string(&session, bench_headers[i]);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	const double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+	printf("%-8s %5u commands: %8.1f ns/command", BENCH_METHOD, (unsigned)n, ns / ((double)rounds * n));
+
+	if (scpi_cmd_index_nodes() > 0) {
+		printf(", %u automaton nodes", (unsigned)scpi_cmd_index_nodes());
+	}
+
+	printf("\n");
+
+	return 0;
+}
+
+
+// ---- stubs ----
+
+const char *scpi_eol = "\r\n";
+
+const SCPI_error_desc scpi_user_errors[] = {
+	{/*END*/}
+};
+
+void scpi_send_byte_impl(scpi_ctx_t *ctx, uint8_t b)
+{
+	(void)ctx;
+	(void)b;
+}
+
+const char *scpi_user_IDN(scpi_ctx_t *ctx)
+{
+	(void)ctx;
+	return "bench";
+}
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scpi.h"
+
+// Block data CRC benchmark.
+// Reports throughput of scpi_crc32c() alone, and of receiving a block
+// through scpi_handle_buffer() with and without the CRC enabled.
+
+#ifndef BENCH_METHOD
+#define BENCH_METHOD "?"
+#endif
+
+#define DATA_LEN (1024 * 1024)
+#define PACKET_LEN 4096
+#define ROUNDS 64
+
+static uint8_t data[DATA_LEN];
+static uint8_t message[DATA_LEN + 32];
+static size_t message_len;
+
+static volatile uint32_t sink;
+
+static scpi_ctx_t session;
+
+static double now_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void report(const char *what, double ns)
+{
+	const double mb = (double)DATA_LEN * ROUNDS / (1024 * 1024);
+	printf("%-8s %-22s %8.1f MB/s\n", BENCH_METHOD, what, mb / (ns / 1e9));
+}
+
+static void send_block(const char *header)
+{
+	// header + #7<len><data> + newline
+	message_len = (size_t)sprintf((char *)message, "%s #7%07u", header, DATA_LEN);
+	memcpy(message + message_len, data, DATA_LEN);
+	message_len += DATA_LEN;
+	message[message_len++] = '\n';
+
+	for (size_t i = 0; i < message_len; i += PACKET_LEN) {
+		const size_t n = (message_len - i < PACKET_LEN) ? message_len - i : PACKET_LEN;
+		scpi_handle_buffer(&session, message + i, n);
+	}
+}
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	for (size_t i = 0; i < DATA_LEN; i++) {
+		data[i] = (uint8_t) rand();
+	}
+
+	double t0 = now_ns();
+	uint32_t crc = 0;
+	for (int r = 0; r < ROUNDS; r++) {
+		crc = scpi_crc32c(crc, data, DATA_LEN);
+	}
+	sink = crc;
+	report("scpi_crc32c()", now_ns() - t0);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		send_block("DATA:PLAIN");
+	}
+	report("block, no CRC", now_ns() - t0);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		send_block("DATA:CRC");
+	}
+	report("block with CRC", now_ns() - t0);
+
+	return 0;
+}
+
+
+// ---- stubs ----
+
+static void block_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	(void)args;
+}
+
+static void block_data(scpi_ctx_t *ctx, const uint8_t *bytes, size_t len, uint32_t offset)
+{
+	(void)ctx;
+	(void)offset;
+	sink += bytes[len - 1];
+}
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"DATA", "PLAIN"},
+		.params = {SCPI_DT_BLOB},
+		.callback = block_cb,
+		.blob_data_callback = block_data
+	},
+	{
+		.levels = {"DATA", "CRC"},
+		.params = {SCPI_DT_BLOB},
+		.callback = block_cb,
+		.blob_data_callback = block_data,
+		.blob_crc = SCPI_CRC_COMPUTE
+	},
+	{/*END*/}
+};
+
+const char *scpi_eol = "\r\n";
+
+const SCPI_error_desc scpi_user_errors[] = {
+	{/*END*/}
+};
+
+void scpi_send_byte_impl(scpi_ctx_t *ctx, uint8_t b)
+{
+	(void)ctx;
+	(void)b;
+}
+
+const char *scpi_user_IDN(scpi_ctx_t *ctx)
+{
+	(void)ctx;
+	return "bench";
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "scpi.h"
+#include "scpi_engine.h"
+
+// Session engine benchmark.
+// One thread submits a command script to many sessions, the engine runs them
+// on 1, 2, 4... worker threads. Reports commands per second for each count.
+//
+// Usage: engine.elf [max_threads], default is the number of CPUs.
+
+#define SESSIONS 1024
+#define ROUNDS 200
+
+// 8 commands
+static const char script[] =
+	"SOUR:VOLT 1.25\n"
+	"SOUR:CURR 0.5\n"
+	"OUTP:STAT 1\n"
+	"MEAS:VOLT?\n"
+	"MEAS:CURR?\n"
+	"*STB?\n"
+	"SYST:ERR:COUNT?\n"
+	"*OPC?\n";
+
+#define SCRIPT_CMDS 8
+
+/** Per-session data, each on its own cache line */
+typedef struct {
+	uint64_t commands; // callbacks of the custom commands
+	uint64_t out_bytes;
+} __attribute__((aligned(SCPI_ENGINE_CACHE_LINE))) bench_user_t;
+
+static scpi_engine_session_t *sessions;
+static bench_user_t users[SESSIONS];
+
+static double now_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static double run(uint16_t threads)
+{
+	scpi_engine_t eng;
+
+	if (!scpi_engine_start(&eng, threads, true)) {
+		fprintf(stderr, "engine start failed\n");
+		exit(1);
+	}
+
+	memset(users, 0, sizeof(users));
+	for (int i = 0; i < SESSIONS; i++) {
+		scpi_engine_session_init(&eng, &sessions[i], &users[i]);
+	}
+
+	const double t0 = now_ns();
+
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < SESSIONS; i++) {
+			const uint8_t *p = (const uint8_t *)script;
+			size_t left = sizeof(script) - 1;
+
+			while (left > 0) {
+				size_t n = scpi_engine_submit(&eng, &sessions[i], p, left);
+				if (n == 0) sched_yield(); // session input full
+				p += n;
+				left -= n;
+			}
+		}
+	}
+
+	for (int i = 0; i < SESSIONS; i++) {
+		while (!scpi_engine_session_idle(&sessions[i])) {
+			sched_yield();
+		}
+	}
+
+	const double ns = now_ns() - t0;
+
+	scpi_engine_stop(&eng);
+
+	uint64_t commands = 0;
+	for (int i = 0; i < SESSIONS; i++) {
+		commands += users[i].commands;
+	}
+
+	if (commands != (uint64_t)SESSIONS * ROUNDS * 5) {
+		fprintf(stderr, "lost commands: %llu\n", (unsigned long long)commands);
+		exit(1);
+	}
+
+	return (double)SESSIONS * ROUNDS * SCRIPT_CMDS / (ns / 1e9);
+}
+
+int main(int argc, char **argv)
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	long max_threads = (argc > 1) ? atol(argv[1]) : ncpu;
+	if (max_threads < 1) max_threads = 1;
+
+	sessions = aligned_alloc(SCPI_ENGINE_CACHE_LINE, SESSIONS * sizeof(scpi_engine_session_t));
+	if (sessions == NULL) return 1;
+
+	printf("engine   %d sessions, %ld CPUs\n", SESSIONS, ncpu);
+
+	for (long t = 1; ; t *= 2) {
+		if (t > max_threads) t = max_threads;
+
+		printf("engine   %2ld threads %12.0f cmd/s\n", t, run((uint16_t)t));
+
+		if (t == max_threads) break;
+	}
+
+	free(sessions);
+	return 0;
+}
+
+
+// ---- stubs ----
+
+static void cmd_set_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)args;
+	((bench_user_t *)ctx->user)->commands++;
+}
+
+static void cmd_meas_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)args;
+	((bench_user_t *)ctx->user)->commands++;
+	scpi_send_string(ctx, "1.2500");
+}
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"SOURce", "VOLTage"},
+		.params = {SCPI_DT_FLOAT},
+		.callback = cmd_set_cb
+	},
+	{
+		.levels = {"SOURce", "CURRent"},
+		.params = {SCPI_DT_FLOAT},
+		.callback = cmd_set_cb
+	},
+	{
+		.levels = {"OUTPut", "STATe"},
+		.params = {SCPI_DT_BOOL},
+		.callback = cmd_set_cb
+	},
+	{
+		.levels = {"MEASure", "VOLTage?"},
+		.callback = cmd_meas_cb
+	},
+	{
+		.levels = {"MEASure", "CURRent?"},
+		.callback = cmd_meas_cb
+	},
+	{/*END*/}
+};
+
+const char *scpi_eol = "\r\n";
+
+const SCPI_error_desc scpi_user_errors[] = {
+	{/*END*/}
+};
+
+void scpi_send_iov_impl(scpi_ctx_t *ctx, const scpi_iovec_t *iov, uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++) {
+		((bench_user_t *)ctx->user)->out_bytes += iov[i].len;
+	}
+}
+
+const char *scpi_user_IDN(scpi_ctx_t *ctx)
+{
+	(void)ctx;
+	return "bench";
+}
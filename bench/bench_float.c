@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scpi.h"
+
+// Float response formatting benchmark.
+// Compares scpi_resp_double() / scpi_resp_float() with snprintf().
+
+#define COUNT 100000
+#define ROUNDS 10
+
+static double dvals[COUNT];
+static float fvals[COUNT];
+
+static volatile size_t sink;
+
+static scpi_ctx_t session;
+
+static double now_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void report(const char *what, double ns)
+{
+	printf("float    %-28s %8.1f ns/value\n", what, ns / ((double)COUNT * ROUNDS));
+}
+
+int main(void)
+{
+	char buf[64];
+
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	// measurement-like values, 1e-6 .. 1e6
+	for (int i = 0; i < COUNT; i++) {
+		double v = (rand() / (double)RAND_MAX) * 10.0;
+		for (int e = rand() % 13 - 6; e > 0; e--) v *= 10;
+		for (int e = rand() % 13 - 6; e < 0; e++) v /= 10;
+		if (rand() & 1) v = -v;
+
+		dvals[i] = v;
+		fvals[i] = (float) v;
+	}
+
+	double t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < COUNT; i++) {
+			scpi_resp_double(&session, dvals[i]);
+		}
+		scpi_send_flush(&session);
+	}
+	report("scpi_resp_double()", now_ns() - t0);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < COUNT; i++) {
+			sink += (size_t) snprintf(buf, sizeof(buf), "%.17g", dvals[i]);
+		}
+	}
+	report("snprintf(\"%.17g\", double)", now_ns() - t0);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < COUNT; i++) {
+			sink += (size_t) snprintf(buf, sizeof(buf), "%g", dvals[i]);
+		}
+	}
+	report("snprintf(\"%g\", double)", now_ns() - t0);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < COUNT; i++) {
+			scpi_resp_float(&session, fvals[i]);
+		}
+		scpi_send_flush(&session);
+	}
+	report("scpi_resp_float()", now_ns() - t0);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < COUNT; i++) {
+			sink += (size_t) snprintf(buf, sizeof(buf), "%.9g", fvals[i]);
+		}
+	}
+	report("snprintf(\"%.9g\", float)", now_ns() - t0);
+
+	scpi_resp_set_digits(&session, 6);
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < COUNT; i++) {
+			scpi_resp_double(&session, dvals[i]);
+		}
+		scpi_send_flush(&session);
+	}
+	report("scpi_resp_double(), 6 digits", now_ns() - t0);
+
+	t0 = now_ns();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < COUNT; i++) {
+			sink += (size_t) snprintf(buf, sizeof(buf), "%.5E", dvals[i]);
+		}
+	}
+	report("snprintf(\"%.5E\", double)", now_ns() - t0);
+
+	return 0;
+}
+
+
+// ---- stubs ----
+
+const SCPI_command_t scpi_commands[] = {
+	{/*END*/}
+};
+
+const char *scpi_eol = "\r\n";
+
+const SCPI_error_desc scpi_user_errors[] = {
+	{/*END*/}
+};
+
+void scpi_send_buf_impl(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+	(void)ctx;
+	sink += buf[len - 1];
+}
+
+const char *scpi_user_IDN(scpi_ctx_t *ctx)
+{
+	(void)ctx;
+	return "bench";
+}
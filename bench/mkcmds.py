@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+"""
+Write a synthetic command table with N commands for the lookup benchmark.
+
+Usage: mkcmds.py N > cmds_N.c
+"""
+
+import sys
+
+n = int(sys.argv[1])
+
+subsystems = ['SOURce', 'SENSe', 'OUTPut', 'TRIGger', 'MEASure', 'CALibrate', 'DISPlay', 'ROUTe']
+nodes = ['VOLTage', 'CURRent', 'FREQuency', 'PHASe', 'POWer', 'RANGe', 'LEVel', 'MODE']
+leaves = ['AMPLitude', 'OFFSet', 'LIMit', 'DELay', 'STATe', 'COUNt?']
+
+cmds = []
+for i in range(n):
+	# two or three levels, numbered subsystem so the table has no duplicates
+	sub = '%s%d' % (subsystems[i % len(subsystems)], i // 48)
+	node = nodes[(i // len(subsystems)) % len(nodes)]
+	if i % 3 == 0:
+		cmds.append((sub, node))
+	else:
+		cmds.append((sub, node, leaves[i % len(leaves)]))
+
+print('// Generated by mkcmds.py, %d commands' % n)
+print('#include <stddef.h>')
+print('#include "scpi.h"')
+print('')
+print('void bench_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args);')
+print('')
+print('const SCPI_command_t scpi_commands[] = {')
+for c in cmds:
+	print('\t{.levels = {%s}, .callback = bench_cb},' % ', '.join('"%s"' % l for l in c))
+print('\t{/*END*/}')
+print('};')
+print('')
+
+# headers to send - alternating short and long form
+print('const char *bench_headers[] = {')
+for i, c in enumerate(cmds):
+	if i % 2:
+		hdr = ':'.join(l.upper() for l in c)
+	else:
+		hdr = ':'.join(''.join(ch for ch in l if not ch.islower()) for l in c)
+	print('\t"%s\\n",' % hdr)
+print('\tNULL')
+print('};')
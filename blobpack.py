@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""
+Block data compressor for commands with blob_codec set.
+
+Compresses a file with PackBits RLE (SCPI_CODEC_RLE) or to a LZ4 block
+(SCPI_CODEC_LZ4). LZ4 match offsets are limited to the window size, which must
+not be larger than SCPI_BLOB_WINDOW of the device. The output is a valid LZ4
+block, but blocks from other LZ4 compressors use offsets up to 64 KiB.
+
+With -b the result is wrapped in a definite length block header (#nLEN...),
+ready to be sent after the command header.
+
+Usage: blobpack.py [-c rle|lz4] [-w 1024] [-b] [-d] input output
+"""
+
+import sys
+import argparse
+
+MIN_MATCH = 4
+LAST_LITERALS = 5 # LZ4 block: last 5 bytes are always literals
+MF_LIMIT = 12 # LZ4 block: no match starts in the last 12 bytes
+
+
+def rle_encode(data):
+	out = bytearray()
+	lit = bytearray()
+	i = 0
+	n = len(data)
+
+	def flush_literals():
+		for j in range(0, len(lit), 128):
+			part = lit[j:j + 128]
+			out.append(len(part) - 1)
+			out.extend(part)
+		lit.clear()
+
+	while i < n:
+		run = 1
+		while i + run < n and run < 128 and data[i + run] == data[i]:
+			run += 1
+
+		if run >= 3 or (run == 2 and not lit):
+			flush_literals()
+			out.append(257 - run)
+			out.append(data[i])
+			i += run
+		else:
+			lit.append(data[i])
+			i += 1
+
+	flush_literals()
+	return bytes(out)
+
+
+def rle_decode(data):
+	out = bytearray()
+	i = 0
+	while i < len(data):
+		h = data[i]
+		i += 1
+		if h < 128:
+			out.extend(data[i:i + h + 1])
+			i += h + 1
+		elif h > 128:
+			out.extend(data[i:i + 1] * (257 - h))
+			i += 1
+	return bytes(out)
+
+
+def lz4_length(out, n):
+	while n >= 255:
+		out.append(255)
+		n -= 255
+	out.append(n)
+
+
+def lz4_sequence(out, literals, offset, match_len):
+	lit_len = len(literals)
+	token = min(lit_len, 15) << 4
+	if match_len:
+		token |= min(match_len - MIN_MATCH, 15)
+	out.append(token)
+
+	if lit_len >= 15:
+		lz4_length(out, lit_len - 15)
+	out.extend(literals)
+
+	if match_len:
+		out.append(offset & 0xFF)
+		out.append(offset >> 8)
+		if match_len - MIN_MATCH >= 15:
+			lz4_length(out, match_len - MIN_MATCH - 15)
+
+
+def lz4_encode(data, window):
+	out = bytearray()
+	n = len(data)
+	last = {} # 4-byte sequence -> list of recent positions
+	anchor = 0
+	i = 0
+
+	while i + MF_LIMIT <= n:
+		key = data[i:i + MIN_MATCH]
+		best_len = 0
+		best_pos = 0
+
+		for pos in reversed(last.get(key, ())):
+			if i - pos > window:
+				break
+
+			length = MIN_MATCH
+			while i + length < n - LAST_LITERALS and data[pos + length] == data[i + length]:
+				length += 1
+
+			if length > best_len:
+				best_len = length
+				best_pos = pos
+
+		last.setdefault(key, []).append(i)
+		if len(last[key]) > 16:
+			del last[key][0]
+
+		if best_len < MIN_MATCH:
+			i += 1
+			continue
+
+		lz4_sequence(out, data[anchor:i], i - best_pos, best_len)
+
+		for j in range(i + 1, min(i + best_len, n - MIN_MATCH)):
+			last.setdefault(data[j:j + MIN_MATCH], []).append(j)
+
+		i += best_len
+		anchor = i
+
+	lz4_sequence(out, data[anchor:], 0, 0)
+	return bytes(out)
+
+
+def lz4_decode(data):
+	out = bytearray()
+	i = 0
+	while i < len(data):
+		token = data[i]
+		i += 1
+
+		lit_len = token >> 4
+		if lit_len == 15:
+			while True:
+				b = data[i]
+				i += 1
+				lit_len += b
+				if b != 255:
+					break
+		out.extend(data[i:i + lit_len])
+		i += lit_len
+
+		if i >= len(data):
+			break
+
+		offset = data[i] | (data[i + 1] << 8)
+		i += 2
+
+		match_len = (token & 15) + MIN_MATCH
+		if match_len == 15 + MIN_MATCH:
+			while True:
+				b = data[i]
+				i += 1
+				match_len += b
+				if b != 255:
+					break
+
+		for _ in range(match_len):
+			out.append(out[-offset])
+
+	return bytes(out)
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Compress block data for SCPI_CODEC_RLE / SCPI_CODEC_LZ4 commands')
+	parser.add_argument('-c', '--codec', choices=('rle', 'lz4'), default='lz4')
+	parser.add_argument('-w', '--window', type=int, default=1024, help='LZ4 window, max. SCPI_BLOB_WINDOW')
+	parser.add_argument('-b', '--block', action='store_true', help='add a #nLEN block header')
+	parser.add_argument('-d', '--decompress', action='store_true', help='decompress instead')
+	parser.add_argument('input')
+	parser.add_argument('output')
+	args = parser.parse_args()
+
+	if not 1 <= args.window <= 65535:
+		sys.exit('Window must be 1..65535 bytes')
+
+	with open(args.input, 'rb') as f:
+		data = f.read()
+
+	if args.decompress:
+		result = rle_decode(data) if args.codec == 'rle' else lz4_decode(data)
+	else:
+		result = rle_encode(data) if args.codec == 'rle' else lz4_encode(data, args.window)
+
+		if args.block:
+			digits = str(len(result))
+			if len(digits) > 9:
+				sys.exit('Too long for a definite length block')
+			result = ('#%d%s' % (len(digits), digits)).encode() + result
+
+		sys.stderr.write('%d -> %d bytes\n' % (len(data), len(result)))
+
+	with open(args.output, 'wb') as f:
+		f.write(result)
+
+
+if __name__ == '__main__':
+	main()
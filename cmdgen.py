@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""
+Command index generator.
+
+Reads SCPI_command_t arrays (scpi_commands, scpi_commands_builtin) from C sources
+and writes a C file with a const minimal perfect hash table of all header paths.
+Compile the result with the library and -DSCPI_CMD_INDEX to use it instead of
+the startup automaton.
+
+Keys are normalized header paths - uppercase short and long forms of every level,
+joined by colons (eg. "SYST:ERR:NEXT?", "SYSTEM:ERROR:NEXT?"). Prefixes of longer
+commands are included too, flagged as partial (needed to accept the colon).
+
+Limitations: entries are read from the source text, so commands hidden behind
+#ifdef or built by macros are not seen.
+
+Usage: cmdgen.py [-o scpi_cmd_index.c] source.c [source.c ...]
+"""
+
+import re
+import sys
+import argparse
+
+ARRAYS = ('scpi_commands', 'scpi_commands_builtin')
+
+
+def strip_comments(src):
+	# keep string literals intact
+	pattern = re.compile(r'//[^\n]*|/\*.*?\*/|"(?:\\.|[^"\\])*"|\'(?:\\.|[^\'\\])*\'', re.S)
+	return pattern.sub(lambda m: m.group(0) if m.group(0)[0] in '"\'' else ' ', src)
+
+
+def split_entries(body):
+	"""Split array initializer body into top-level {...} entries"""
+	entries = []
+	depth = 0
+	start = None
+	in_str = False
+	i = 0
+	while i < len(body):
+		c = body[i]
+		if in_str:
+			if c == '\\':
+				i += 1
+			elif c == '"':
+				in_str = False
+		elif c == '"':
+			in_str = True
+		elif c == '{':
+			if depth == 0:
+				start = i + 1
+			depth += 1
+		elif c == '}':
+			depth -= 1
+			if depth == 0:
+				entries.append(body[start:i])
+			elif depth < 0:
+				break
+		i += 1
+	return entries
+
+
+def entry_levels(entry):
+	"""Get the level strings of a command entry, or None for the end marker"""
+	m = re.search(r'\.levels\s*=\s*\{([^}]*)\}', entry)
+	if m is None:
+		# positional initializer - levels must be first
+		m = re.match(r'\s*\{([^}]*)\}', entry)
+		if m is None:
+			return None
+	levels = re.findall(r'"((?:\\.|[^"\\])*)"', m.group(1))
+	levels = [l for l in levels if l != '']
+	return levels if levels else None
+
+
+def read_arrays(files):
+	arrays = {}
+	for fn in files:
+		with open(fn) as f:
+			src = strip_comments(f.read())
+
+		for m in re.finditer(r'SCPI_command_t\s+(\w+)\s*\[\s*\]\s*=\s*\{', src):
+			name = m.group(1)
+			if name not in ARRAYS:
+				continue
+
+			body = src[m.end():]
+			cmds = []
+			for e in split_entries(body):
+				levels = entry_levels(e)
+				if levels is None:
+					break  # end marker
+				cmds.append(levels)
+
+			arrays[name] = cmds
+	return arrays
+
+
+def level_forms(pattern):
+	"""Short and long form of a level pattern (uppercase)"""
+	short = ''.join(c for c in pattern if not c.islower())
+	long = pattern.upper()
+	forms = [long]
+	if short and short != long:
+		forms.insert(0, short)
+	return forms
+
+
+def hash_path(path, seed):
+	"""FNV-1a with seeded basis and a final mix - must match cmd_path_hash() in scpi_parser.c"""
+	h = (0x811C9DC5 ^ seed) & 0xFFFFFFFF
+	for c in path.encode('ascii'):
+		h ^= c
+		h = (h * 0x01000193) & 0xFFFFFFFF
+	h ^= h >> 16
+	h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+	h ^= h >> 13
+	h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+	h ^= h >> 16
+	return h
+
+
+def collect_keys(arrays):
+	"""Map normalized path -> [command ref or None, partial flag]"""
+	keys = {}
+
+	def add(paths, levels, depth, ref):
+		for form in level_forms(levels[depth]):
+			path = paths + ':' + form if paths else form
+			k = keys.setdefault(path, [None, False])
+			if depth + 1 == len(levels):
+				if k[0] is None:
+					k[0] = ref  # first wins - user commands override built-ins
+			else:
+				k[1] = True
+				add(path, levels, depth + 1, ref)
+
+	# user commands first
+	for name in ARRAYS:
+		for i, levels in enumerate(arrays.get(name, [])):
+			add('', levels, 0, '&%s[%d]' % (name, i))
+
+	return keys
+
+
+def build_mph(paths):
+	"""Hash and displace: returns (displacement table, slot -> path)"""
+	n = len(paths)
+	nbuckets = max(1, (n + 3) // 4)
+
+	buckets = [[] for _ in range(nbuckets)]
+	for p in paths:
+		buckets[hash_path(p, 0) % nbuckets].append(p)
+
+	disp = [0] * nbuckets
+	slots = [None] * n
+
+	for b in sorted(range(nbuckets), key=lambda b: -len(buckets[b])):
+		if not buckets[b]:
+			continue
+
+		for d in range(1, 0x10000):
+			taken = [hash_path(p, d) % n for p in buckets[b]]
+			if len(set(taken)) == len(taken) and all(slots[t] is None for t in taken):
+				break
+		else:
+			sys.exit('cmdgen: failed to build the hash table')
+
+		disp[b] = d
+		for p, t in zip(buckets[b], taken):
+			slots[t] = p
+
+	return disp, slots
+
+
+def c_string(s):
+	return '"' + s.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def main():
+	ap = argparse.ArgumentParser(description='Generate a const perfect hash index of SCPI commands.')
+	ap.add_argument('-o', '--output', default='-', help='output C file (default stdout)')
+	ap.add_argument('sources', nargs='+', help='C files defining the command arrays')
+	args = ap.parse_args()
+
+	arrays = read_arrays(args.sources)
+	for name in ARRAYS:
+		if name not in arrays:
+			sys.exit('cmdgen: %s[] not found in the given sources' % name)
+
+	keys = collect_keys(arrays)
+	paths = sorted(keys)
+	disp, slots = build_mph(paths)
+
+	out = []
+	out.append('// Generated by cmdgen.py from: %s' % ', '.join(args.sources))
+	out.append('// %d commands, %d header paths. Do not edit.' % (sum(len(a) for a in arrays.values()), len(paths)))
+	out.append('')
+	out.append('#include <stdint.h>')
+	out.append('#include <stdbool.h>')
+	out.append('#include <stddef.h>')
+	out.append('')
+	out.append('#include "scpi_parser.h"')
+	out.append('')
+	out.append('static const uint16_t disp[%d] = {' % len(disp))
+	for i in range(0, len(disp), 12):
+		out.append('\t' + ', '.join(str(d) for d in disp[i:i + 12]) + ',')
+	out.append('};')
+	out.append('')
+	out.append('static const SCPI_cmd_index_entry_t entries[%d] = {' % len(slots))
+	for p in slots:
+		ref, partial = keys[p]
+		out.append('\t{%s, %s, %s},' % (c_string(p), ref or 'NULL', 'true' if partial else 'false'))
+	out.append('};')
+	out.append('')
+	out.append('const SCPI_cmd_index_t scpi_cmd_index = {')
+	out.append('\t.size = %d,' % len(slots))
+	out.append('\t.buckets = %d,' % len(disp))
+	out.append('\t.disp = disp,')
+	out.append('\t.entries = entries,')
+	out.append('};')
+	out.append('')
+
+	text = '\n'.join(out)
+	if args.output == '-':
+		sys.stdout.write(text)
+	else:
+		with open(args.output, 'w') as f:
+			f.write(text)
+
+
+if __name__ == '__main__':
+	main()
@@ -6,14 +6,24 @@
 
 // ------- TESTING ----------
 
+// Parser session. Each interface (UART, USB...) would have its own.
+static scpi_ctx_t session;
+
 static void send_cmd(const char *cmd)
 {
 	printf("\n> %s\n", cmd);
-	scpi_handle_string(cmd);
+	scpi_handle_string(&session, cmd);
 }
 
 int main(void)
 {
+	if (!scpi_init()) {
+		printf("Commands don't fit in SCPI_CMD_TRIE_NODES\n");
+		return 1;
+	}
+
+	scpi_ctx_init(&session, NULL);
+
 	send_cmd("*IDN?\n"); // builtin commands..
 	send_cmd("*SRE 4\n"); // enable SRQ on error
 	send_cmd("FOO:BAR:BAZ\n"); // invalid command causes error
@@ -53,28 +63,36 @@ const SCPI_error_desc scpi_user_errors[] = {
 };
 
 
-void scpi_send_byte_impl(uint8_t b)
+void scpi_send_byte_impl(scpi_ctx_t *ctx, uint8_t b)
 {
+	(void)ctx; // ctx->user could identify the interface
+
 	putchar(b); // device sends a byte
 }
 
 
-const char *scpi_user_IDN(void)
+const char *scpi_user_IDN(scpi_ctx_t *ctx)
 {
+	(void)ctx;
+
 	return "MightyPork,Test SCPI device,0,0.1";
 }
 
 
 /** Error callback */
-void scpi_user_error(int16_t errno, const char * msg)
+void scpi_user_error(scpi_ctx_t *ctx, int16_t errno, const char * msg)
 {
+	(void)ctx;
+
 	printf("### ERROR ADDED: %d, %s ###\n", errno, msg);
 }
 
 
 /** Service request impl */
-void scpi_user_SRQ(void)
+void scpi_user_SRQ(scpi_ctx_t *ctx)
 {
+	(void)ctx;
+
 	// NOTE: Actual instrument should send SRQ event somehow
 
 	printf("[Service Request]\n");
@@ -83,58 +101,69 @@ void scpi_user_SRQ(void)
 
 // ---- INSTRUMENT COMMANDS ----
 
-void cmd_APPL_SIN_cb(const SCPI_argval_t *args)
+void cmd_APPL_SIN_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
+	(void) ctx;
+
 	printf("cb APPLy:SINe %d, %f, %f\n", args[0].INT, args[1].FLOAT, args[2].FLOAT);
 }
 
 
 
-void cmd_DISP_TEXT_cb(const SCPI_argval_t *args)
+void cmd_DISP_TEXT_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
+	(void) ctx;
+
 	printf("cb DISPlay:TEXT %s\n", args[0].STRING);
 }
 
 
-void cmd_DATA_BLOB_cb(const SCPI_argval_t *args)
+void cmd_DATA_BLOB_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
+	(void) ctx;
+
 	printf("cb DATA:BLOB <%d>\n", args[0].BLOB_LEN);
 }
 
 
-void cmd_DATA_BLOB_data(const uint8_t *bytes)
+void cmd_DATA_BLOB_data(scpi_ctx_t *ctx, const uint8_t *bytes)
 {
+	(void) ctx;
+
 	printf("binary data: \"%s\"\n", bytes);
 }
 
 
-void cmd_USRERR_cb(const SCPI_argval_t *args)
+void cmd_USRERR_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void) args;
 
 	printf("cb USRERR - raising user error 10.\n");
-	scpi_add_error(10, "Custom error message...");
+	scpi_add_error(ctx, 10, "Custom error message...");
 }
 
 
-void cmd_CHARD_cb(const SCPI_argval_t *args)
+void cmd_CHARD_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
+	(void) ctx;
+
 	printf("CHARData cb: %s, arg2 = %d\n", args[0].CHARDATA, args[1].INT);
 }
 
 
-void cmd_ERROR_FALLBACK_cb(const SCPI_argval_t *args)
+void cmd_ERROR_FALLBACK_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void) args;
 
 	printf("Testing the error fallback feature...\n");
 
-	scpi_add_error(-427, NULL);
+	scpi_add_error(ctx, -427, NULL);
 }
 
 
-void cmd_SINGLE_STR_ARG_cb(const SCPI_argval_t *args)
+void cmd_SINGLE_STR_ARG_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
+	(void) ctx;
 	(void) args;
 
 	printf("Single str arg = %s", args[0].STRING);
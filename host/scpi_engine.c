@@ -0,0 +1,324 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "scpi_engine.h"
+
+#define RING_MASK (SCPI_ENGINE_RING_LEN - 1)
+
+// how long an idle worker sleeps before looking for work to steal
+#define IDLE_WAIT_NS 1000000
+
+/** Worker thread with its run queue. Each worker has its own cache lines. */
+struct scpi_engine_worker {
+	pthread_mutex_t lock; // guards the run queue and 'sleeping'
+	pthread_cond_t cond;
+	scpi_engine_session_t *head; // run queue (FIFO, linked by session->next), peeked without the lock
+	scpi_engine_session_t *tail;
+	bool sleeping;
+
+	scpi_engine_t *eng;
+	pthread_t thread;
+	uint16_t index;
+} __attribute__((aligned(SCPI_ENGINE_CACHE_LINE)));
+
+
+static void runq_push(scpi_engine_worker_t *w, scpi_engine_session_t *s)
+{
+	s->next = NULL;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->tail == NULL) {
+		__atomic_store_n(&w->head, s, __ATOMIC_RELAXED);
+	} else {
+		w->tail->next = s;
+	}
+	w->tail = s;
+
+	if (w->sleeping) {
+		pthread_cond_signal(&w->cond);
+	}
+	pthread_mutex_unlock(&w->lock);
+}
+
+
+/** Take the first session from a run queue. Must hold the lock. */
+static scpi_engine_session_t *runq_take(scpi_engine_worker_t *w)
+{
+	scpi_engine_session_t *s = w->head;
+
+	if (s != NULL) {
+		__atomic_store_n(&w->head, s->next, __ATOMIC_RELAXED);
+		if (s->next == NULL) {
+			w->tail = NULL;
+		}
+	}
+
+	return s;
+}
+
+
+static scpi_engine_session_t *runq_pop(scpi_engine_worker_t *w)
+{
+	pthread_mutex_lock(&w->lock);
+	scpi_engine_session_t *s = runq_take(w);
+	pthread_mutex_unlock(&w->lock);
+
+	return s;
+}
+
+
+/** Queue a session on its worker, unless it's queued already */
+static void session_queue(scpi_engine_t *eng, scpi_engine_session_t *s)
+{
+	if (!atomic_exchange(&s->queued, true)) {
+		runq_push(&eng->workers[atomic_load_explicit(&s->worker, memory_order_relaxed)], s);
+	}
+}
+
+
+/** Take a queued session from another worker. The session then belongs to the thief. */
+static scpi_engine_session_t *steal(scpi_engine_worker_t *w)
+{
+	scpi_engine_t *eng = w->eng;
+
+	for (uint16_t i = 1; i < eng->worker_count; i++) {
+		scpi_engine_worker_t *victim = &eng->workers[(w->index + i) % eng->worker_count];
+
+		// racy peek, avoids locking queues that are empty anyway
+		if (__atomic_load_n(&victim->head, __ATOMIC_RELAXED) == NULL) continue;
+
+		// don't wait for a busy queue, try the next one
+		if (pthread_mutex_trylock(&victim->lock) != 0) continue;
+		scpi_engine_session_t *s = runq_take(victim);
+		pthread_mutex_unlock(&victim->lock);
+
+		if (s != NULL) {
+			atomic_store_explicit(&s->worker, w->index, memory_order_relaxed);
+			return s;
+		}
+	}
+
+	return NULL;
+}
+
+
+/** Run the parser on the session's input */
+static void session_run(scpi_engine_t *eng, scpi_engine_session_t *s)
+{
+	// this run handles the wakes so far, later ones are seen below
+	atomic_store(&s->wake_pending, false);
+
+	uint32_t tail = atomic_load_explicit(&s->in_tail, memory_order_relaxed);
+	// only what's there now - input arriving meanwhile waits for the next turn
+	uint32_t head = atomic_load_explicit(&s->in_head, memory_order_acquire);
+	bool stalled = false;
+
+	while (tail != head) {
+		uint32_t chunk = head - tail;
+		uint32_t to_end = SCPI_ENGINE_RING_LEN - (tail & RING_MASK);
+		if (chunk > to_end) chunk = to_end;
+
+		uint32_t used = scpi_handle_buffer(&s->ctx, &s->in_buf[tail & RING_MASK], chunk);
+		tail += used;
+		atomic_store_explicit(&s->in_tail, tail, memory_order_release);
+
+		if (used < chunk) {
+			// blob buffers full, wait for scpi_engine_wake()
+			stalled = true;
+			break;
+		}
+	}
+
+	atomic_store(&s->queued, false);
+
+	// input submitted or a wake while the session was being processed was not queued
+	// (seq_cst pairs with the stores in scpi_engine_submit() and scpi_engine_wake())
+	if (stalled) {
+		if (atomic_exchange(&s->wake_pending, false)) {
+			session_queue(eng, s);
+		}
+	} else if (atomic_load(&s->in_head) != tail) {
+		session_queue(eng, s);
+	}
+}
+
+
+static void idle_wait(scpi_engine_worker_t *w)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_nsec += IDLE_WAIT_NS;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_nsec -= 1000000000L;
+		ts.tv_sec++;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	if (w->head == NULL && !atomic_load(&w->eng->stop)) {
+		w->sleeping = true;
+		pthread_cond_timedwait(&w->cond, &w->lock, &ts);
+		w->sleeping = false;
+	}
+	pthread_mutex_unlock(&w->lock);
+}
+
+
+static void *worker_main(void *arg)
+{
+	scpi_engine_worker_t *w = arg;
+	scpi_engine_t *eng = w->eng;
+
+	if (eng->pin) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		if (ncpu < 1) ncpu = 1;
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(w->index % ncpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set); // best effort
+	}
+
+	while (true) {
+		scpi_engine_session_t *s = runq_pop(w);
+
+		if (s == NULL) {
+			s = steal(w);
+		}
+
+		if (s == NULL) {
+			// exit only when there's no work left
+			if (atomic_load(&eng->stop)) break;
+
+			idle_wait(w);
+			continue;
+		}
+
+		session_run(eng, s);
+	}
+
+	return NULL;
+}
+
+
+bool scpi_engine_start(scpi_engine_t *eng, uint16_t workers, bool pin)
+{
+	if (workers == 0) return false;
+
+	if (!scpi_init()) return false; // before the workers start, the command tables must fit
+
+	eng->workers = aligned_alloc(SCPI_ENGINE_CACHE_LINE, workers * sizeof(scpi_engine_worker_t));
+	if (eng->workers == NULL) return false;
+
+	memset(eng->workers, 0, workers * sizeof(scpi_engine_worker_t));
+	eng->worker_count = workers;
+	eng->pin = pin;
+	atomic_store(&eng->next_worker, 0);
+	atomic_store(&eng->stop, false);
+
+	for (uint16_t i = 0; i < workers; i++) {
+		scpi_engine_worker_t *w = &eng->workers[i];
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->cond, NULL);
+		w->eng = eng;
+		w->index = i;
+	}
+
+	for (uint16_t i = 0; i < workers; i++) {
+		if (pthread_create(&eng->workers[i].thread, NULL, worker_main, &eng->workers[i]) != 0) {
+			// stop the ones already running
+			eng->worker_count = i;
+			scpi_engine_stop(eng);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+void scpi_engine_stop(scpi_engine_t *eng)
+{
+	atomic_store(&eng->stop, true);
+
+	for (uint16_t i = 0; i < eng->worker_count; i++) {
+		scpi_engine_worker_t *w = &eng->workers[i];
+
+		pthread_mutex_lock(&w->lock);
+		pthread_cond_signal(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	for (uint16_t i = 0; i < eng->worker_count; i++) {
+		pthread_join(eng->workers[i].thread, NULL);
+	}
+
+	for (uint16_t i = 0; i < eng->worker_count; i++) {
+		pthread_mutex_destroy(&eng->workers[i].lock);
+		pthread_cond_destroy(&eng->workers[i].cond);
+	}
+
+	free(eng->workers);
+	eng->workers = NULL;
+	eng->worker_count = 0;
+}
+
+
+void scpi_engine_session_init(scpi_engine_t *eng, scpi_engine_session_t *s, void *user)
+{
+	scpi_ctx_init(&s->ctx, user);
+
+	atomic_store(&s->in_head, 0);
+	atomic_store(&s->in_tail, 0);
+	atomic_store(&s->queued, false);
+	atomic_store(&s->wake_pending, false);
+	s->next = NULL;
+
+	// spread the sessions evenly, stealing moves them later if needed
+	uint32_t n = atomic_fetch_add_explicit(&eng->next_worker, 1, memory_order_relaxed);
+	atomic_store(&s->worker, (uint16_t)(n % eng->worker_count));
+}
+
+
+size_t scpi_engine_submit(scpi_engine_t *eng, scpi_engine_session_t *s, const uint8_t *data, size_t len)
+{
+	uint32_t head = atomic_load_explicit(&s->in_head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&s->in_tail, memory_order_acquire);
+
+	size_t space = SCPI_ENGINE_RING_LEN - (head - tail);
+	if (len > space) len = space;
+	if (len == 0) return 0;
+
+	size_t to_end = SCPI_ENGINE_RING_LEN - (head & RING_MASK);
+	if (to_end > len) to_end = len;
+
+	memcpy(&s->in_buf[head & RING_MASK], data, to_end);
+	memcpy(&s->in_buf[0], data + to_end, len - to_end);
+
+	atomic_store(&s->in_head, head + (uint32_t)len);
+
+	session_queue(eng, s);
+
+	return len;
+}
+
+
+void scpi_engine_wake(scpi_engine_t *eng, scpi_engine_session_t *s)
+{
+	// if the session is being processed now, session_run() sees the flag and re-queues it
+	atomic_store(&s->wake_pending, true);
+	session_queue(eng, s);
+}
+
+
+bool scpi_engine_session_idle(scpi_engine_session_t *s)
+{
+	return !atomic_load(&s->queued)
+		   && atomic_load(&s->in_head) == atomic_load(&s->in_tail);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "scpi.h"
+
+// Host-side session engine (Linux, pthreads, C11) - not a part of the MCU library.
+//
+// Runs many sessions on a pool of worker threads. Each session belongs to one worker
+// (sessions are spread evenly when created). Input is copied to the session's ring
+// buffer and the session is queued on its worker, which runs the parser on it.
+// A worker with nothing to do steals queued sessions from the others, and the stolen
+// sessions stay with the new worker.
+//
+// A session is only ever processed by one worker at a time, so the callbacks
+// need no locking for the session's own data.
+
+/** Input buffer of a session (bytes, power of two) */
+#ifndef SCPI_ENGINE_RING_LEN
+#define SCPI_ENGINE_RING_LEN 4096
+#endif
+
+#define SCPI_ENGINE_CACHE_LINE 64
+
+#if (SCPI_ENGINE_RING_LEN & (SCPI_ENGINE_RING_LEN - 1)) != 0
+#error "SCPI_ENGINE_RING_LEN must be a power of two"
+#endif
+
+typedef struct scpi_engine_worker scpi_engine_worker_t;
+
+/**
+ * Engine session. Allocate with SCPI_ENGINE_CACHE_LINE alignment (eg. aligned_alloc()),
+ * so sessions don't share cache lines.
+ */
+typedef struct scpi_engine_session {
+	scpi_ctx_t ctx; // parser session, ctx.user is the application pointer
+
+	// input ring - head written by the submitting thread, tail by the worker
+	_Alignas(SCPI_ENGINE_CACHE_LINE) _Atomic uint32_t in_head;
+	_Alignas(SCPI_ENGINE_CACHE_LINE) _Atomic uint32_t in_tail;
+	uint8_t in_buf[SCPI_ENGINE_RING_LEN];
+
+	_Atomic bool queued; // in a run queue, or being processed
+	_Atomic bool wake_pending; // scpi_engine_wake() called, not handled by a run yet
+	_Atomic uint16_t worker; // worker the session belongs to
+	struct scpi_engine_session *next; // run queue link
+} scpi_engine_session_t;
+
+
+/** Engine (worker pool) */
+typedef struct {
+	scpi_engine_worker_t *workers;
+	uint16_t worker_count;
+	bool pin; // workers pinned to CPUs
+	_Atomic uint32_t next_worker; // for spreading new sessions
+	_Atomic bool stop;
+} scpi_engine_t;
+
+
+/**
+ * Start the worker threads.
+ *
+ * @param eng engine
+ * @param workers number of worker threads
+ * @param pin pin worker N to CPU N (modulo the CPU count)
+ * @returns false if the threads could not be started, or the commands don't fit in the automaton (see scpi_init())
+ */
+bool scpi_engine_start(scpi_engine_t *eng, uint16_t workers, bool pin);
+
+/** Process all submitted input and stop the workers */
+void scpi_engine_stop(scpi_engine_t *eng);
+
+/**
+ * Initialize a session and assign it to a worker.
+ * Can be called while the engine is running (the shared command automaton is built
+ * by scpi_engine_start()).
+ *
+ * @param user application data, available as ctx->user in the callbacks
+ */
+void scpi_engine_session_init(scpi_engine_t *eng, scpi_engine_session_t *s, void *user);
+
+/**
+ * Pass received bytes to a session. Only one thread may submit to a session.
+ *
+ * @returns number of bytes accepted (less than len if the session's input buffer is full)
+ */
+size_t scpi_engine_submit(scpi_engine_t *eng, scpi_engine_session_t *s, const uint8_t *data, size_t len);
+
+/**
+ * Queue a session that stopped on back-pressure (blob buffers full), eg. after
+ * scpi_blob_release_buffer(). Not needed when more input is submitted.
+ */
+void scpi_engine_wake(scpi_engine_t *eng, scpi_engine_session_t *s);
+
+/** Check if all input of a session was processed */
+bool scpi_engine_session_idle(scpi_engine_session_t *s);
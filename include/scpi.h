@@ -6,3 +6,7 @@
 #include "scpi_errors.h"
 #include "scpi_builtins.h"
 #include "scpi_parser.h"
+#include "scpi_crc.h"
+#include "scpi_resp.h"
+#include "scpi_num.h"
+#include "scpi_ctx.h"
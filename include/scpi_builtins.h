@@ -2,17 +2,19 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "scpi_parser.h" // scpi_ctx_t
+
 /** Optional *CLS command callback - clear non-SCPI device state */
-extern __attribute__((weak)) void scpi_user_CLS(void);
+extern __attribute__((weak)) void scpi_user_CLS(scpi_ctx_t *ctx);
 
 /** Optional *RST command callback - reset non-SCPI device state */
-extern __attribute__((weak)) void scpi_user_RST(void);
+extern __attribute__((weak)) void scpi_user_RST(scpi_ctx_t *ctx);
 
 /** Optional *TST? command callback - perform self test and send response back. */
-extern __attribute__((weak)) void scpi_user_TST(void);
+extern __attribute__((weak)) void scpi_user_TST(scpi_ctx_t *ctx);
 
 /** MANDATORY callback to get the device *IDN? string. */
-extern const char *scpi_user_IDN(void);
+extern const char *scpi_user_IDN(scpi_ctx_t *ctx);
 
 // Provides:
 // const SCPI_command_t scpi_commands_builtin[];
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * CRC-32C (Castagnoli), as used for block data integrity checks.
+ *
+ * Uses the CRC instructions if available (SSE 4.2, ARMv8 CRC),
+ * otherwise slicing-by-8 with an 8 kB table, or a 1 kB table if SCPI_CRC32C_SMALL is defined.
+ *
+ * @param crc CRC of the preceding data, 0 to start
+ * @param data data to add
+ * @param len data length
+ * @returns CRC of all data so far
+ */
+uint32_t scpi_crc32c(uint32_t crc, const uint8_t *data, size_t len);
@@ -0,0 +1,134 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "scpi_parser.h"
+#include "scpi_errors.h"
+#include "scpi_regs.h"
+
+/**
+ * Parser internal state.
+ * Only accessed by the parser, the fields are not a part of the API.
+ */
+typedef struct {
+	uint8_t state; // current parser internal state
+
+	// string buffer, chars collected here until recognized
+	char charbuf[SCPI_MAX_STRING_LEN + 1];
+	uint16_t charbuf_i;
+
+	uint32_t blob_cnt; // preamble counter, if 0, was just #, must read count. Used also for blob body.
+	uint32_t blob_len; // total blob length to read
+	uint32_t chunk_pos; // bytes of the current blob chunk received (zero-copy callback)
+	bool blob_indefinite; // #0 block, ends with newline + END
+	bool blob_nl_pending; // #0 block - newline received, not known yet if it's data or the end
+	uint32_t blob_crc; // CRC-32C of the received blob data
+	uint32_t blob_crc_expected; // CRC from the argument before the blob (SCPI_CRC_CHECK)
+	uint32_t data_cnt; // blob data bytes passed on (decompressed)
+	uint32_t data_len; // blob data length, UINT32_MAX if not known
+
+	// compressed blob decoder
+	uint8_t dec_state;
+	bool dec_held; // output of the last header byte not delivered yet, the byte is not consumed
+	uint32_t dec_lit; // literal bytes left
+	uint32_t dec_mlen; // length of the match (or RLE repeat) being read
+	uint32_t dec_run; // match bytes left to generate
+	uint32_t dec_pend; // bytes at the end of the window not passed on yet
+	uint32_t win_pos; // bytes written to the window (total)
+	uint16_t dec_off; // match offset
+#if SCPI_BLOB_WINDOW > 0
+	uint8_t blob_win[SCPI_BLOB_WINDOW]; // history of the decompressed blob data
+#endif
+
+	// blob double buffer (user buffers)
+	uint8_t *sink_buf[2];
+	uint32_t sink_len; // size of each buffer, 0 = not used
+	uint32_t sink_fill; // bytes in the buffer being filled
+	void (*sink_cb)(scpi_ctx_t *ctx, uint8_t *buf, uint32_t len, uint32_t offset);
+	uint8_t sink_i; // buffer being filled
+	volatile bool sink_busy[2]; // buffer given to the application, not released yet
+
+	char string_quote; // symbol used to quote string
+	bool string_escape; // last char was backslash, next quote is literal
+	bool string_open; // quoted string started in the current arg (may be empty)
+	uint32_t string_len; // STRING_STREAM - content bytes passed on
+
+	// recognized complete command level strings (FUNCtion) - exact copy from command struct
+	char cur_levels[SCPI_MAX_LEVEL_COUNT][SCPI_MAX_CMD_LEN + 1];
+	uint8_t cur_level_i; // next free level slot index
+
+	bool cmdbuf_kept; // set to 1 after semicolon - cur_levels is kept (removed last part)
+
+	const SCPI_command_t * matched_cmd; // command is put here after recognition, used as reference for args
+
+	uint16_t cmd_node; // current node in the command header automaton
+	uint32_t cmd_hash; // hash of the header level being received
+	uint16_t level_node[SCPI_MAX_LEVEL_COUNT]; // automaton node at the start of each level (for semicolon)
+
+	SCPI_argval_t args[SCPI_MAX_PARAM_COUNT];
+	uint16_t arg_units[SCPI_MAX_PARAM_COUNT]; // unit suffix of each numeric argument
+	uint8_t arg_i; // next free argument slot index
+	uint8_t arena[SCPI_ARG_ARENA_LEN] __attribute__((aligned(4))); // argument text and channel ranges
+	uint16_t arena_used; // bytes allocated in the arena, for the current command
+	const char *arg_raw[SCPI_MAX_PARAM_COUNT]; // lazy_args - argument text (in the arena)
+	uint32_t arg_lazy; // lazy_args - numeric args not converted yet (bit = arg index)
+	uint32_t arg_bad; // lazy_args - args that failed to convert
+	uint32_t list_cnt; // LIST elements received
+	uint32_t list_fill; // LIST elements in list_buf
+	// channel list decoder
+	uint8_t chan_state;
+	bool chan_digits; // digits of the current number received
+	bool chan_has_mod; // current address has a module (after '!')
+	bool chan_range; // after ':'
+	uint32_t chan_num; // number being received
+	uint32_t chan_mod; // module of the current address
+	uint32_t chan_first; // start of the range
+
+	uint32_t enum_mask; // ENUM (or BOOL) argument - mnemonics still matching the chars received
+
+	char ebuf[100]; // buffer for error messages
+} SCPI_parser_state_t;
+
+
+/**
+ * SCPI session - one per interface (or simulated instrument).
+ *
+ * Holds the parser state, error queue and status registers. The command tables
+ * and the command index are shared by all sessions.
+ */
+struct scpi_ctx {
+	SCPI_parser_state_t pst; // parser state
+	SCPI_error_queue_t erq; // error queue
+	SCPI_regs_t regs; // status registers
+
+	uint8_t resp_digits; // significant digits of float responses, 0 = shortest
+
+#if SCPI_OUT_BUF_LEN > 0
+	uint8_t obuf[SCPI_OUT_BUF_LEN]; // output not passed on yet
+	uint16_t obuf_len;
+#endif
+
+	void *user; // application data, not used by the library
+};
+
+
+/**
+ * Build the shared command automaton (see SCPI_CMD_TRIE_NODES).
+ *
+ * Call once at startup, before any session is used. Not thread or interrupt safe -
+ * sessions must not parse input while it runs.
+ *
+ * @returns false if the command tables don't fit - no command is then found (each header raises
+ *          error -310), SCPI_CMD_TRIE_NODES must be larger. Also false if a command has
+ *          a blob_data_callback with blob_chunk over SCPI_MAX_STRING_LEN and no blob_buf.
+ */
+bool scpi_init(void);
+
+/**
+ * Initialize a session (registers in the power-on state, empty error queue).
+ * Must be called before passing any data to it.
+ *
+ * @param ctx session
+ * @param user application data, available as ctx->user in the callbacks
+ */
+void scpi_ctx_init(scpi_ctx_t *ctx, void *user);
@@ -2,6 +2,21 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "scpi_parser.h" // scpi_ctx_t
+
+// Error queue depth (max 127)
+#ifndef SCPI_ERR_QUEUE_LEN
+#define SCPI_ERR_QUEUE_LEN 4
+#endif
+
+// Extra info kept with each queued error (chars). Longer extra info is cut off,
+// both in the queue and in the string passed to scpi_user_error().
+#ifndef SCPI_ERR_EXTRA_LEN
+#define SCPI_ERR_EXTRA_LEN 48
+#endif
+
+#define SCPI_MAX_ERROR_LEN 150 // formatted error string
+
 typedef struct {
 	const int16_t errno;
 	const char *msg;
@@ -11,14 +26,31 @@ typedef struct {
 extern const SCPI_error_desc scpi_user_errors[];
 
 
+/** Queued error - the message is formatted when it's read */
+typedef struct {
+	int16_t errno; // as added, coerced to a defined code when read
+	char extra[SCPI_ERR_EXTRA_LEN + 1];
+} SCPI_error_entry_t;
+
+/** Error queue (part of the session) */
+typedef struct {
+	SCPI_error_entry_t queue[SCPI_ERR_QUEUE_LEN];
+	int8_t r_pos;
+	int8_t w_pos;
+	int8_t count; // signed for backtracking
+} SCPI_error_queue_t;
+
+
 /**
  * Callback when error is added to the queue
+ * (the error string is only formatted for this callback, if it's defined).
+ * The string is the same as read from the queue later, extra info cut to SCPI_ERR_EXTRA_LEN.
  *
  * @param errno error code
  * @param msg error string in the canonical format <code>,<message>
  */
 extern __attribute__((weak))
-void scpi_user_error(int16_t errno, const char * error_string);
+void scpi_user_error(scpi_ctx_t *ctx, int16_t errno, const char * error_string);
 
 
 // SCPI error constants
@@ -153,7 +185,8 @@ enum {
  * Get SCPI error string:
  * <code>,"<message>[; <extra>]"
  *
- * @param buffer Buffer for storing the final string. Make sure it's big enough.
+ * @param buffer Buffer for storing the final string, SCPI_MAX_ERROR_LEN + 1 chars.
+ *               A longer message is cut off.
  * @param errno Error number
  * @param extra Extra information, appended after the generic message. Can be NULL.
  *
@@ -163,21 +196,32 @@ int16_t scpi_error_string(char *buffer, int16_t errno, const char *extra);
 
 
 /** Add error to the error queue */
-void scpi_add_error(int16_t errno, const char *extra);
+void scpi_add_error(scpi_ctx_t *ctx, int16_t errno, const char *extra);
 
 
 /** Get number of errors in the error queue */
-uint8_t scpi_error_count(void);
+uint8_t scpi_error_count(scpi_ctx_t *ctx);
 
 
 /**
  * Read and remove one entry from the error queue.
  * Returns 0,"No error" if the queue is empty.
  *
- * The entry is copied to the provided buffer, which must be 256 chars long.
+ * The entry is copied to the provided buffer, which must be SCPI_MAX_ERROR_LEN + 1 chars long.
  */
-void scpi_read_error(char *buf);
+void scpi_read_error(scpi_ctx_t *ctx, char *buf);
+
+
+/**
+ * Read and remove one entry from the error queue and add it to the response
+ * as <code>,"<message>[; <extra>]" (no end of line). Adds 0,"No error" if the queue is empty.
+ */
+void scpi_resp_error(scpi_ctx_t *ctx);
 
 
 /** Read error, do not remove from queue */
-void scpi_read_error_noremove(char *buf);
+void scpi_read_error_noremove(scpi_ctx_t *ctx, char *buf);
+
+
+/** Read and remove one entry from the error queue, only the code (0 if empty) - no formatting */
+int16_t scpi_read_error_code(scpi_ctx_t *ctx);
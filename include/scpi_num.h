@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Numeric argument conversion (no scanf).
+
+/** Decimal number split into digits and exponent, see scpi_scan_decimal() */
+typedef struct {
+	uint64_t mant; // significant digits, value = mant * 10^exp10
+	int32_t exp10;
+	bool negative;
+	bool truncated; // more than 19 significant digits, the rest is not in mant
+} scpi_decimal_t;
+
+/** Result of a numeric conversion */
+typedef enum {
+	SCPI_NUM_OK = 0,
+	SCPI_NUM_SYNTAX, // not a valid number
+	SCPI_NUM_EXPONENT, // exponent magnitude over 32000 (integer - exponent makes it too large)
+	SCPI_NUM_RANGE, // out of range of the type
+	SCPI_NUM_DIGITS, // integer - too many digits for the type
+} scpi_num_status_t;
+
+/**
+ * Scan a decimal number: [+-]digits[.digits][(e|E)[+-]digits], at least one mantissa digit.
+ *
+ * @param str text, does not need to end after the number
+ * @param dec result
+ * @returns number of characters of the number, 0 if there is no valid number
+ */
+size_t scpi_scan_decimal(const char *str, scpi_decimal_t *dec);
+
+/**
+ * Convert a decimal number string to a double, correctly rounded.
+ * The whole string must be a number.
+ */
+scpi_num_status_t scpi_parse_double(const char *str, double *value);
+
+/** Convert a decimal number string to a float, correctly rounded (see scpi_parse_double()) */
+scpi_num_status_t scpi_parse_float(const char *str, float *value);
+
+/**
+ * Convert an integer string to int32_t. The whole string must be a number.
+ *
+ * Accepts decimal numbers (also with a fraction or exponent, rounded half away from zero,
+ * eg. 1.5E3) and the IEEE 488.2 non-decimal formats #Hxx, #Qxx, #Bxx. Non-decimal
+ * numbers are a bit pattern of up to 32 bits (#HFFFFFFFF = -1).
+ *
+ * @returns SCPI_NUM_DIGITS or SCPI_NUM_EXPONENT if the number does not fit
+ */
+scpi_num_status_t scpi_parse_int(const char *str, int32_t *value);
+
+/** Convert an integer string to int64_t (see scpi_parse_int()) */
+scpi_num_status_t scpi_parse_int64(const char *str, int64_t *value);
+
+/**
+ * Convert a decimal number string to a fixed-point int32_t, using integer math only.
+ * The whole string must be a number; it is rounded half away from zero.
+ *
+ * @param format SCPI_FIXED_Q() or SCPI_FIXED_DEC(), see scpi_parser.h
+ * @returns SCPI_NUM_RANGE if the number does not fit
+ */
+scpi_num_status_t scpi_parse_fixed(const char *str, uint8_t format, int32_t *value);
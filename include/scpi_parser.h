@@ -1,11 +1,64 @@
 #pragma once
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+/** SCPI session (parser state, error queue, registers), see scpi_ctx.h */
+typedef struct scpi_ctx scpi_ctx_t;
 
 #define SCPI_MAX_CMD_LEN 16 // 12 according to spec
 #define SCPI_MAX_STRING_LEN 64 // 12 according to spec
 #define SCPI_MAX_LEVEL_COUNT 4
+
+#ifndef SCPI_MAX_PARAM_COUNT
 #define SCPI_MAX_PARAM_COUNT 4
+#endif
+
+// Argument arena (bytes) - text of STRING and CHARDATA arguments (and of all arguments with
+// lazy_args) and channel list ranges of the command being parsed. Reused for each command.
+// Each argument takes at most one slot - the longest text (4-byte aligned) or a full channel list -
+// so the default always fits. A smaller value set at build time is an error.
+#define SCPI_ARG_ARENA_SLOT ((((SCPI_MAX_STRING_LEN + 4) & ~3) > SCPI_MAX_CHAN_RANGES * 8) \
+		? ((SCPI_MAX_STRING_LEN + 4) & ~3) : SCPI_MAX_CHAN_RANGES * 8)
+#define SCPI_ARG_ARENA_MIN (SCPI_MAX_PARAM_COUNT * SCPI_ARG_ARENA_SLOT)
+
+#ifndef SCPI_ARG_ARENA_LEN
+#define SCPI_ARG_ARENA_LEN SCPI_ARG_ARENA_MIN
+#endif
+
+// Size of the command header automaton (nodes), built by scpi_init(). One node is used for each
+// distinct level of the headers - SOUR:VOLT:LIM and SOUR:VOLT:OFFS take 4 nodes together
+// (see scpi_cmd_index_nodes()). Each node takes 14 bytes with its hash table slots.
+// If the commands don't fit, scpi_init() returns false and no command is found.
+// Set to 0 to disable it and use a linear scan of the command tables instead.
+// Not used when a generated index is compiled in (SCPI_CMD_INDEX).
+#ifndef SCPI_CMD_TRIE_NODES
+#define SCPI_CMD_TRIE_NODES 768
+#endif
+
+// History window for compressed block data (bytes, power of two), in every session.
+// LZ4 match offsets must not be larger. 0 = compressed blocks not supported.
+#ifndef SCPI_BLOB_WINDOW
+#define SCPI_BLOB_WINDOW 0
+#endif
+
+// Response output buffer (bytes). Small writes are collected here and passed on
+// at the end of a message, when the buffer is full, or on scpi_send_flush().
+// Set to 0 to pass every write on directly.
+#ifndef SCPI_OUT_BUF_LEN
+#define SCPI_OUT_BUF_LEN 64
+#endif
+
+// Max number of parts of a message for scpi_send_message() to write at once
+// (the buffered output and the newline are added). More are written in batches.
+#ifndef SCPI_SEND_IOV_MAX
+#define SCPI_SEND_IOV_MAX 8
+#endif
+
+// Max channel list entries stored in the argument (8 bytes each, in the argument arena)
+#ifndef SCPI_MAX_CHAN_RANGES
+#define SCPI_MAX_CHAN_RANGES 8
+#endif
 
 /** Argument data types */
 typedef enum {
@@ -16,25 +69,185 @@ typedef enum {
 	SCPI_DT_CHARDATA, // string without quotes - [A-Za-z0-9_]
 	SCPI_DT_STRING, // quoted string, max 12 chars; no escapes.
 	SCPI_DT_BLOB, // binary block, callback: uint32_t holding number of bytes
+	SCPI_DT_DOUBLE, // double precision float
+	SCPI_DT_INT64, // 64-bit integer (may be signed)
+	SCPI_DT_FIXED, // fixed-point number (no floating point math), format set by the command's .fixed
+	SCPI_DT_ENUM, // one of the mnemonics in the command's .enums, index of the matched one
+	SCPI_DT_LIST, // comma separated numbers of the command's ext->list_type, passed on one by one (must be last)
+	SCPI_DT_CHANLIST, // channel list (@1,3,5:8,2!1), as ranges (and the command's ext->chan_bitmap, if set)
+	SCPI_DT_STRING_STREAM, // quoted string of any length, passed on as received (the command's ext->string_callback / string_buf)
 } SCPI_datatype_t;
 
+/** Fixed-point format with 'bits' fraction bits, eg. SCPI_FIXED_Q(16) for Q16.16 (0..31) */
+#define SCPI_FIXED_Q(bits) ((uint8_t)(bits))
+/** Fixed-point format scaled by 10^digits, eg. SCPI_FIXED_DEC(6) for micro-units (0..9) */
+#define SCPI_FIXED_DEC(digits) ((uint8_t)(0x80 | (digits)))
 
-/** Arguemnt value (union) */
+/**
+ * Units of numeric params (bit mask of allowed units, see SCPI_command_t.units).
+ * A unit may have a metric prefix (mV, KHZ, uA); the number is scaled by it.
+ */
+typedef enum {
+	SCPI_UNIT_NONE = 0, // no unit given
+	SCPI_UNIT_V = 1 << 0, // volt
+	SCPI_UNIT_A = 1 << 1, // ampere
+	SCPI_UNIT_W = 1 << 2, // watt
+	SCPI_UNIT_OHM = 1 << 3, // ohm (MOHM = mega)
+	SCPI_UNIT_HZ = 1 << 4, // hertz (MHZ = mega)
+	SCPI_UNIT_S = 1 << 5, // second
+	SCPI_UNIT_F = 1 << 6, // farad
+	SCPI_UNIT_H = 1 << 7, // henry
+	SCPI_UNIT_CEL = 1 << 8, // degree Celsius
+	SCPI_UNIT_DEG = 1 << 9, // degree (angle)
+	SCPI_UNIT_PCT = 1 << 10, // percent
+	SCPI_UNIT_PREFIX = 1 << 15, // metric prefix alone (10K), the unit is implied
+} SCPI_unit_t;
+
+
+/** Block data integrity check */
+typedef enum {
+	SCPI_CRC_NONE = 0,
+	SCPI_CRC_COMPUTE, // compute CRC-32C of the block data, see scpi_blob_crc()
+	SCPI_CRC_CHECK, // compute and compare with the argument before the blob (INT), error if different
+} SCPI_blob_crc_t;
+
+/** Block data compression */
+typedef enum {
+	SCPI_CODEC_NONE = 0,
+	SCPI_CODEC_RLE, // PackBits run-length encoding
+	SCPI_CODEC_LZ4, // LZ4 block format, match offsets up to SCPI_BLOB_WINDOW
+} SCPI_blob_codec_t;
+
+/** BLOB_LEN of an indefinite length block (#0), terminated by newline + END */
+#define SCPI_BLOB_INDEFINITE 0xFFFFFFFF
+
+/** Channel address, module!channel (module 0 if not given) */
+#define SCPI_CHAN(module, channel) (((uint32_t)(module) << 16) | (uint16_t)(channel))
+#define SCPI_CHAN_MODULE(addr) ((uint16_t)((addr) >> 16))
+#define SCPI_CHAN_CHANNEL(addr) ((uint16_t)(addr))
+
+/** Channel list entry (SCPI_CHAN addresses), a single channel has first == last */
+typedef struct {
+	uint32_t first;
+	uint32_t last; // may be lower than first (5:1, scan order)
+} SCPI_chanrange_t;
+
+/** Argument value (union). Text and channel ranges point into the argument arena, valid in the callback. */
 typedef union {
 	float FLOAT;
+	double DOUBLE;
 
 	int32_t INT;
-	uint32_t BLOB_LEN;
+	int64_t INT64;
+	int32_t FIXED; // number scaled by the command's fixed-point format
+	uint32_t BLOB_LEN; // SCPI_BLOB_INDEFINITE for #0 blocks
+	uint32_t LIST_LEN; // number of LIST elements
+	uint32_t STRING_LEN; // STRING_STREAM - length of the string (unescaped)
 
 	bool BOOL;
+	uint8_t ENUM; // index in the mnemonic list
 
-	char STRING[SCPI_MAX_STRING_LEN + 1];
-	char CHARDATA[SCPI_MAX_STRING_LEN + 1];
+	const char *STRING;
+	const char *CHARDATA;
+
+	struct {
+		uint16_t count; // list entries; with a chan_bitmap, more than SCPI_MAX_CHAN_RANGES are allowed
+		const SCPI_chanrange_t *ranges; // the first entries (up to SCPI_MAX_CHAN_RANGES)
+	} CHANLIST;
 } SCPI_argval_t;
 
+/** Numeric value of a limit (the member matching the param type) */
+typedef union {
+	float FLOAT;
+	double DOUBLE;
+	int32_t INT;
+	int64_t INT64;
+	int32_t FIXED; // scaled by the command's fixed-point format
+} SCPI_numval_t;
+
+/**
+ * Limits of a numeric param - values are checked (error -222), and MIN, MAX, DEF are accepted.
+ * Can be shared by the setting and the query command.
+ */
+typedef struct {
+	SCPI_datatype_t type; // FLOAT, DOUBLE, INT, INT64 or FIXED - the param type
+	SCPI_numval_t min;
+	SCPI_numval_t max;
+	SCPI_numval_t def; // DEFault
+} SCPI_limits_t;
+
+// Limits initializers, eg. static const SCPI_limits_t volt_lim = SCPI_LIMITS_FLOAT(0, 30, 5);
+#define SCPI_LIMITS_FLOAT(mn, mx, df) {.type = SCPI_DT_FLOAT, .min.FLOAT = (mn), .max.FLOAT = (mx), .def.FLOAT = (df)}
+#define SCPI_LIMITS_DOUBLE(mn, mx, df) {.type = SCPI_DT_DOUBLE, .min.DOUBLE = (mn), .max.DOUBLE = (mx), .def.DOUBLE = (df)}
+#define SCPI_LIMITS_INT(mn, mx, df) {.type = SCPI_DT_INT, .min.INT = (mn), .max.INT = (mx), .def.INT = (df)}
+#define SCPI_LIMITS_INT64(mn, mx, df) {.type = SCPI_DT_INT64, .min.INT64 = (mn), .max.INT64 = (mx), .def.INT64 = (df)}
+#define SCPI_LIMITS_FIXED(mn, mx, df) {.type = SCPI_DT_FIXED, .min.FIXED = (mn), .max.FIXED = (mx), .def.FIXED = (df)}
+
 
 // ------ CONFIGURATION --------
 
+/**
+ * Optional details of the params of a command - units, limits, enum mnemonics, and the sinks
+ * of LIST, CHANLIST and STRING_STREAM params. Referenced by the command's .ext, can be shared.
+ */
+typedef struct {
+	// --- OPTIONAL (only for numbers) ---
+
+	// Format of all FIXED params - SCPI_FIXED_Q() or SCPI_FIXED_DEC(), default Q0 (integer)
+	const uint8_t fixed;
+
+	// Allowed unit suffixes of each numeric param (SCPI_UNIT_x mask), 0 = no suffix allowed.
+	// The unit given is available with scpi_arg_unit().
+	const uint16_t units[SCPI_MAX_PARAM_COUNT];
+
+	// Limits of each numeric param (NULL = none). MIN, MAX and DEF are then accepted
+	// as the value, and values outside the limits raise -222 before the callback is run.
+	// A query without params, but with limits[0], answers "CMD? MIN|MAX|DEF" itself.
+	const SCPI_limits_t *limits[SCPI_MAX_PARAM_COUNT];
+
+	// --- OPTIONAL (only for ENUM) ---
+
+	// Mnemonics of each ENUM param, NULL terminated list of up to 32 (eg. {"VOLTage", "CURRent", NULL}).
+	// The short (upper case) or long form is accepted, as for command headers.
+	const char *const *enums[SCPI_MAX_PARAM_COUNT];
+
+	// --- OPTIONAL (only for LIST) ---
+
+	// Type of the LIST elements - FLOAT, DOUBLE, INT, INT64 or FIXED. Units and limits
+	// of the LIST param apply to each element. The command callback runs after the last one.
+	const SCPI_datatype_t list_type;
+
+	// Called with each element as it is received (index = position in the list)
+	void (*list_callback)(scpi_ctx_t *ctx, const SCPI_argval_t *value, uint32_t index);
+
+	// Array the elements are stored to (float, double, int32_t or int64_t), list_buf_len elements.
+	// Without list_buf_callback, a longer list raises -223.
+	void *const list_buf;
+	const uint32_t list_buf_len;
+	// Called when list_buf is full, and with the rest at the end of the list. The buffer is then reused.
+	void (*list_buf_callback)(scpi_ctx_t *ctx, const void *buf, uint32_t count, uint32_t index);
+
+	// --- OPTIONAL (only for CHANLIST) ---
+
+	// Bitmap the channels are set in while parsing, cleared first. Bit = module * chan_per_module + channel,
+	// ranges with modules (1!1:2!4) cover all channels between in both. A channel outside
+	// (or past chan_per_module in a module) raises -222.
+	uint8_t *const chan_bitmap;
+	const uint32_t chan_bitmap_bits; // channels in the bitmap
+	const uint16_t chan_per_module;
+
+	// --- OPTIONAL (only for STRING_STREAM) ---
+
+	// Called with the unescaped string content as it is received (offset = position in the string).
+	// Data points into the buffer given to scpi_handle_buffer() where possible, escaped chars come one by one.
+	void (*string_callback)(scpi_ctx_t *ctx, const char *data, size_t len, uint32_t offset);
+
+	// Buffer the string is written to (NUL terminated). A string that does not fit raises -223.
+	char *const string_buf;
+	const uint32_t string_buf_len;
+} SCPI_param_ext_t;
+
+
 /**
  * SCPI command preset
  * NOTE: command array is terminated by {0} - zero in levels[0][0]
@@ -45,7 +258,7 @@ typedef struct {
 
 	// called when the command is completed. BLOB arg must be last in the argument list,
 	// and only the first part is collected.
-	void (*callback)(const SCPI_argval_t *args);
+	void (*callback)(scpi_ctx_t *ctx, const SCPI_argval_t *args);
 
 	// Param types - optional (defaults to zeros)
 	const SCPI_datatype_t params[SCPI_MAX_PARAM_COUNT]; // parameter types (0 for unused)
@@ -53,9 +266,45 @@ typedef struct {
 	// --- OPTIONAL (only for blob) ---
 
 	// Number of bytes in a blob callback
-	const uint8_t blob_chunk;
-	// Blob chunk callback (every blob_chunk bytes)
-	void (*blob_callback)(const uint8_t *bytes);
+	const uint32_t blob_chunk;
+	// Blob chunk callback (every blob_chunk bytes, copied to a buffer, max 64 bytes)
+	void (*blob_callback)(scpi_ctx_t *ctx, const uint8_t *bytes);
+
+	// Zero-copy blob callback, used instead of blob_callback if set.
+	// Data points into the buffer given to scpi_handle_buffer(), offset is the position in the blob.
+	// Chunks have blob_chunk bytes (the last may be shorter); 0 = pass data as it arrives.
+	// A chunk split between two input buffers is copied together, so blob_chunk can be at most
+	// SCPI_MAX_STRING_LEN - use blob_buf for larger chunks. Otherwise scpi_init() returns false
+	// and the blob is refused (error -310).
+	void (*blob_data_callback)(scpi_ctx_t *ctx, const uint8_t *data, size_t len, uint32_t offset);
+
+	// Double-buffered blob sink, used instead of the callbacks if set (see scpi_blob_set_buffers())
+	uint8_t *const blob_buf[2]; // two buffers of blob_buf_len bytes
+	const uint32_t blob_buf_len;
+	// Called when a buffer is full (or the blob ended). Release it with scpi_blob_release_buffer().
+	void (*blob_buf_callback)(scpi_ctx_t *ctx, uint8_t *buf, uint32_t len, uint32_t offset);
+
+	// Called when all block data was received (not if discarded), len = total bytes
+	void (*blob_end_callback)(scpi_ctx_t *ctx, uint32_t len);
+
+	// CRC-32C of the block data, computed while receiving it (compressed data, if used)
+	const SCPI_blob_crc_t blob_crc;
+
+	// Compressed block data - decompressed before passing it to the callbacks or buffers,
+	// offsets and lengths are then in the decompressed data. BLOB_LEN is the compressed length.
+	const SCPI_blob_codec_t blob_codec;
+
+	// --- OPTIONAL (lazy arguments) ---
+
+	// Keep the text of the arguments (scpi_arg_raw()), and convert numeric args only when
+	// read with the scpi_arg_x() accessors - their values in args[] are not set.
+	// Conversion errors are then raised on access, the accessor returns 0 (see scpi_arg_ok()).
+	const bool lazy_args;
+
+	// --- OPTIONAL (typed params) ---
+
+	// Units, limits, enums, LIST / CHANLIST / STRING_STREAM sinks and the FIXED format (NULL = none)
+	const SCPI_param_ext_t *ext;
 } SCPI_command_t;
 
 
@@ -67,8 +316,47 @@ extern const SCPI_command_t scpi_commands[];
 /** Built-in SCPI commands, provided by scpi_builtins.h */
 extern const SCPI_command_t scpi_commands_builtin[];
 
+/**
+ * Generated command index entry - one normalized header path,
+ * uppercase short or long forms of the levels joined by colons (eg. "SYST:ERR:NEXT?")
+ */
+typedef struct {
+	const char *path;
+	const SCPI_command_t *cmd; // command with exactly this header, NULL if it's only a prefix
+	bool partial; // a longer command continues after this path with a colon
+} SCPI_cmd_index_entry_t;
+
+/** Generated command index - minimal perfect hash of all header paths */
+typedef struct {
+	uint16_t size; // number of entries
+	uint16_t buckets; // number of displacement buckets
+	const uint16_t *disp; // hash seed for each bucket
+	const SCPI_cmd_index_entry_t *entries;
+} SCPI_cmd_index_t;
+
+/**
+ * Command index generated by cmdgen.py from the command arrays.
+ * Used instead of the automaton when compiled with SCPI_CMD_INDEX defined.
+ */
+extern const SCPI_cmd_index_t scpi_cmd_index;
+
+/** Part of an outgoing message (gather write) */
+typedef struct {
+	const void *base;
+	size_t len;
+} scpi_iovec_t;
+
+// Output to master - implement at least one of these. The library uses the first
+// one available, in this order: iov (gather), buf, byte.
+
+/** Send multiple buffers to master in one write (eg. writev() or one USB transfer) */
+extern __attribute__((weak)) void scpi_send_iov_impl(scpi_ctx_t *ctx, const scpi_iovec_t *iov, uint8_t count);
+
+/** Send a buffer to master */
+extern __attribute__((weak)) void scpi_send_buf_impl(scpi_ctx_t *ctx, const uint8_t *buf, size_t len);
+
 /** Send a byte to master (may be buffered) */
-extern void scpi_send_byte_impl(uint8_t b);
+extern __attribute__((weak)) void scpi_send_byte_impl(scpi_ctx_t *ctx, uint8_t b);
 
 /** Character sequence used as a newline in responses. */
 extern const char *scpi_eol;
@@ -79,25 +367,147 @@ extern const char *scpi_eol;
 /**
  * SCPI parser entry point.
  * All incoming bytes should be sent to this function.
+ *
+ * @returns false if the byte was not accepted (blob buffers full), pass it again later.
  */
-void scpi_handle_byte(const uint8_t b);
+bool scpi_handle_byte(scpi_ctx_t *ctx, const uint8_t b);
 
 /**
  * SCPI parser - handle a string (multiple chars) at once.
  * String is interpreted as is, nothing is added. Must be terminated with \0.
+ *
+ * @returns number of chars consumed - less than the string length if the blob buffers
+ *          are full, pass the rest again later (see scpi_handle_buffer()).
  */
-void scpi_handle_string(const char* str);
+size_t scpi_handle_string(scpi_ctx_t *ctx, const char* str);
+
+/**
+ * SCPI parser - handle a buffer of received bytes (binary safe).
+ * Runs of block data and discarded input are processed in bulk.
+ *
+ * @returns number of bytes consumed. Bytes not consumed must be passed again later.
+ */
+size_t scpi_handle_buffer(scpi_ctx_t *ctx, const uint8_t *buf, size_t len);
+
 
+/**
+ * Signal END (EOI) - the last byte passed to the parser had END asserted.
+ *
+ * END terminates the message like a newline, and ends indefinite length blocks (#0),
+ * which are received until a newline with END.
+ */
+void scpi_handle_end(scpi_ctx_t *ctx);
 
 /** Discard the rest of the currently processed blob */
-void scpi_discard_blob(void);
+void scpi_discard_blob(scpi_ctx_t *ctx);
+
+/**
+ * Receive the current blob into two user buffers (eg. for DMA).
+ * Call from the command callback (run after the blob preamble).
+ *
+ * One buffer is filled while the other is used by the application.
+ * When a buffer is full (or the blob ended), callback is called with it.
+ * If both buffers are still in use, the parser stops accepting input until one is released.
+ *
+ * @param buf0 first buffer
+ * @param buf1 second buffer
+ * @param len size of each buffer
+ * @param callback buffer full callback (offset is the position of the buffer data in the blob)
+ */
+void scpi_blob_set_buffers(scpi_ctx_t *ctx, uint8_t *buf0, uint8_t *buf1, uint32_t len,
+						   void (*callback)(scpi_ctx_t *ctx, uint8_t *buf, uint32_t len, uint32_t offset));
+
+/** Return a full blob buffer to the parser (can be called from an interrupt) */
+void scpi_blob_release_buffer(scpi_ctx_t *ctx, const uint8_t *buf);
+
+/** CRC-32C of the blob data received so far (complete in blob_end_callback) */
+uint32_t scpi_blob_crc(scpi_ctx_t *ctx);
+
+/** Check if the blob CRC matched (always true if the command does not use SCPI_CRC_CHECK) */
+bool scpi_blob_crc_ok(scpi_ctx_t *ctx);
+
+/**
+ * Check if the command header automaton was built completely (see scpi_init()).
+ * False if it was not built or did not fit in SCPI_CMD_TRIE_NODES.
+ */
+bool scpi_cmd_index_ok(void);
+
+/** Number of command header automaton nodes used (0 if not built) */
+uint16_t scpi_cmd_index_nodes(void);
+
+/** Unit suffix of a numeric argument of the current command (SCPI_UNIT_NONE if none was given) */
+SCPI_unit_t scpi_arg_unit(scpi_ctx_t *ctx, uint8_t index);
+
+// Typed access to the arguments of the current command (in its callback).
+// An index past the params, or a param of another type, gives 0 (or "").
+
+/** INT argument */
+int32_t scpi_arg_int(scpi_ctx_t *ctx, uint8_t index);
+
+/** INT64 (or INT) argument */
+int64_t scpi_arg_int64(scpi_ctx_t *ctx, uint8_t index);
+
+/** FLOAT argument */
+float scpi_arg_float(scpi_ctx_t *ctx, uint8_t index);
+
+/** DOUBLE (or FLOAT) argument */
+double scpi_arg_double(scpi_ctx_t *ctx, uint8_t index);
+
+/** FIXED argument, in the command's fixed-point format */
+int32_t scpi_arg_fixed(scpi_ctx_t *ctx, uint8_t index);
+
+/** BOOL argument */
+bool scpi_arg_bool(scpi_ctx_t *ctx, uint8_t index);
+
+/** ENUM argument - index of the mnemonic, -1 if not an ENUM param */
+int8_t scpi_arg_enum(scpi_ctx_t *ctx, uint8_t index);
+
+/** STRING or CHARDATA argument */
+const char *scpi_arg_string(scpi_ctx_t *ctx, uint8_t index);
+
+/** Length of a STRING, CHARDATA, STRING_STREAM, BLOB or LIST argument */
+uint32_t scpi_arg_len(scpi_ctx_t *ctx, uint8_t index);
+
+/**
+ * CHANLIST argument
+ *
+ * @param ranges set to the stored ranges (up to SCPI_MAX_CHAN_RANGES of them), may be NULL
+ * @returns number of entries in the list
+ */
+uint16_t scpi_arg_chanlist(scpi_ctx_t *ctx, uint8_t index, const SCPI_chanrange_t **ranges);
+
+/**
+ * Text of an argument as received, without whitespace (eg. "1.5mV", "#H1F", "VOLT").
+ * Only for commands with .lazy_args, "" otherwise (and for CHANLIST, LIST, BLOB and STRING_STREAM).
+ */
+const char *scpi_arg_raw(scpi_ctx_t *ctx, uint8_t index);
+
+/** Check if an argument was converted without error (with .lazy_args, converts it if not done yet) */
+bool scpi_arg_ok(scpi_ctx_t *ctx, uint8_t index);
 
 /** Send a string to master. \r\n is added. */
-void scpi_send_string(const char *message);
+void scpi_send_string(scpi_ctx_t *ctx, const char *message);
+
+/** Send a string without a line terminator (buffered) */
+void scpi_send_string_raw(scpi_ctx_t *ctx, const char *message);
+
+/** Send bytes without a line terminator (buffered) */
+void scpi_send_buf(scpi_ctx_t *ctx, const uint8_t *buf, size_t len);
+
+/**
+ * Send a message made of parts (eg. header, data), the line terminator is added.
+ * Everything, including output buffered before, goes out in one write if the
+ * scpi_send_iov_impl() hook is implemented (in batches if there are more than
+ * SCPI_SEND_IOV_MAX parts).
+ *
+ * @param iov parts of the message
+ * @param count number of parts
+ */
+void scpi_send_message(scpi_ctx_t *ctx, const scpi_iovec_t *iov, uint8_t count);
 
-/** Send a string without a line terminator */
-void scpi_send_string_raw(const char *message);
+/** Pass on the buffered output */
+void scpi_send_flush(scpi_ctx_t *ctx);
 
 /** Clear the error queue */
-void scpi_clear_errors(void);
+void scpi_clear_errors(scpi_ctx_t *ctx);
 
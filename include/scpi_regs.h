@@ -2,6 +2,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "scpi_parser.h" // scpi_ctx_t
+
 typedef union {
 	struct __attribute__((packed)) {
 		bool VOLT: 1;
@@ -82,25 +84,31 @@ typedef union {
 } SCPI_REG_STB_t;
 
 
-// QUESTionable register
-extern SCPI_REG_QUES_t SCPI_REG_QUES;
-extern SCPI_REG_QUES_t SCPI_REG_QUES_EN; // picks what to use for the STB bit
+/** Status registers of a session (ctx->regs) */
+typedef struct {
+	// QUESTionable register
+	SCPI_REG_QUES_t QUES;
+	SCPI_REG_QUES_t QUES_EN; // picks what to use for the STB bit
+
+	// OPERation status register
+	SCPI_REG_OPER_t OPER;
+	SCPI_REG_OPER_t OPER_EN; // picks what to use for the STB bit
 
-// OPERation status register
-extern SCPI_REG_OPER_t SCPI_REG_OPER;
-extern SCPI_REG_OPER_t SCPI_REG_OPER_EN; // picks what to use for the STB bit
+	// Standard Event Status register
+	SCPI_REG_SESR_t SESR;
+	SCPI_REG_SESR_t SESR_EN; // ESE
 
-// Standard Event Status register
-extern SCPI_REG_SESR_t SCPI_REG_SESR;
-extern SCPI_REG_SESR_t SCPI_REG_SESR_EN; // ESE
+	// Status byte
+	SCPI_REG_STB_t STB;
+	SCPI_REG_STB_t SRE; // SRE
+} SCPI_regs_t;
 
-// Status byte
-extern SCPI_REG_STB_t SCPI_REG_STB;
-extern SCPI_REG_STB_t SCPI_REG_SRE; // SRE
 
+/** Set the registers to the power-on state (done by scpi_ctx_init()) */
+void scpi_regs_init(SCPI_regs_t *regs);
 
 /** Update the status registers (perform propagation) */
-void scpi_status_update(void);
+void scpi_status_update(scpi_ctx_t *ctx);
 
 
 /**
@@ -111,4 +119,4 @@ void scpi_status_update(void);
  * SRQ is issued when an event enabled in the status registers (namely SRE) occurs.
  * See the SCPI spec for details.
  */
-extern __attribute__((weak)) void scpi_user_SRQ(void);
+extern __attribute__((weak)) void scpi_user_SRQ(scpi_ctx_t *ctx);
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "scpi_parser.h"
+
+// Response builder - formats response data directly to the output (no printf).
+//
+// Example: "12,#H1F,\"abc\"\r\n"
+//
+//   scpi_resp_int(ctx, 12);
+//   scpi_resp_sep(ctx);
+//   scpi_resp_hex(ctx, 0x1F);
+//   scpi_resp_sep(ctx);
+//   scpi_resp_string_quoted(ctx, "abc");
+//   scpi_resp_end(ctx);
+
+/** Signed decimal integer (NR1) */
+void scpi_resp_int(scpi_ctx_t *ctx, int32_t value);
+
+/** Signed 64-bit decimal integer (NR1) */
+void scpi_resp_int64(scpi_ctx_t *ctx, int64_t value);
+
+/** Unsigned decimal integer (NR1) */
+void scpi_resp_uint(scpi_ctx_t *ctx, uint32_t value);
+
+/** Hexadecimal integer, #H prefix, upper case digits */
+void scpi_resp_hex(scpi_ctx_t *ctx, uint32_t value);
+
+/** String in double quotes, quotes inside the string are doubled */
+void scpi_resp_string_quoted(scpi_ctx_t *ctx, const char *str);
+
+/**
+ * Floating point number in the NR3 format (eg. 1.25E-03).
+ *
+ * By default the shortest form that reads back as the same value is sent.
+ * INF, NINF and NaN are sent as the SCPI values 9.9E+37, -9.9E+37 and 9.91E+37.
+ */
+void scpi_resp_double(scpi_ctx_t *ctx, double value);
+
+/** Float in the NR3 format - as scpi_resp_double(), shortest form for float precision */
+void scpi_resp_float(scpi_ctx_t *ctx, float value);
+
+/**
+ * Set the number of significant digits of scpi_resp_float() and scpi_resp_double()
+ * (eg. for FORMat:DATA ASCii,<length>).
+ *
+ * @param digits 1..17, 0 = shortest form (default)
+ */
+void scpi_resp_set_digits(scpi_ctx_t *ctx, uint8_t digits);
+
+/**
+ * Fixed-point number in the NR2 format (eg. 1.25), exact, without trailing zeros.
+ * Integer (NR1) if the format has no fraction.
+ *
+ * @param format SCPI_FIXED_Q() or SCPI_FIXED_DEC(), as for SCPI_DT_FIXED
+ */
+void scpi_resp_fixed(scpi_ctx_t *ctx, int32_t value, uint8_t format);
+
+/** Data separator (comma) */
+void scpi_resp_sep(scpi_ctx_t *ctx);
+
+/** End of the response - line terminator, the output is flushed */
+void scpi_resp_end(scpi_ctx_t *ctx);
@@ -16,6 +16,9 @@ SOURCES += \
 	source/scpi_errors.c \
 	source/scpi_regs.c \
 	source/scpi_builtins.c \
+	source/scpi_crc.c \
+	source/scpi_resp.c \
+	source/scpi_num.c \
 	example/example.c
 
 DISTFILES += \
@@ -35,4 +38,8 @@ HEADERS += \
 	include/scpi_errors.h \
 	include/scpi_parser.h \
 	include/scpi_regs.h \
+	include/scpi_crc.h \
+	include/scpi_resp.h \
+	include/scpi_num.h \
+	include/scpi_ctx.h \
 	include/scpi.h
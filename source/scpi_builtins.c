@@ -1,325 +1,300 @@
 #include <stdint.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <stdlib.h>
 
 #include "scpi_builtins.h"
 #include "scpi_parser.h"
 #include "scpi_errors.h"
 #include "scpi_regs.h"
-
-// response buffer
-static char sbuf[256]; // must be long enough to contain an error message
+#include "scpi_ctx.h"
+#include "scpi_resp.h"
 
 
 // ---------------- BUILTIN SCPI COMMANDS ------------------
 
-static void builtin_CLS(const SCPI_argval_t *args)
+static void builtin_CLS(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	// clear the registers
-	SCPI_REG_SESR.u8 = 0;
-	SCPI_REG_OPER.u16 = 0;
-	SCPI_REG_QUES.u16 = 0;
-	scpi_clear_errors();
+	ctx->regs.SESR.u8 = 0;
+	ctx->regs.OPER.u16 = 0;
+	ctx->regs.QUES.u16 = 0;
+	scpi_clear_errors(ctx);
 
 	if (scpi_user_CLS) {
-		scpi_user_CLS();
+		scpi_user_CLS(ctx);
 	}
 
-	scpi_status_update(); // flags
+	scpi_status_update(ctx); // flags
 }
 
 
-static void builtin_RST(const SCPI_argval_t *args)
+static void builtin_RST(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	if (scpi_user_RST) {
-		scpi_user_RST();
+		scpi_user_RST(ctx);
 	}
 }
 
 
-static void builtin_TSTq(const SCPI_argval_t *args)
+static void builtin_TSTq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	if (scpi_user_TST) {
-		scpi_user_TST();
+		scpi_user_TST(ctx);
 	}
 }
 
 
-static void builtin_IDNq(const SCPI_argval_t *args)
+static void builtin_IDNq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	scpi_send_string(scpi_user_IDN());
+	scpi_send_string(ctx, scpi_user_IDN(ctx));
 }
 
 
-static void builtin_ESE(const SCPI_argval_t *args)
+static void builtin_ESE(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
-	SCPI_REG_SESR_EN.u8 = (uint8_t) args[0].INT;
-	scpi_status_update();
+	ctx->regs.SESR_EN.u8 = (uint8_t) args[0].INT;
+	scpi_status_update(ctx);
 }
 
 
-static void builtin_ESEq(const SCPI_argval_t *args)
+static void builtin_ESEq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	sprintf(sbuf, "%d", SCPI_REG_SESR_EN.u8);
-	scpi_send_string(sbuf);
+	scpi_resp_uint(ctx, ctx->regs.SESR_EN.u8);
+	scpi_resp_end(ctx);
 }
 
 
-static void builtin_ESRq(const SCPI_argval_t *args)
+static void builtin_ESRq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	sprintf(sbuf, "%d", SCPI_REG_SESR.u8);
-	scpi_send_string(sbuf);
+	scpi_resp_uint(ctx, ctx->regs.SESR.u8);
+	scpi_resp_end(ctx);
 
-	SCPI_REG_SESR.u8 = 0; // register cleared
-	scpi_status_update();
+	ctx->regs.SESR.u8 = 0; // register cleared
+	scpi_status_update(ctx);
 }
 
 
-static void builtin_OPC(const SCPI_argval_t *args)
+static void builtin_OPC(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	// implementation for instruments with no overlapping commands.
 	// Can be overridden in the user commands.
-	SCPI_REG_SESR.OPC = 1;
-	scpi_status_update();
+	ctx->regs.SESR.OPC = 1;
+	scpi_status_update(ctx);
 }
 
 
-static void builtin_OPCq(const SCPI_argval_t *args)
+static void builtin_OPCq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	// implementation for instruments with no overlapping commands.
 	// Can be overridden in the user commands.
-	// (would be): sprintf(sbuf, "%d", SCPI_REG_SESR.OPC);
+	// (would be): scpi_resp_uint(ctx, ctx->regs.SESR.OPC);
 
-	scpi_send_string("1");
+	scpi_send_string(ctx, "1");
 }
 
 
-static void builtin_SRE(const SCPI_argval_t *args)
+static void builtin_SRE(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
-	SCPI_REG_SRE.u8 = (uint8_t) args[0].INT;
-	scpi_status_update();
+	ctx->regs.SRE.u8 = (uint8_t) args[0].INT;
+	scpi_status_update(ctx);
 }
 
 
-static void builtin_SREq(const SCPI_argval_t *args)
+static void builtin_SREq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	sprintf(sbuf, "%d", SCPI_REG_SRE.u8);
-	scpi_send_string(sbuf);
+	scpi_resp_uint(ctx, ctx->regs.SRE.u8);
+	scpi_resp_end(ctx);
 }
 
 
-static void builtin_STBq(const SCPI_argval_t *args)
+static void builtin_STBq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	sprintf(sbuf, "%d", SCPI_REG_STB.u8);
-	scpi_send_string(sbuf);
+	scpi_resp_uint(ctx, ctx->regs.STB.u8);
+	scpi_resp_end(ctx);
 }
 
 
-static void builtin_WAI(const SCPI_argval_t *args)
+static void builtin_WAI(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
+	(void)ctx;
 	(void)args;
 
 	// no-op
 }
 
 
-static void builtin_SYST_ERR_NEXTq(const SCPI_argval_t *args)
+static void builtin_SYST_ERR_NEXTq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	scpi_read_error(sbuf);
-	scpi_send_string(sbuf);
+	scpi_resp_error(ctx);
+	scpi_resp_end(ctx);
 }
 
 
 // optional
-static void builtin_SYST_ERR_ALLq(const SCPI_argval_t *args)
+static void builtin_SYST_ERR_ALLq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	if (scpi_error_count()) {
-		int cnt = 0;
-		while (scpi_error_count()) {
-			scpi_read_error(sbuf);
-			if (cnt++ > 0) scpi_send_string_raw(",");
-			scpi_send_string_raw(sbuf);
-			scpi_send_string_raw(scpi_eol);
-		}
-	} else {
-		scpi_read_error(sbuf); // O,"No error"
-		scpi_send_string(sbuf);
+	scpi_resp_error(ctx); // 0,"No error" if empty
+	while (scpi_error_count(ctx)) {
+		scpi_resp_sep(ctx);
+		scpi_resp_error(ctx);
 	}
+
+	scpi_resp_end(ctx);
 }
 
 
-static void builtin_SYST_ERR_CODE_NEXTq(const SCPI_argval_t *args)
+static void builtin_SYST_ERR_CODE_NEXTq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	scpi_read_error(sbuf);
-
-	// end at comma
-	for (int i = 0; i < 256; i++) {
-		if (sbuf[i] == ',') {
-			sbuf[i] = 0;
-			break;
-		}
-	}
-
-	scpi_send_string(sbuf);
+	scpi_resp_int(ctx, scpi_read_error_code(ctx)); // the message is not formatted
+	scpi_resp_end(ctx);
 }
 
 
 // optional
-static void builtin_SYST_ERR_CODE_ALLq(const SCPI_argval_t *args)
+static void builtin_SYST_ERR_CODE_ALLq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	int cnt = 0;
-	while (scpi_error_count()) {
-		scpi_read_error(sbuf);
-		if (cnt++ > 0) scpi_send_string_raw(",");
-
-		// end at comma
-		for (int i = 0; i < 256; i++) {
-			if (sbuf[i] == ',') {
-				sbuf[i] = 0;
-				break;
-			}
-		}
-
-		scpi_send_string_raw(sbuf);
+	while (scpi_error_count(ctx)) {
+		if (cnt++ > 0) scpi_resp_sep(ctx);
+		scpi_resp_int(ctx, scpi_read_error_code(ctx));
 	}
 
-	scpi_send_string_raw(scpi_eol);
+	scpi_resp_end(ctx);
 }
 
 
 // optional
-static void builtin_SYST_ERR_COUNq(const SCPI_argval_t *args)
+static void builtin_SYST_ERR_COUNq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	sprintf(sbuf, "%d", scpi_error_count());
-	scpi_send_string(sbuf);
+	scpi_resp_uint(ctx, scpi_error_count(ctx));
+	scpi_resp_end(ctx);
 }
 
 
 // optional, custom
-static void builtin_SYST_ERR_CLEAR(const SCPI_argval_t *args)
+static void builtin_SYST_ERR_CLEAR(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	scpi_clear_errors();
+	scpi_clear_errors(ctx);
 }
 
 
-static void builtin_SYST_VERSq(const SCPI_argval_t *args)
+static void builtin_SYST_VERSq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	scpi_send_string("1999.0"); // implemented SCPI version
+	scpi_send_string(ctx, "1999.0"); // implemented SCPI version
 }
 
 
-static void builtin_STAT_OPER_EVENq(const SCPI_argval_t *args)
+static void builtin_STAT_OPER_EVENq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	// read and clear
-	sprintf(sbuf, "%d", SCPI_REG_OPER.u16);
-	SCPI_REG_OPER.u16 = 0x0000;
-	scpi_send_string(sbuf);
-	scpi_status_update();
+	scpi_resp_uint(ctx, ctx->regs.OPER.u16);
+	scpi_resp_end(ctx);
+	ctx->regs.OPER.u16 = 0x0000;
+	scpi_status_update(ctx);
 }
 
 
-static void builtin_STAT_OPER_CONDq(const SCPI_argval_t *args)
+static void builtin_STAT_OPER_CONDq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	// read and keep
-	sprintf(sbuf, "%d", SCPI_REG_OPER.u16);
-	scpi_send_string(sbuf);
+	scpi_resp_uint(ctx, ctx->regs.OPER.u16);
+	scpi_resp_end(ctx);
 }
 
 
-static void builtin_STAT_OPER_ENAB(const SCPI_argval_t *args)
+static void builtin_STAT_OPER_ENAB(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
-	SCPI_REG_OPER.u16 = (uint16_t) args[0].INT; // set enable flags
-	scpi_status_update();
+	ctx->regs.OPER_EN.u16 = (uint16_t) args[0].INT; // set enable flags
+	scpi_status_update(ctx);
 }
 
 
-static void builtin_STAT_OPER_ENABq(const SCPI_argval_t *args)
+static void builtin_STAT_OPER_ENABq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	sprintf(sbuf, "%d", SCPI_REG_OPER_EN.u16);
-	scpi_send_string(sbuf);
+	scpi_resp_uint(ctx, ctx->regs.OPER_EN.u16);
+	scpi_resp_end(ctx);
 }
 
 
-static void builtin_STAT_QUES_EVENq(const SCPI_argval_t *args)
+static void builtin_STAT_QUES_EVENq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	// read and clear
-	sprintf(sbuf, "%d", SCPI_REG_QUES.u16);
-	SCPI_REG_QUES.u16 = 0x0000;
-	scpi_send_string(sbuf);
-	scpi_status_update();
+	scpi_resp_uint(ctx, ctx->regs.QUES.u16);
+	scpi_resp_end(ctx);
+	ctx->regs.QUES.u16 = 0x0000;
+	scpi_status_update(ctx);
 }
 
 
-static void builtin_STAT_QUES_CONDq(const SCPI_argval_t *args)
+static void builtin_STAT_QUES_CONDq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
 	// read and keep
-	sprintf(sbuf, "%d", SCPI_REG_QUES.u16);
-	scpi_send_string(sbuf);
+	scpi_resp_uint(ctx, ctx->regs.QUES.u16);
+	scpi_resp_end(ctx);
 }
 
 
-static void builtin_STAT_QUES_ENAB(const SCPI_argval_t *args)
+static void builtin_STAT_QUES_ENAB(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
-	SCPI_REG_QUES.u16 = (uint16_t) args[0].INT; // set enable flags
-	scpi_status_update();
+	ctx->regs.QUES_EN.u16 = (uint16_t) args[0].INT; // set enable flags
+	scpi_status_update(ctx);
 }
 
 
-static void builtin_STAT_QUES_ENABq(const SCPI_argval_t *args)
+static void builtin_STAT_QUES_ENABq(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
-	sprintf(sbuf, "%d", SCPI_REG_QUES_EN.u16);
-	scpi_send_string(sbuf);
+	scpi_resp_uint(ctx, ctx->regs.QUES_EN.u16);
+	scpi_resp_end(ctx);
 }
 
 
-static void builtin_STAT_PRES(const SCPI_argval_t *args)
+static void builtin_STAT_PRES(scpi_ctx_t *ctx, const SCPI_argval_t *args)
 {
 	(void)args;
 
@@ -328,9 +303,9 @@ static void builtin_STAT_PRES(const SCPI_argval_t *args)
 
 	// Do not use this command, only defined to satisfy the spec.
 
-	SCPI_REG_QUES_EN.u16 = 0;
-	SCPI_REG_OPER_EN.u16 = 0;
-	scpi_status_update();
+	ctx->regs.QUES_EN.u16 = 0;
+	ctx->regs.OPER_EN.u16 = 0;
+	scpi_status_update(ctx);
 }
 
 
@@ -445,7 +420,7 @@ const SCPI_command_t scpi_commands_builtin[] = {
 	},
 	{
 		.levels = {"STATus", "OPERation", "ENABle"},
-		.params = {SCPI_DT_BOOL},
+		.params = {SCPI_DT_INT},
 		.callback = builtin_STAT_OPER_ENAB
 	},
 	{
@@ -467,7 +442,7 @@ const SCPI_command_t scpi_commands_builtin[] = {
 	},
 	{
 		.levels = {"STATus", "QUEStionable", "ENABle"},
-		.params = {SCPI_DT_BOOL},
+		.params = {SCPI_DT_INT},
 		.callback = builtin_STAT_QUES_ENAB
 	},
 	{
@@ -1,112 +1,146 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
 
 #include "scpi_errors.h"
 #include "scpi_regs.h"
-
-#define ERR_QUEUE_LEN 4
-#define MAX_ERROR_LEN 150
+#include "scpi_ctx.h"
+#include "scpi_resp.h"
 
 // --- queue impl ---
 
+static int16_t coerce_errno(int16_t errno);
+
 
-static struct ErrorQueueStruct {
-	char queue[ERR_QUEUE_LEN][MAX_ERROR_LEN + 1];
-	int8_t r_pos;
-	int8_t w_pos;
-	int8_t count; // signed for backtracking
-} erq;
+/** Format a queued error, returns the actual error code */
+static int16_t format_entry(const SCPI_error_entry_t *e, char *buf)
+{
+	return scpi_error_string(buf, e->errno, e->extra[0] ? e->extra : NULL);
+}
 
 
-void scpi_add_error(int16_t errno, const char *extra)
+void scpi_add_error(scpi_ctx_t *ctx, int16_t errno, const char *extra)
 {
-	if (erq.count >= ERR_QUEUE_LEN) {
+	SCPI_error_queue_t *erq = &ctx->erq;
+
+	if (erq->count >= SCPI_ERR_QUEUE_LEN) {
 		errno = E_DEV_QUEUE_OVERFLOW;
 		extra = NULL;
 
 		// backtrack
-		erq.w_pos--;
-		erq.count--;
-		if (erq.w_pos < 0) {
-			erq.w_pos = ERR_QUEUE_LEN - 1;
+		erq->w_pos--;
+		erq->count--;
+		if (erq->w_pos < 0) {
+			erq->w_pos = SCPI_ERR_QUEUE_LEN - 1;
 		}
 	}
 
-	// get string & coerce errno to valid value
-	errno = scpi_error_string(erq.queue[erq.w_pos], errno, extra);
+	// store the code and extra info, the message is formatted when read
+	SCPI_error_entry_t *e = &erq->queue[erq->w_pos];
+	e->errno = errno;
+
+	size_t n = 0;
+	if (extra != NULL) {
+		for (; n < SCPI_ERR_EXTRA_LEN && extra[n] != 0; n++) {
+			e->extra[n] = extra[n];
+		}
+	}
+	e->extra[n] = 0;
 
-	// run optional user error callback
+	// run optional user error callback, with the text as queued (extra cut off)
 	if (scpi_user_error) {
-		scpi_user_error(errno, erq.queue[erq.w_pos]);
+		char buf[SCPI_MAX_ERROR_LEN + 1];
+		errno = format_entry(e, buf);
+		scpi_user_error(ctx, errno, buf);
 	}
 
-	erq.w_pos++;
-	erq.count++;
-	if (erq.w_pos >= ERR_QUEUE_LEN) {
-		erq.w_pos = 0;
+	erq->w_pos++;
+	erq->count++;
+	if (erq->w_pos >= SCPI_ERR_QUEUE_LEN) {
+		erq->w_pos = 0;
 	}
 
-	// error type status flags
+	// error type status flags (a coerced code stays in its group)
 	if (errno >= -499 && errno <= -400) {
-		SCPI_REG_SESR.QUERY_ERROR = true;
+		ctx->regs.SESR.QUERY_ERROR = true;
 	} else if ((errno >= -399 && errno <= -300) || errno > 0) {
-		SCPI_REG_SESR.DEV_ERROR = true;
+		ctx->regs.SESR.DEV_ERROR = true;
 	} else if (errno >= -299 && errno <= -200) {
-		SCPI_REG_SESR.EXE_ERROR = true;
+		ctx->regs.SESR.EXE_ERROR = true;
 	} else if (errno >= -199 && errno <= -100) {
-		SCPI_REG_SESR.CMD_ERROR = true;
+		ctx->regs.SESR.CMD_ERROR = true;
 	}
 
 	// update the error queue bit and propagate the above flags
-	scpi_status_update();
+	scpi_status_update(ctx);
+}
+
+
+/** Remove the oldest entry */
+static const SCPI_error_entry_t *take_entry(scpi_ctx_t *ctx)
+{
+	SCPI_error_queue_t *erq = &ctx->erq;
+	const SCPI_error_entry_t *e = &erq->queue[erq->r_pos++];
+
+	erq->count--;
+
+	if (erq->r_pos >= SCPI_ERR_QUEUE_LEN) {
+		erq->r_pos = 0;
+	}
+
+	scpi_status_update(ctx);
+	return e; // stays valid until another error is added
 }
 
 
-void scpi_read_error_noremove(char *buf)
+void scpi_read_error_noremove(scpi_ctx_t *ctx, char *buf)
 {
-	if (erq.count == 0) {
+	const SCPI_error_queue_t *erq = &ctx->erq;
+
+	if (erq->count == 0) {
 		scpi_error_string(buf, E_NO_ERROR, NULL);
 		return;
 	}
 
-	strcpy(buf, erq.queue[erq.r_pos]);
+	format_entry(&erq->queue[erq->r_pos], buf);
 }
 
 
-void scpi_read_error(char *buf)
+void scpi_read_error(scpi_ctx_t *ctx, char *buf)
 {
-	if (erq.count == 0) {
+	if (ctx->erq.count == 0) {
 		scpi_error_string(buf, E_NO_ERROR, NULL);
 		return;
 	}
 
-	strcpy(buf, erq.queue[erq.r_pos++]);
-	erq.count--;
+	format_entry(take_entry(ctx), buf);
+}
+
 
-	if (erq.r_pos >= ERR_QUEUE_LEN) {
-		erq.r_pos = 0;
-	}
+int16_t scpi_read_error_code(scpi_ctx_t *ctx)
+{
+	if (ctx->erq.count == 0) return E_NO_ERROR;
 
-	scpi_status_update();
+	return coerce_errno(take_entry(ctx)->errno);
 }
 
 
-void scpi_clear_errors(void)
+void scpi_clear_errors(scpi_ctx_t *ctx)
 {
-	erq.r_pos = 0;
-	erq.w_pos = 0;
-	erq.count = 0;
+	SCPI_error_queue_t *erq = &ctx->erq;
+
+	erq->r_pos = 0;
+	erq->w_pos = 0;
+	erq->count = 0;
 
-	scpi_status_update();
+	scpi_status_update(ctx);
 }
 
 
-uint8_t scpi_error_count(void)
+uint8_t scpi_error_count(scpi_ctx_t *ctx)
 {
-	return erq.count;
+	return ctx->erq.count;
 }
 
 
@@ -321,10 +355,58 @@ static const SCPI_error_desc * resolve_error_desc(int16_t errno)
 }
 
 
+/** Coerce an error code to the closest defined code (categories: tens, hundreds) */
+static int16_t coerce_errno(int16_t errno)
+{
+	const SCPI_error_desc *desc = resolve_error_desc(errno);
+	return desc ? desc->errno : errno;
+}
+
+
+/** Resolve the message of an error, the code is coerced to the closest defined code */
+static const char *error_msg(int16_t *errno)
+{
+	const SCPI_error_desc *desc = resolve_error_desc(*errno);
+
+	if (desc == NULL) {
+		// bad error code
+		return "Unknown error";
+	}
+
+	*errno = desc->errno;
+	return desc->msg;
+}
+
+
+/** Copy a string up to the end of the buffer, returns the new end of the text */
+static char *append_text(char *p, const char *end, const char *str)
+{
+	while (*str != 0 && p < end) {
+		*p++ = *str++;
+	}
+
+	return p;
+}
+
+
+/** Message and extra info joined as "<message>; <extra>", returns the end of the text */
+static char *error_text(char *p, const char *end, const char *msg, const char *extra)
+{
+	p = append_text(p, end, msg);
+
+	if (extra != NULL) {
+		p = append_text(p, end, "; ");
+		p = append_text(p, end, extra);
+	}
+
+	return p;
+}
+
+
 /**
  * Get error string.
  *
- * @param buffer Buffer for storing the final string. Make sure it's big enough.
+ * @param buffer Buffer for storing the final string, SCPI_MAX_ERROR_LEN + 1 chars.
  * @param errno Error number
  * @param extra Extra information, appended after the generic message.
  *
@@ -332,24 +414,50 @@ static const SCPI_error_desc * resolve_error_desc(int16_t errno)
  */
 int16_t scpi_error_string(char *buffer, int16_t errno, const char *extra)
 {
-	const SCPI_error_desc *desc = resolve_error_desc(errno);
-	const char *msg;
+	const char *msg = error_msg(&errno);
 
-	if (desc != NULL) {
-		errno = desc->errno;
-		msg = desc->msg;
-	} else {
-		// bad error code
-		msg = "Unknown error";
-	}
+	// code, digits reversed into a scratch buffer
+	char digits[5];
+	uint8_t n = 0;
+	uint16_t value = (errno < 0) ? (uint16_t) -errno : (uint16_t) errno;
 
-	// Print.
-	if (extra == NULL) {
-		sprintf(buffer, "%d,\"%s\"", errno, msg);
-	} else {
-		sprintf(buffer, "%d,\"%s; %s\"", errno, msg, extra);
-	}
+	do {
+		digits[n++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	char *p = buffer;
+	if (errno < 0) *p++ = '-';
+	while (n > 0) *p++ = digits[--n];
+
+	// quoted text, cut off to leave room for the closing quote
+	*p++ = ',';
+	*p++ = '"';
+	p = error_text(p, buffer + SCPI_MAX_ERROR_LEN - 1, msg, extra);
+	*p++ = '"';
+	*p = 0;
 
 	return errno;
 }
 
+
+void scpi_resp_error(scpi_ctx_t *ctx)
+{
+	int16_t errno = E_NO_ERROR;
+	char text[SCPI_MAX_ERROR_LEN + 1];
+	const char *extra = NULL;
+
+	if (ctx->erq.count > 0) {
+		const SCPI_error_entry_t *e = take_entry(ctx);
+		errno = e->errno;
+		if (e->extra[0]) extra = e->extra;
+	}
+
+	// the text is joined first, quotes in it are doubled when sent
+	const char *msg = error_msg(&errno);
+	*error_text(text, text + SCPI_MAX_ERROR_LEN, msg, extra) = 0;
+
+	scpi_resp_int(ctx, errno);
+	scpi_resp_sep(ctx);
+	scpi_resp_string_quoted(ctx, text);
+}
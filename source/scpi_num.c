@@ -0,0 +1,377 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "scpi_num.h"
+#include "scpi_parser.h"
+
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+// max significant digits kept (fits in uint64_t)
+#define MAX_SIG_DIGITS 19
+
+// max exponent magnitude allowed by IEEE 488.2
+#define MAX_EXPONENT 32000
+
+
+size_t scpi_scan_decimal(const char *str, scpi_decimal_t *dec)
+{
+	const char *p = str;
+	uint64_t mant = 0;
+	int32_t exp10 = 0;
+	uint8_t sig = 0; // significant digits in mant
+	bool any = false;
+
+	dec->negative = false;
+	dec->truncated = false;
+
+	if (*p == '+' || *p == '-') {
+		dec->negative = (*p == '-');
+		p++;
+	}
+
+	// integer part
+	for (; IS_DIGIT(*p); p++) {
+		any = true;
+		if (sig < MAX_SIG_DIGITS) {
+			mant = mant * 10 + (uint8_t)(*p - '0');
+			if (mant != 0) sig++; // leading zeros don't count
+		} else {
+			exp10++;
+			if (*p != '0') dec->truncated = true;
+		}
+	}
+
+	// fraction
+	if (*p == '.') {
+		p++;
+		for (; IS_DIGIT(*p); p++) {
+			any = true;
+			if (sig < MAX_SIG_DIGITS) {
+				mant = mant * 10 + (uint8_t)(*p - '0');
+				if (mant != 0) sig++;
+				exp10--;
+			} else if (*p != '0') {
+				dec->truncated = true;
+			}
+		}
+	}
+
+	if (!any) return 0;
+
+	// exponent - only if followed by digits, otherwise the 'e' is not a part of the number
+	if (*p == 'e' || *p == 'E') {
+		const char *q = p + 1;
+		bool neg = false;
+
+		if (*q == '+' || *q == '-') {
+			neg = (*q == '-');
+			q++;
+		}
+
+		if (IS_DIGIT(*q)) {
+			int32_t e = 0;
+			for (; IS_DIGIT(*q); q++) {
+				if (e < 1000000) e = e * 10 + (*q - '0'); // saturate, it's too large anyway
+			}
+
+			exp10 += neg ? -e : e;
+			p = q;
+		}
+	}
+
+	dec->mant = mant;
+	dec->exp10 = exp10;
+
+	return (size_t)(p - str);
+}
+
+
+/** Scan a string that must be just a number */
+static scpi_num_status_t scan_whole(const char *str, scpi_decimal_t *dec)
+{
+	const size_t len = scpi_scan_decimal(str, dec);
+
+	if (len == 0 || str[len] != 0) return SCPI_NUM_SYNTAX;
+
+	if (dec->mant != 0 && (dec->exp10 > MAX_EXPONENT || dec->exp10 < -MAX_EXPONENT)) {
+		return SCPI_NUM_EXPONENT;
+	}
+
+	return SCPI_NUM_OK;
+}
+
+
+/**
+ * Move the exponent into the mantissa while the mantissa stays below 'limit'.
+ * Used to bring exponents just over the fast path range into it (eg. 12e24).
+ */
+static void shift_exponent(uint64_t *mant, int32_t *exp10, int32_t max_exp, uint64_t limit)
+{
+	while (*exp10 > max_exp && *mant <= limit / 10) {
+		*mant *= 10;
+		(*exp10)--;
+	}
+}
+
+
+// Fast path (Clinger): if the mantissa and the power of ten are both exact,
+// one multiplication or division gives a correctly rounded result.
+
+static const double pow10_d[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const float pow10_f[] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+
+scpi_num_status_t scpi_parse_double(const char *str, double *value)
+{
+	scpi_decimal_t dec;
+	scpi_num_status_t st = scan_whole(str, &dec);
+	if (st != SCPI_NUM_OK) return st;
+
+	uint64_t m = dec.mant;
+	int32_t e = dec.exp10;
+
+	if (m == 0) {
+		*value = dec.negative ? -0.0 : 0.0;
+		return SCPI_NUM_OK;
+	}
+
+	if (!dec.truncated) {
+		shift_exponent(&m, &e, 22, 1ULL << 53);
+
+		if (m <= (1ULL << 53) && e >= -22 && e <= 22) {
+			double v = (double) m;
+			v = (e < 0) ? v / pow10_d[-e] : v * pow10_d[e];
+			*value = dec.negative ? -v : v;
+			return SCPI_NUM_OK;
+		}
+	}
+
+	// slow path, correctly rounded by the C library
+	const double v = strtod(str, NULL);
+	if (isinf(v)) return SCPI_NUM_RANGE;
+
+	*value = v;
+	return SCPI_NUM_OK;
+}
+
+
+scpi_num_status_t scpi_parse_float(const char *str, float *value)
+{
+	scpi_decimal_t dec;
+	scpi_num_status_t st = scan_whole(str, &dec);
+	if (st != SCPI_NUM_OK) return st;
+
+	uint64_t m = dec.mant;
+	int32_t e = dec.exp10;
+
+	if (m == 0) {
+		*value = dec.negative ? -0.0f : 0.0f;
+		return SCPI_NUM_OK;
+	}
+
+	// single precision fast path - hardware FPU on Cortex-M4
+	if (!dec.truncated) {
+		shift_exponent(&m, &e, 10, 1UL << 24);
+
+		if (m <= (1UL << 24) && e >= -10 && e <= 10) {
+			float v = (float) m;
+			v = (e < 0) ? v / pow10_f[-e] : v * pow10_f[e];
+			*value = dec.negative ? -v : v;
+			return SCPI_NUM_OK;
+		}
+	}
+
+	const float v = strtof(str, NULL);
+	if (isinf(v)) return SCPI_NUM_RANGE;
+
+	*value = v;
+	return SCPI_NUM_OK;
+}
+
+
+// ---- integers ----
+
+/** IEEE 488.2 non-decimal numeric (#H, #Q, #B), as a bit pattern of 'bits' bits */
+static scpi_num_status_t parse_nondecimal(const char *str, uint8_t bits, uint64_t *value)
+{
+	uint8_t shift; // bits per digit
+
+	switch (str[1]) {
+		case 'H': case 'h': shift = 4; break;
+		case 'Q': case 'q': shift = 3; break;
+		case 'B': case 'b': shift = 1; break;
+		default: return SCPI_NUM_SYNTAX;
+	}
+
+	const char *p = str + 2;
+	if (*p == 0) return SCPI_NUM_SYNTAX;
+
+	uint64_t v = 0;
+	for (; *p != 0; p++) {
+		const char c = *p;
+		uint8_t d;
+
+		if (IS_DIGIT(c)) {
+			d = (uint8_t)(c - '0');
+		} else if (c >= 'A' && c <= 'F') {
+			d = (uint8_t)(c - 'A' + 10);
+		} else if (c >= 'a' && c <= 'f') {
+			d = (uint8_t)(c - 'a' + 10);
+		} else {
+			return SCPI_NUM_SYNTAX;
+		}
+
+		if (d >= (1U << shift)) return SCPI_NUM_SYNTAX;
+
+		// bits that would be shifted out of the type
+		if ((v >> (bits - shift)) != 0) return SCPI_NUM_DIGITS;
+		v = (v << shift) | d;
+	}
+
+	*value = v;
+	return SCPI_NUM_OK;
+}
+
+
+static const uint64_t pow10_u64[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+	10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+
+/**
+ * Parse a decimal or non-decimal integer.
+ *
+ * @param max largest magnitude of a positive value (negative may be one more)
+ * @param bits width of the type (for non-decimal numbers)
+ */
+static scpi_num_status_t parse_integer(const char *str, uint64_t max, uint8_t bits, int64_t *value)
+{
+	if (str[0] == '#') {
+		uint64_t v;
+		scpi_num_status_t st = parse_nondecimal(str, bits, &v);
+		if (st != SCPI_NUM_OK) return st;
+
+		// sign-extend the bit pattern
+		if (bits < 64 && (v & (1ULL << (bits - 1)))) v |= ~0ULL << bits;
+		*value = (int64_t) v;
+		return SCPI_NUM_OK;
+	}
+
+	scpi_decimal_t dec;
+	scpi_num_status_t st = scan_whole(str, &dec);
+	if (st != SCPI_NUM_OK) return st;
+	if (dec.truncated) return SCPI_NUM_DIGITS;
+
+	const uint64_t limit = dec.negative ? max + 1 : max;
+	uint64_t m = dec.mant;
+	int32_t e = dec.exp10;
+
+	if (m != 0 && e < 0) {
+		// fraction - round half away from zero
+		if (e < -19) {
+			m = 0;
+		} else {
+			const uint64_t p = pow10_u64[-e];
+			const uint64_t r = m % p;
+			m /= p;
+			if (r >= p - r) m++;
+		}
+		e = 0;
+	}
+
+	if (m > limit) return SCPI_NUM_DIGITS;
+
+	for (; m != 0 && e > 0; e--) {
+		if (m > limit / 10) return SCPI_NUM_EXPONENT;
+		m *= 10;
+	}
+
+	*value = dec.negative ? (int64_t)(0 - m) : (int64_t) m;
+	return SCPI_NUM_OK;
+}
+
+
+scpi_num_status_t scpi_parse_int(const char *str, int32_t *value)
+{
+	int64_t v;
+	scpi_num_status_t st = parse_integer(str, INT32_MAX, 32, &v);
+	if (st == SCPI_NUM_OK) *value = (int32_t) v;
+
+	return st;
+}
+
+
+scpi_num_status_t scpi_parse_int64(const char *str, int64_t *value)
+{
+	return parse_integer(str, INT64_MAX, 64, value);
+}
+
+
+// ---- fixed point ----
+
+scpi_num_status_t scpi_parse_fixed(const char *str, uint8_t format, int32_t *value)
+{
+	scpi_decimal_t dec;
+	scpi_num_status_t st = scan_whole(str, &dec);
+	if (st != SCPI_NUM_OK) return st;
+
+	// digits past the 19th are below the resolution, dec.truncated doesn't matter here
+	int32_t e = dec.exp10;
+	uint8_t q = 0; // fraction bits
+
+	if (format & 0x80) {
+		e += format & 0x7F; // decimal scale is just a shifted exponent
+	} else {
+		q = format;
+	}
+
+	const uint64_t limit = dec.negative ? (uint64_t) INT32_MAX + 1 : INT32_MAX;
+	const uint64_t int_limit = limit >> q; // max integer part
+	uint64_t m = dec.mant;
+
+	if (m != 0 && e >= 0) {
+		for (; e > 0; e--) {
+			if (m > int_limit / 10) return SCPI_NUM_RANGE;
+			m *= 10;
+		}
+
+		if (m > int_limit) return SCPI_NUM_RANGE;
+		m <<= q;
+	} else if (m != 0) {
+		// keep the divisor below 2^63, the dropped digits are far below 2^-31
+		for (; e < -18; e++) m /= 10;
+
+		const uint64_t p = pow10_u64[-e];
+		uint64_t r = m % p;
+		m /= p;
+
+		if (m > int_limit) return SCPI_NUM_RANGE;
+
+		// fraction bits by long division of the remainder
+		for (uint8_t i = 0; i < q; i++) {
+			r <<= 1;
+			m <<= 1;
+			if (r >= p) {
+				r -= p;
+				m |= 1;
+			}
+		}
+
+		if (r >= p - r) m++; // round half away from zero
+		if (m > limit) return SCPI_NUM_RANGE;
+	}
+
+	*value = (int32_t)(dec.negative ? -(int64_t) m : (int64_t) m);
+	return SCPI_NUM_OK;
+}
@@ -5,14 +5,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <math.h>
 
 #include "scpi_parser.h"
 #include "scpi_errors.h"
 #include "scpi_builtins.h"
 #include "scpi_regs.h"
+#include "scpi_num.h"
+#include "scpi_resp.h"
+#include "scpi_crc.h"
+#include "scpi_ctx.h"
 
 // Config
-#define MAX_CHARBUF_LEN 64
+#define MAX_CHARBUF_LEN SCPI_MAX_STRING_LEN
 
 
 // Char matching
@@ -22,20 +27,36 @@
 #define IS_LCASE_CHAR(c) INRANGE((c), 'a', 'z')
 #define IS_UCASE_CHAR(c) INRANGE((c), 'A', 'Z')
 #define IS_NUMBER_CHAR(c) INRANGE((c), '0', '9')
-//#define IS_MULTIPLIER_CHAR(c) ((c) == 'k' || (c) == 'M' || (c) == 'G' || (c) == 'm' || (c) == 'u' || (c) == 'n' || (c) == 'p')
 
 // A-Z a-z 0-9 _
 #define IS_CHARDATA_CHAR(c) (IS_LCASE_CHAR((c)) || IS_UCASE_CHAR((c)) || IS_NUMBER_CHAR((c)) || (c) == '_')
 // A-Z a-z 0-9 _ * ?
 #define IS_IDENT_CHAR(c) (IS_CHARDATA_CHAR((c)) || (c) == '*' || (c) == '?')
-// 0-9 - +
-#define IS_INT_CHAR(c) (IS_NUMBER_CHAR((c)) || (c) == '-' || (c) == '+')
-// 0-9 . + - eE
-#define IS_FLOAT_CHAR(c) (IS_NUMBER_CHAR((c)) || (c) == '.' || (c) == 'e' || (c) == 'E' || (c) == '+' || (c) == '-')
+// 0-9 . + - A-Z a-z (exponent, unit suffix)
+#define IS_FLOAT_CHAR(c) (IS_NUMBER_CHAR((c)) || IS_LCASE_CHAR((c)) || IS_UCASE_CHAR((c)) || (c) == '.' || (c) == '+' || (c) == '-')
+// as FLOAT, and # (#H, #Q, #B non-decimal)
+#define IS_INT_CHAR(c) (IS_FLOAT_CHAR((c)) || (c) == '#')
 
 #define CHAR_TO_LOWER(ucase) ((ucase) + 32)
 #define CHAR_TO_UPPER(lcase) ((lcase) - 32)
 
+// Command lookup - generated index, automaton built at startup, or linear scan
+#if !defined(SCPI_CMD_INDEX) && SCPI_CMD_TRIE_NODES > 0
+#define USE_CMD_TRIE
+#endif
+
+// Compressed block data - needs the history window
+#if SCPI_BLOB_WINDOW > 0
+#define USE_BLOB_CODEC
+#if (SCPI_BLOB_WINDOW & (SCPI_BLOB_WINDOW - 1)) != 0
+#error "SCPI_BLOB_WINDOW must be a power of two"
+#endif
+#endif
+
+#if SCPI_ARG_ARENA_LEN < SCPI_ARG_ARENA_MIN
+#error "SCPI_ARG_ARENA_LEN too small for SCPI_MAX_PARAM_COUNT arguments (see SCPI_ARG_ARENA_MIN)"
+#endif
+
 
 
 /** Parser internal state enum */
@@ -44,6 +65,7 @@ typedef enum ParserStateEnum {
 	// collect generic arg, terminated with comma or newline. Leading and trailing whitespace ignored.
 	PARS_ARG, // generic argument (bool, float...)
 	PARS_ARG_STRING, // collect arg - string (special treatment for quotes)
+	PARS_ARG_CHANLIST, // channel list, decoded while receiving it
 	PARS_ARG_BLOB_PREAMBLE, // #nDDD
 	PARS_ARG_BLOB_DISCARD, // discard blob - same as BLOB_BODY, but no callback or buffering
 	PARS_ARG_BLOB_BODY, // blob body, callback for each group
@@ -53,168 +75,273 @@ typedef enum ParserStateEnum {
 } parser_state_t;
 
 
+/** Channel list decoder state */
+typedef enum {
+	CHAN_NONE = 0, // no channel list in the current arg
+	CHAN_OPEN, // got '(', expecting '@'
+	CHAN_LIST, // receiving the list
+	CHAN_DONE, // got ')'
+} chan_state_t;
 
-/** Parser internal state struct */
-static struct ParserInternalStateStruct {
-	parser_state_t state; // current parser internal state
-
-	// string buffer, chars collected here until recognized
-	char charbuf[MAX_CHARBUF_LEN + 1];
-	uint16_t charbuf_i;
-
-	uint32_t blob_cnt; // preamble counter, if 0, was just #, must read count. Used also for blob body.
-	uint32_t blob_len; // total blob length to read
-
-	char string_quote; // symbol used to quote string
-	bool string_escape; // last char was backslash, next quote is literal
-
-	// recognized complete command level strings (FUNCtion) - exact copy from command struct
-	char cur_levels[SCPI_MAX_LEVEL_COUNT][SCPI_MAX_CMD_LEN];
-	uint8_t cur_level_i; // next free level slot index
-
-	bool cmdbuf_kept; // set to 1 after semicolon - cur_levels is kept (removed last part)
 
-	const SCPI_command_t * matched_cmd; // command is put here after recognition, used as reference for args
+/** Block data decoder state */
+typedef enum {
+	DEC_TOKEN = 0, // LZ4 sequence token, RLE header byte
+	DEC_LIT_LEN, // LZ4 literal length bytes
+	DEC_LITERAL, // literal bytes
+	DEC_OFFSET_LO, // LZ4 match offset
+	DEC_OFFSET_HI,
+	DEC_MATCH_LEN, // LZ4 match length bytes
+	DEC_RLE_BYTE, // RLE repeated byte
+} blob_dec_state_t;
 
-	SCPI_argval_t args[SCPI_MAX_PARAM_COUNT];
-	uint8_t arg_i; // next free argument slot index
 
-} pst = {/*EMPTY*/}; // initialized by all zeros
 
-
-// buffer for error messages
-static char ebuf[100];
+#ifdef USE_BLOB_CODEC
+#define BLOB_WIN_MASK (SCPI_BLOB_WINDOW - 1)
+#endif
 
 // ---------------- PRIVATE PROTOTYPES ------------------
 
 // Command parsing
-static void pars_cmd_colon(void); // colon starting a command sub-segment
-static void pars_cmd_space(void); // space ending a command
-static void pars_cmd_newline(void); // LF
-static void pars_cmd_semicolon(void); // semicolon right after a command
+static void pars_cmd_colon(scpi_ctx_t *ctx); // colon starting a command sub-segment
+static void pars_cmd_space(scpi_ctx_t *ctx); // space ending a command
+static void pars_cmd_newline(scpi_ctx_t *ctx); // LF
+static void pars_cmd_semicolon(scpi_ctx_t *ctx); // semicolon right after a command
 
 // Command properties (find length of array)
 static uint8_t cmd_param_count(const SCPI_command_t *cmd);
 static uint8_t cmd_level_count(const SCPI_command_t *cmd);
+static const SCPI_param_ext_t *cmd_ext(const SCPI_command_t *cmd);
+static bool char_equals_ci(char a, char b);
 
-static bool match_cmd(bool partial);
-static bool match_any_cmd_from_array(const SCPI_command_t arr[], bool partial);
-static bool match_cmd_do(const SCPI_command_t *cmd, bool partial);
-static void run_command_callback(void);
+static void cmd_index_init(void);
+static void cmd_index_feed(scpi_ctx_t *ctx, char c);
+static bool match_cmd(scpi_ctx_t *ctx, bool partial);
+static bool match_any_cmd_from_array(scpi_ctx_t *ctx, const SCPI_command_t arr[], bool partial);
+static bool match_cmd_do(scpi_ctx_t *ctx, const SCPI_command_t *cmd, bool partial);
+static void run_command_callback(scpi_ctx_t *ctx);
 
 // Argument parsing
-static void pars_arg_char(char c);
-static void pars_arg_comma(void);
-static void pars_arg_newline(void);
-static void pars_arg_semicolon(void);
-static void pars_blob_preamble_char(uint8_t c);
-static void arg_convert_value(void);
-
-static void charbuf_terminate(void);
-static void charbuf_append(char c);
+static void pars_arg_char(scpi_ctx_t *ctx, char c);
+static void pars_arg_comma(scpi_ctx_t *ctx);
+static void pars_arg_newline(scpi_ctx_t *ctx);
+static void pars_arg_semicolon(scpi_ctx_t *ctx);
+static void pars_blob_preamble_char(scpi_ctx_t *ctx, uint8_t c);
+static size_t pars_blob_body(scpi_ctx_t *ctx, const uint8_t *buf, size_t len);
+static size_t pars_blob_discard(scpi_ctx_t *ctx, size_t len);
+static size_t pars_discard_line(scpi_ctx_t *ctx, const uint8_t *buf, size_t len);
+static void blob_deliver_rest(scpi_ctx_t *ctx);
+static void blob_end(scpi_ctx_t *ctx);
+static void arg_convert_value(scpi_ctx_t *ctx);
+static void arg_lazy_convert(scpi_ctx_t *ctx, uint8_t index);
+static void pars_chan_char(scpi_ctx_t *ctx, char c);
+static void chan_start(scpi_ctx_t *ctx);
+static void limit_query(scpi_ctx_t *ctx);
+static void enum_feed(scpi_ctx_t *ctx, char c);
+static void list_element(scpi_ctx_t *ctx);
+static void string_char(scpi_ctx_t *ctx, char c);
+static size_t pars_string_stream(scpi_ctx_t *ctx, const uint8_t *buf, size_t len);
+
+static void *arena_alloc(scpi_ctx_t *ctx, size_t size);
+static const char *arena_strdup(scpi_ctx_t *ctx, const char *str);
+
+static void charbuf_terminate(scpi_ctx_t *ctx);
+static void charbuf_append(scpi_ctx_t *ctx, char c);
 
 // Reset
-static void pars_reset_cmd(void);
-static void pars_reset_cmd_keeplevel(void);
+static void pars_reset_cmd(scpi_ctx_t *ctx);
+static void pars_reset_cmd_keeplevel(scpi_ctx_t *ctx);
 
 
 // ------------------- MESSAGE SEND ------------------
 
+/** Pass bytes on to the first output hook available */
+static void out_write(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+	if (len == 0) return;
+
+	if (scpi_send_iov_impl) {
+		const scpi_iovec_t v = {buf, len};
+		scpi_send_iov_impl(ctx, &v, 1);
+	} else if (scpi_send_buf_impl) {
+		scpi_send_buf_impl(ctx, buf, len);
+	} else if (scpi_send_byte_impl) {
+		for (size_t i = 0; i < len; i++) {
+			scpi_send_byte_impl(ctx, buf[i]);
+		}
+	}
+}
+
+
+void scpi_send_flush(scpi_ctx_t *ctx)
+{
+#if SCPI_OUT_BUF_LEN > 0
+	if (ctx->obuf_len == 0) return;
+
+	out_write(ctx, ctx->obuf, ctx->obuf_len);
+	ctx->obuf_len = 0;
+#else
+	(void)ctx;
+#endif
+}
+
+
+/** Send bytes, no \r\n */
+void scpi_send_buf(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+#if SCPI_OUT_BUF_LEN > 0
+	if (ctx->obuf_len + len > SCPI_OUT_BUF_LEN) {
+		scpi_send_flush(ctx);
+
+		if (len >= SCPI_OUT_BUF_LEN) {
+			// too big to buffer, no point in copying it
+			out_write(ctx, buf, len);
+			return;
+		}
+	}
+
+	memcpy(&ctx->obuf[ctx->obuf_len], buf, len);
+	ctx->obuf_len += len;
+#else
+	out_write(ctx, buf, len);
+#endif
+}
+
+
 /** Send string, no \r\n */
-void scpi_send_string_raw(const char *message)
+void scpi_send_string_raw(scpi_ctx_t *ctx, const char *message)
+{
+	scpi_send_buf(ctx, (const uint8_t *) message, strlen(message));
+}
+
+
+void scpi_send_message(scpi_ctx_t *ctx, const scpi_iovec_t *iov, uint8_t count)
 {
-	char c;
-	while ((c = *message++) != 0) {
-		scpi_send_byte_impl(c);
+	if (scpi_send_iov_impl) {
+		// buffered output + parts + newline, in one write if they fit
+		scpi_iovec_t v[SCPI_SEND_IOV_MAX + 2];
+		uint8_t n = 0;
+		uint8_t parts = 0;
+
+#if SCPI_OUT_BUF_LEN > 0
+		if (ctx->obuf_len > 0) {
+			v[n++] = (scpi_iovec_t) {ctx->obuf, ctx->obuf_len};
+		}
+#endif
+		for (uint8_t i = 0; i < count; i++) {
+			if (iov[i].len == 0) continue;
+
+			if (parts == SCPI_SEND_IOV_MAX) {
+				// write in batches of SCPI_SEND_IOV_MAX parts
+				scpi_send_iov_impl(ctx, v, n);
+				n = 0;
+				parts = 0;
+			}
+			v[n++] = iov[i];
+			parts++;
+		}
+		v[n++] = (scpi_iovec_t) {scpi_eol, strlen(scpi_eol)};
+
+		scpi_send_iov_impl(ctx, v, n);
+#if SCPI_OUT_BUF_LEN > 0
+		ctx->obuf_len = 0;
+#endif
+		return;
+	}
+
+	// collect in the buffer, flushed by the newline
+	for (uint8_t i = 0; i < count; i++) {
+		scpi_send_buf(ctx, iov[i].base, iov[i].len);
 	}
+	scpi_send_string_raw(ctx, scpi_eol);
+	scpi_send_flush(ctx);
 }
 
 
 /** Send a message to master. Trailing newline is added. */
-void scpi_send_string(const char *message)
+void scpi_send_string(scpi_ctx_t *ctx, const char *message)
 {
-	scpi_send_string_raw(message);
-	scpi_send_string_raw(scpi_eol);
+	const scpi_iovec_t v = {message, strlen(message)};
+	scpi_send_message(ctx, &v, 1);
 }
 
 // ------- Error shortcuts ----------
 
-static void err_no_such_command(void)
+static void err_no_such_command(scpi_ctx_t *ctx)
 {
-	char *b = ebuf;
-	for (int i = 0; i < pst.cur_level_i; i++) {
+	char *b = ctx->pst.ebuf;
+	for (int i = 0; i < ctx->pst.cur_level_i; i++) {
 		if (i > 0) b += sprintf(b, ":");
-		b += sprintf(b, "%s", pst.cur_levels[i]);
+		b += sprintf(b, "%s", ctx->pst.cur_levels[i]);
 	}
 
-	scpi_add_error(E_CMD_UNDEFINED_HEADER, ebuf);
+	scpi_add_error(ctx, E_CMD_UNDEFINED_HEADER, ctx->pst.ebuf);
 }
 
 
-static void err_no_such_command_partial(void)
+static void err_no_such_command_partial(scpi_ctx_t *ctx)
 {
-	char *b = ebuf;
-	for (int i = 0; i < pst.cur_level_i; i++) {
-		b += sprintf(b, "%s:", pst.cur_levels[i]);
+	char *b = ctx->pst.ebuf;
+	for (int i = 0; i < ctx->pst.cur_level_i; i++) {
+		b += sprintf(b, "%s:", ctx->pst.cur_levels[i]);
 	}
 
-	scpi_add_error(E_CMD_UNDEFINED_HEADER, ebuf);
+	scpi_add_error(ctx, E_CMD_UNDEFINED_HEADER, ctx->pst.ebuf);
 }
 
 
 // ----------------- INPUT PARSING ----------------
 
-void scpi_handle_string(const char* str)
+size_t scpi_handle_string(scpi_ctx_t *ctx, const char* str)
 {
-	while (*str != 0) {
-		scpi_handle_byte(*str);
-		str++;
-	}
+	return scpi_handle_buffer(ctx, (const uint8_t *) str, strlen(str));
 }
 
-void scpi_handle_byte(const uint8_t b)
+bool scpi_handle_byte(scpi_ctx_t *ctx, const uint8_t b)
 {
 	const char c = (char) b;
 
-	switch (pst.state) {
+	switch (ctx->pst.state) {
 		case PARS_COMMAND:
 			// Collecting command
 
 			if (IS_IDENT_CHAR(c)) {
 				// valid command char
 
-				if (pst.charbuf_i < SCPI_MAX_CMD_LEN) {
-					charbuf_append(c);
+				if (ctx->pst.charbuf_i < SCPI_MAX_CMD_LEN) {
+					cmd_index_feed(ctx, c);
+					charbuf_append(ctx, c);
 				} else {
-					scpi_add_error(E_CMD_PROGRAM_MNEMONIC_TOO_LONG, NULL);
-					pst.state = PARS_DISCARD_LINE;
+					scpi_add_error(ctx, E_CMD_PROGRAM_MNEMONIC_TOO_LONG, NULL);
+					ctx->pst.state = PARS_DISCARD_LINE;
 				}
 
 			} else {
 				// invalid or delimiter
 
 				if (IS_WHITESPACE(c)) {
-					pars_cmd_space(); // whitespace in command - end of command, start of args (?)
+					pars_cmd_space(ctx); // whitespace in command - end of command, start of args (?)
 					break;
 				}
 
 				switch (c) {
 					case ':':
-						pars_cmd_colon(); // end of a section
+						pars_cmd_colon(ctx); // end of a section
 						break;
 
 					case '\n': // line terminator
-						pars_cmd_newline();
+						pars_cmd_newline(ctx);
 						break;
 
 					case ';': // ends a command, does not reset cmd path.
-						pars_cmd_semicolon();
+						pars_cmd_semicolon(ctx);
 						break;
 
 					default:
-						sprintf(ebuf, "Unexpected '%c' in command.", c);
-						scpi_add_error(E_CMD_INVALID_CHARACTER, ebuf);
-						pst.state = PARS_DISCARD_LINE;
+						sprintf(ctx->pst.ebuf, "Unexpected '%c' in command.", c);
+						scpi_add_error(ctx, E_CMD_INVALID_CHARACTER, ctx->pst.ebuf);
+						ctx->pst.state = PARS_DISCARD_LINE;
 				}
 			}
 			break;
@@ -222,7 +349,7 @@ void scpi_handle_byte(const uint8_t b)
 		case PARS_DISCARD_LINE:
 			// drop it. Clear state on newline.
 			if (c == '\r' || c == '\n') {
-				pars_reset_cmd();
+				pars_reset_cmd(ctx);
 			}
 
 			break;
@@ -232,15 +359,15 @@ void scpi_handle_byte(const uint8_t b)
 			if (IS_WHITESPACE(c)) break;
 
 			if (c == '\n') {
-				if (pst.state != PARS_TRAILING_WHITE_NOCB) {
-					run_command_callback();
+				if (ctx->pst.state != PARS_TRAILING_WHITE_NOCB) {
+					run_command_callback(ctx);
 				}
 
-				pars_reset_cmd();
+				pars_reset_cmd(ctx);
 			} else {
-				sprintf(ebuf, "Unexpected '%c' in trailing whitespace.", c);
-				scpi_add_error(E_CMD_INVALID_CHARACTER, ebuf);
-				pst.state = PARS_DISCARD_LINE;
+				sprintf(ctx->pst.ebuf, "Unexpected '%c' in trailing whitespace.", c);
+				scpi_add_error(ctx, E_CMD_INVALID_CHARACTER, ctx->pst.ebuf);
+				ctx->pst.state = PARS_DISCARD_LINE;
 			}
 
 			break; // whitespace discarded
@@ -250,41 +377,45 @@ void scpi_handle_byte(const uint8_t b)
 
 			switch (c) {
 				case ',':
-					pars_arg_comma();
+					pars_arg_comma(ctx);
 					break;
 
 				case '\n':
-					pars_arg_newline();
+					pars_arg_newline(ctx);
 					break;
 
 				case ';':
-					pars_arg_semicolon();
+					pars_arg_semicolon(ctx);
 					break;
 
 				default:
-					pars_arg_char(c);
+					pars_arg_char(ctx, c);
 			}
 			break;
 
+		case PARS_ARG_CHANLIST:
+			pars_chan_char(ctx, c);
+			break;
+
 		case PARS_ARG_STRING:
 			// string
 
-			if (c == pst.string_quote && !pst.string_escape) {
+			if (c == ctx->pst.string_quote && !ctx->pst.string_escape) {
 				// end of string
-				pst.state = PARS_ARG; // next will be newline or comma (or ignored spaces)
+				ctx->pst.state = PARS_ARG; // next will be newline or comma (or ignored spaces)
 			} else if (c == '\n') {
-				scpi_add_error(E_CMD_STRING_DATA_ERROR, "String not terminated (unexpected newline).");
+				scpi_add_error(ctx, E_CMD_STRING_DATA_ERROR, "String not terminated (unexpected newline).");
 
-				pst.state = PARS_DISCARD_LINE;
+				pars_reset_cmd(ctx); // the newline ends the message
 			} else {
-				if (pst.string_escape) {
-					charbuf_append(c);
-					pst.string_escape = false;
+				if (ctx->pst.string_escape) {
+					string_char(ctx, c);
+					ctx->pst.string_escape = false;
 				} else {
 					if (c == '\\') {
-						pst.string_escape = true;
+						ctx->pst.string_escape = true;
 					} else {
-						charbuf_append(c);
+						string_char(ctx, c);
 					}
 				}
 			}
@@ -292,661 +423,2831 @@ void scpi_handle_byte(const uint8_t b)
 
 		case PARS_ARG_BLOB_PREAMBLE:
 			// #<digits><dddddd><BLOB>
-			pars_blob_preamble_char(c);
+			pars_blob_preamble_char(ctx, c);
 			break;
 
 		case PARS_ARG_BLOB_BODY:
 			// binary blob body with callback on buffer full
-
-			charbuf_append(c);
-			pst.blob_cnt++;
-
-			if (pst.charbuf_i >= pst.matched_cmd->blob_chunk) {
-				charbuf_terminate();
-
-				if (pst.matched_cmd->blob_callback != NULL) {
-					pst.matched_cmd->blob_callback((uint8_t *)pst.charbuf);
-				}
-			}
-
-			if (pst.blob_cnt == pst.blob_len) {
-				pst.state = PARS_TRAILING_WHITE_NOCB; // discard trailing whitespace until newline
-			}
-
-			break;
+			return pars_blob_body(ctx, &b, 1) != 0; // not accepted if blob buffers are full
 
 		case PARS_ARG_BLOB_DISCARD:
 			// binary blob, discard incoming data
-
-			pst.blob_cnt++;
-
-			if (pst.blob_cnt == pst.blob_len) {
-				pst.state = PARS_DISCARD_LINE;
-			}
-
+			pars_blob_discard(ctx, 1);
 			break;
 	}
+
+	return true;
 }
 
 
+/** Handle a buffer of received bytes, with bulk processing of data runs */
+size_t scpi_handle_buffer(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+	size_t i = 0;
+	size_t n;
+
+	while (i < len) {
+		switch (ctx->pst.state) {
+			case PARS_DISCARD_LINE:
+				i += pars_discard_line(ctx, buf + i, len - i);
+				break;
+
+			case PARS_ARG_BLOB_BODY:
+				n = pars_blob_body(ctx, buf + i, len - i);
+				if (n == 0 && ctx->pst.state == PARS_ARG_BLOB_BODY) {
+					return i; // blob buffers full, can't take more now
+				}
 
-// ------------------- RESET INTERNAL STATE ------------------
+				i += n;
+				break;
 
+			case PARS_ARG_BLOB_DISCARD:
+				i += pars_blob_discard(ctx, len - i);
+				break;
 
-// public //
-/** Discard the rest of the currently processed blob */
-void scpi_discard_blob(void)
-{
-	if (pst.state == PARS_ARG_BLOB_BODY) {
-		pst.state = PARS_ARG_BLOB_DISCARD;
-	}
-}
+			case PARS_ARG_STRING:
+				if (ctx->pst.matched_cmd->params[ctx->pst.arg_i] == SCPI_DT_STRING_STREAM) {
+					i += pars_string_stream(ctx, buf + i, len - i);
+				} else {
+					scpi_handle_byte(ctx, buf[i++]);
+				}
+				break;
 
+			default:
+				scpi_handle_byte(ctx, buf[i++]);
+		}
+	}
 
-/** Reset parser state. */
-static void pars_reset_cmd(void)
-{
-	pst.state = PARS_COMMAND;
-	pst.charbuf_i = 0;
-	pst.cur_level_i = 0;
-	pst.cmdbuf_kept = false;
-	pst.matched_cmd = NULL;
-	pst.arg_i = 0;
-	pst.string_escape = false;
+	return i;
 }
 
 
-/** Reset parser state, keep level (semicolon) */
-static void pars_reset_cmd_keeplevel(void)
+/** END received with the last byte */
+void scpi_handle_end(scpi_ctx_t *ctx)
 {
-	pst.state = PARS_COMMAND;
-	pst.charbuf_i = 0;
+	if (ctx->pst.state == PARS_ARG_BLOB_BODY || ctx->pst.state == PARS_ARG_BLOB_DISCARD) {
+		if (!ctx->pst.blob_indefinite) {
+			scpi_add_error(ctx, E_CMD_BLOCK_DATA_ERROR, "Block data shorter than declared.");
+		} else if (ctx->pst.state == PARS_ARG_BLOB_BODY) {
+			// end of #0 block, the held newline was the terminator
+			blob_deliver_rest(ctx);
+
+			if (ctx->pst.state == PARS_ARG_BLOB_BODY) {
+				blob_end(ctx);
+			}
+		}
 
-	// rewind to last colon
-	if (pst.cur_level_i > 0) {
-		pst.cur_level_i--; // keep prev levels
+		pars_reset_cmd(ctx);
+		return;
 	}
 
-	pst.cmdbuf_kept = true;
-	pst.matched_cmd = NULL;
-	pst.arg_i = 0;
-	pst.string_escape = false;
+	// END terminates the message, same as newline
+	scpi_handle_byte(ctx, '\n');
 }
 
 
-// ------------------- COMMAND HELPERS -------------------
-
-/** Get param count from command struct */
-static uint8_t cmd_param_count(const SCPI_command_t *cmd)
+/** Drop bytes until the end of line (\r or \n, inclusive). Returns number of bytes consumed. */
+static size_t pars_discard_line(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
 {
-	for (uint8_t i = 0; i < SCPI_MAX_PARAM_COUNT; i++) {
-		if (cmd->params[i] == SCPI_DT_NONE) {
-			return i;
-		}
+	const uint8_t *end = memchr(buf, '\n', len);
+	const size_t scan_len = (end != NULL) ? (size_t)(end - buf) : len;
+
+	const uint8_t *cr = memchr(buf, '\r', scan_len);
+	if (cr != NULL) end = cr;
+
+	if (end == NULL) {
+		return len; // all dropped
 	}
 
-	return SCPI_MAX_PARAM_COUNT;
+	pars_reset_cmd(ctx);
+	return (size_t)(end - buf) + 1;
 }
 
 
-/** Get level count from command struct */
-static uint8_t cmd_level_count(const SCPI_command_t *cmd)
+/** Length of a blob chunk, limited by the chunk buffer */
+static uint16_t blob_chunk_len(scpi_ctx_t *ctx)
 {
-	for (uint8_t i = 0; i < SCPI_MAX_LEVEL_COUNT; i++) {
-		if (cmd->levels[i][0] == 0) {
-			return i;
-		}
-	}
-
-	return SCPI_MAX_LEVEL_COUNT;
-}
+	const uint32_t chunk = ctx->pst.matched_cmd->blob_chunk;
 
+	if (chunk == 0) return 1;
+	if (chunk > MAX_CHARBUF_LEN) return MAX_CHARBUF_LEN;
 
+	return chunk;
+}
 
-// ----------------- CHAR BUFFER HELPERS -------------------
 
-/** Add a byte to charbuf, error on overflow */
-static void charbuf_append(char c)
+/** Pass the collected blob chunk to the callback */
+static void blob_chunk_flush(scpi_ctx_t *ctx)
 {
-	if (pst.charbuf_i >= MAX_CHARBUF_LEN) {
-		scpi_add_error(E_DEV_INPUT_BUFFER_OVERRUN, NULL);
-		pst.state = PARS_DISCARD_LINE;
-	}
+	charbuf_terminate(ctx);
 
-	pst.charbuf[pst.charbuf_i++] = c;
+	if (ctx->pst.matched_cmd->blob_callback != NULL) {
+		ctx->pst.matched_cmd->blob_callback(ctx, (uint8_t *)ctx->pst.charbuf);
+	}
 }
 
 
-/** Terminate charbuf and rewind the pointer to start */
-static void charbuf_terminate(void)
+/** Receive blob body bytes, with the zero-copy callback. Returns number of bytes consumed. */
+static size_t pars_blob_body_zc(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
 {
-	pst.charbuf[pst.charbuf_i] = '\0';
-	pst.charbuf_i = 0;
-}
+	const uint32_t chunk = ctx->pst.matched_cmd->blob_chunk;
+	size_t used = 0;
 
+	while (used < len) {
+		const uint32_t chunk_start = ctx->pst.data_cnt - ctx->pst.chunk_pos;
 
+		uint32_t cur = ctx->pst.data_len - chunk_start; // current chunk length
+		if (chunk != 0 && cur > chunk) cur = chunk;
 
-// ----------------- PARSING COMMANDS ---------------
+		const uint32_t need = cur - ctx->pst.chunk_pos;
+		size_t n = len - used;
+		if (n > need) n = need;
 
-/** Colon received when collecting command parts */
-static void pars_cmd_colon(void)
-{
-	if (pst.charbuf_i == 0) {
-		// No command text before colon
+		ctx->pst.data_cnt += n;
+		ctx->pst.chunk_pos += n;
+		if (ctx->pst.chunk_pos == cur) ctx->pst.chunk_pos = 0;
 
-		if (pst.cur_level_i == 0 || pst.cmdbuf_kept) {
-			// top level command starts with colon (or after semicolon - reset level)
-			pars_reset_cmd(); // clears keep flag
+		if (ctx->pst.charbuf_i == 0 && (n == need || chunk == 0)) {
+			// chunk is in the input buffer, no copy
+			ctx->pst.matched_cmd->blob_data_callback(ctx, buf + used, n, ctx->pst.data_cnt - n);
 		} else {
-			// colon after nothing - error
-			scpi_add_error(E_CMD_SYNTAX_ERROR, "Unexpected colon.");
-
-			pst.state = PARS_DISCARD_LINE;
+			// chunk is split between input buffers, collect it
+			memcpy(&ctx->pst.charbuf[ctx->pst.charbuf_i], buf + used, n);
+			ctx->pst.charbuf_i += n;
+
+			if (ctx->pst.chunk_pos == 0) {
+				const uint16_t cnt = ctx->pst.charbuf_i;
+				ctx->pst.charbuf_i = 0;
+				ctx->pst.matched_cmd->blob_data_callback(ctx, (uint8_t *)ctx->pst.charbuf, cnt, chunk_start);
+			}
 		}
 
-	} else {
-		// internal colon - partial match
-		if (match_cmd(true)) {
-			// ok
-			pst.cmdbuf_kept = false; // drop the flag (needed for rejecting whitespace)
-		} else {
-			// error
-			err_no_such_command_partial();
+		used += n;
 
-			pst.state = PARS_DISCARD_LINE;
+		if (ctx->pst.state != PARS_ARG_BLOB_BODY) {
+			return used; // discarded by the callback
 		}
 	}
+
+	return used;
 }
 
 
-/** Semiolon received when collecting command parts */
-static void pars_cmd_semicolon(void)
+/** Pass the buffer being filled to the application, switch to the other one */
+static void blob_sink_flush(scpi_ctx_t *ctx)
 {
-	if (pst.cur_level_i == 0 && pst.charbuf_i == 0) {
-		// nothing before semicolon
-		scpi_add_error(E_CMD_SYNTAX_ERROR, "Semicolon not preceded by command.");
-		pars_reset_cmd();
-		return;
-	}
+	const uint8_t i = ctx->pst.sink_i;
+	const uint32_t cnt = ctx->pst.sink_fill;
 
-	if (match_cmd(false)) {
-		int req_cnt = cmd_param_count(pst.matched_cmd);
+	ctx->pst.sink_busy[i] = true; // until released
+	ctx->pst.sink_i = i ^ 1;
+	ctx->pst.sink_fill = 0;
 
-		if (req_cnt == 0) {
-			// no param command - OK
-			run_command_callback();
-			pars_reset_cmd_keeplevel(); // keep level - that's what semicolon does
-		} else {
-			sprintf(ebuf, "Required %d, got 0.", req_cnt);
-			scpi_add_error(E_CMD_MISSING_PARAMETER, ebuf);
-			pars_reset_cmd();
-		}
-	} else {
-		err_no_such_command();
-		pst.state = PARS_DISCARD_LINE;
-	}
+	ctx->pst.sink_cb(ctx, ctx->pst.sink_buf[i], cnt, ctx->pst.data_cnt - cnt);
 }
 
 
-/** Newline received when collecting command - end command and execute. */
-static void pars_cmd_newline(void)
+/** Receive blob body bytes into the user buffers. Returns number of bytes consumed (0 if both are full). */
+static size_t pars_blob_body_sink(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
 {
-	if (pst.cur_level_i == 0 && pst.charbuf_i == 0) {
-		// nothing before newline
-		pars_reset_cmd();
-		return;
-	}
-
-	// complete match
-	if (match_cmd(false)) {
-		int req_cnt = cmd_param_count(pst.matched_cmd);
-
-		if (req_cnt == 0) {
-			// no param command - OK
-			run_command_callback();
-			pars_reset_cmd();
-		} else {
-			// error
-			sprintf(ebuf, "Required %d, got 0.", req_cnt);
-			scpi_add_error(E_CMD_MISSING_PARAMETER, ebuf);
+	size_t used = 0;
 
-			pars_reset_cmd();
+	while (used < len) {
+		if (ctx->pst.sink_busy[ctx->pst.sink_i]) {
+			break; // both buffers in use, wait for release
 		}
 
-	} else {
-		err_no_such_command();
-		pars_reset_cmd();
-	}
-}
+		size_t n = ctx->pst.sink_len - ctx->pst.sink_fill;
+		if (n > len - used) n = len - used;
 
+		memcpy(ctx->pst.sink_buf[ctx->pst.sink_i] + ctx->pst.sink_fill, buf + used, n);
+		ctx->pst.sink_fill += n;
+		ctx->pst.data_cnt += n;
+		used += n;
 
-/** Whitespace received when collecting command parts */
-static void pars_cmd_space(void)
-{
-	if ((pst.cmdbuf_kept || pst.cur_level_i == 0) && pst.charbuf_i == 0) {
-		// leading whitespace, ignore
-		return;
-	}
+		if (ctx->pst.sink_fill == ctx->pst.sink_len) {
+			blob_sink_flush(ctx); // may discard the blob
+		}
 
-	if (match_cmd(false)) {
-		if (cmd_param_count(pst.matched_cmd) == 0) {
-			// no commands
-			pst.state = PARS_TRAILING_WHITE;
-		} else {
-			pst.state = PARS_ARG;
+		if (ctx->pst.state != PARS_ARG_BLOB_BODY) {
+			return used;
 		}
-	} else {
-		// error
-		err_no_such_command();
-		pst.state = PARS_DISCARD_LINE;
 	}
+
+	return used;
 }
 
 
-/** Check if chars equal, ignore case */
-static bool char_equals_ci(char a, char b)
+/** Pass blob body bytes to the user buffers or callback. Returns number of bytes consumed. */
+static size_t blob_deliver_do(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
 {
-	if (IS_LCASE_CHAR(a)) {
-
-		if (IS_LCASE_CHAR(b)) {
-			return a == b;
-		} else if (IS_UCASE_CHAR(b)) {
-			return a == CHAR_TO_LOWER(b);
-		} else {
-			return false;
-		}
-
-	} else if (IS_UCASE_CHAR(a)) {
+	size_t used = 0;
 
-		if (IS_UCASE_CHAR(b)) {
-			return a == b;
-		} else if (IS_LCASE_CHAR(b)) {
-			return a == CHAR_TO_UPPER(b);
-		} else {
-			return false;
-		}
+	if (ctx->pst.sink_len != 0) {
+		return pars_blob_body_sink(ctx, buf, len);
+	}
 
-	} else {
-		return a == b; // exact match, not letters
+	if (ctx->pst.matched_cmd->blob_data_callback != NULL) {
+		return pars_blob_body_zc(ctx, buf, len);
 	}
-}
 
+	const uint16_t chunk = blob_chunk_len(ctx);
 
-/** Check if command matches a pattern */
-static bool level_str_matches(const char *test, const char *pattern)
-{
-	const uint8_t testlen = strlen(test);
-	uint8_t pat_i, tst_i;
-	bool long_started = false;
-	for (pat_i = 0, tst_i = 0; pat_i < strlen(pattern); pat_i++) {
-		if (tst_i > testlen) return false; // not match
+	while (used < len) {
+		size_t n = chunk - ctx->pst.charbuf_i;
+		if (n > len - used) n = len - used;
 
-		const char pat_c = pattern[pat_i];
-		const char tst_c = test[tst_i]; // may be at the \0 terminator
+		memcpy(&ctx->pst.charbuf[ctx->pst.charbuf_i], buf + used, n);
+		ctx->pst.charbuf_i += n;
+		ctx->pst.data_cnt += n;
+		used += n;
 
-		if (IS_LCASE_CHAR(pat_c)) {
-			// optional char
-			if (char_equals_ci(pat_c, tst_c)) {
-				tst_i++; // advance test string
-				long_started = true;
-			} else {
-				if (long_started) return false; // once long variant started, it must be completed.
-			}
+		if (ctx->pst.charbuf_i >= chunk) {
+			blob_chunk_flush(ctx); // may discard the blob
+		}
 
-			continue; // next pi - tc stays in place
-		} else {
-			// require exact match (case insensitive)
-			if (char_equals_ci(pat_c, tst_c)) {
-				tst_i++;
-			} else {
-				return false;
-			}
+		if (ctx->pst.state != PARS_ARG_BLOB_BODY) {
+			break;
 		}
 	}
 
-	return (tst_i >= testlen);
+	return used;
 }
 
 
-/**
- * Match content of the charbuf to a command.
- * @param partial - match also parts of a command (until a colon)
- */
-static bool match_cmd(bool partial)
-{
-	charbuf_terminate(); // zero-end and rewind index
+#ifdef USE_BLOB_CODEC
 
-	// copy to level table
-	char *dest = pst.cur_levels[pst.cur_level_i++];
-	strcpy(dest, pst.charbuf);
+/** Append passed on bytes to the window */
+static void blob_win_push(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+	if (len > SCPI_BLOB_WINDOW) {
+		buf += len - SCPI_BLOB_WINDOW; // only the last part is kept
+		ctx->pst.win_pos += len - SCPI_BLOB_WINDOW;
+		len = SCPI_BLOB_WINDOW;
+	}
 
+	while (len > 0) {
+		const uint32_t start = ctx->pst.win_pos & BLOB_WIN_MASK;
+		size_t n = SCPI_BLOB_WINDOW - start;
+		if (n > len) n = len;
 
-	// User commands are checked first, can override builtin commands
-	if (match_any_cmd_from_array(scpi_commands, partial)) {
-		return true;
+		memcpy(&ctx->pst.blob_win[start], buf, n);
+		ctx->pst.win_pos += n;
+		buf += n;
+		len -= n;
 	}
-
-	// Try the built-in commands
-	return match_any_cmd_from_array(scpi_commands_builtin, partial);
 }
 
 
-static bool match_any_cmd_from_array(const SCPI_command_t arr[], bool partial)
+/**
+ * Generate the current match (or RLE repeat) in the window and pass it on.
+ * Returns false if not all could be passed on (blob buffers full).
+ */
+static bool blob_decode_run(scpi_ctx_t *ctx)
 {
-	for (uint16_t i = 0; i < 0xFFFF; i++) {
+	while (ctx->pst.state == PARS_ARG_BLOB_BODY) {
+		if (ctx->pst.dec_pend > 0) {
+			const uint32_t start = (ctx->pst.win_pos - ctx->pst.dec_pend) & BLOB_WIN_MASK;
+			uint32_t n = SCPI_BLOB_WINDOW - start;
+			if (n > ctx->pst.dec_pend) n = ctx->pst.dec_pend;
 
-		const SCPI_command_t *cmd = &arr[i];
-		if (cmd->levels[0][0] == 0) break; // end marker
+			const size_t done = blob_deliver_do(ctx, &ctx->pst.blob_win[start], n);
+			ctx->pst.dec_pend -= done;
 
-		if (cmd_level_count(cmd) > SCPI_MAX_LEVEL_COUNT) {
-			// FAIL, too deep. Bad config
+			if (done < n) break;
 			continue;
 		}
 
-		if (match_cmd_do(cmd, partial)) {
-			if (partial) {
-				// match found, OK
-				return true;
-			} else {
-				// exact match found
-				pst.matched_cmd = cmd;
-				return true;
-			}
+		if (ctx->pst.dec_run == 0) return true;
+
+		// up to the end of the window, so it's passed on in one piece
+		uint32_t n = SCPI_BLOB_WINDOW - (ctx->pst.win_pos & BLOB_WIN_MASK);
+		if (n > ctx->pst.dec_run) n = ctx->pst.dec_run;
+
+		for (uint32_t i = 0; i < n; i++) {
+			ctx->pst.blob_win[ctx->pst.win_pos & BLOB_WIN_MASK] = ctx->pst.blob_win[(ctx->pst.win_pos - ctx->pst.dec_off) & BLOB_WIN_MASK];
+			ctx->pst.win_pos++;
 		}
+
+		ctx->pst.dec_run -= n;
+		ctx->pst.dec_pend = n;
 	}
 
-	return false;
+	return ctx->pst.state != PARS_ARG_BLOB_BODY; // discarded
 }
 
 
-/** Try to match current state to a given command */
-static bool match_cmd_do(const SCPI_command_t *cmd, bool partial)
+/** Invalid compressed data - report and discard the rest of the blob */
+static void blob_decode_error(scpi_ctx_t *ctx, const char *msg)
 {
-	const uint8_t level_cnt = cmd_level_count(cmd);
-	if (pst.cur_level_i > level_cnt) return false; // command too short
-	if (pst.cur_level_i == 0) return false; // nothing to match
+	scpi_add_error(ctx, E_CMD_INVALID_BLOCK_DATA, msg);
+	scpi_discard_blob(ctx);
+}
 
-	if (partial) {
-		if (pst.cur_level_i == level_cnt) {
-			return false; // would be exact match
-		}
-	} else {
-		if (pst.cur_level_i != level_cnt) {
-			return false; // can be only partial match
-		}
-	}
 
-	// check for match up to current index
-	for (uint8_t j = 0; j < pst.cur_level_i; j++) {
-		if (!level_str_matches(pst.cur_levels[j], cmd->levels[j])) {
-			return false;
-		}
-	}
+/** Match (or repeat) header complete. Returns false if the output could not be passed on yet. */
+static bool blob_decode_match(scpi_ctx_t *ctx)
+{
+	ctx->pst.dec_run = ctx->pst.dec_mlen;
+	ctx->pst.dec_state = DEC_TOKEN;
 
-	return true;
+	ctx->pst.dec_held = !blob_decode_run(ctx);
+	return !ctx->pst.dec_held;
 }
 
 
-/** Run the matched command's callback with the arguments */
-static void run_command_callback(void)
+/**
+ * Decompress blob body bytes and pass the data on. Returns number of bytes consumed.
+ *
+ * A header byte is consumed only after the match it completes was passed on,
+ * so nothing is left in the decoder when the input stops.
+ */
+static size_t blob_decode(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
 {
-	if (pst.matched_cmd != NULL) {
-		pst.matched_cmd->callback(pst.args); // run
-	}
-}
+	const SCPI_blob_codec_t codec = ctx->pst.matched_cmd->blob_codec;
+	size_t used = 0;
 
+	if (len == 0) return 0;
 
+	if (ctx->pst.dec_held) {
+		// first byte was processed already, its match is waiting
+		if (!blob_decode_run(ctx)) return 0;
 
-// ---------------------- PARSING ARGS --------------------------
+		ctx->pst.dec_held = false;
+		used = 1;
+	}
+
+	while (used < len && ctx->pst.state == PARS_ARG_BLOB_BODY) {
+		const uint8_t b = buf[used];
+
+		switch (ctx->pst.dec_state) {
+			case DEC_LITERAL: {
+				size_t n = len - used;
+				if (n > ctx->pst.dec_lit) n = ctx->pst.dec_lit;
+
+				const size_t done = blob_deliver_do(ctx, buf + used, n);
+				if (codec == SCPI_CODEC_LZ4) {
+					blob_win_push(ctx, buf + used, done);
+				}
+
+				ctx->pst.dec_lit -= done;
+				used += done;
+
+				if (ctx->pst.dec_lit == 0) {
+					ctx->pst.dec_state = (codec == SCPI_CODEC_LZ4) ? DEC_OFFSET_LO : DEC_TOKEN;
+				}
+
+				if (done < n) return used; // buffers full or discarded
+				continue;
+			}
+
+			case DEC_TOKEN:
+				if (codec == SCPI_CODEC_RLE) {
+					// PackBits: 0..127 = n+1 literals, -1..-127 = repeat next byte 1-n times, -128 = nop
+					if (b < 128) {
+						ctx->pst.dec_lit = b + 1;
+						ctx->pst.dec_state = DEC_LITERAL;
+					} else if (b > 128) {
+						ctx->pst.dec_mlen = 257 - b;
+						ctx->pst.dec_state = DEC_RLE_BYTE;
+					}
+				} else {
+					// LZ4: literal length (high nibble), match length - 4 (low nibble)
+					ctx->pst.dec_lit = b >> 4;
+					ctx->pst.dec_mlen = (b & 0x0F) + 4;
+
+					if (ctx->pst.dec_lit == 15) {
+						ctx->pst.dec_state = DEC_LIT_LEN;
+					} else {
+						ctx->pst.dec_state = (ctx->pst.dec_lit > 0) ? DEC_LITERAL : DEC_OFFSET_LO;
+					}
+				}
+				break;
+
+			case DEC_LIT_LEN:
+				ctx->pst.dec_lit += b;
+				if (b != 255) ctx->pst.dec_state = DEC_LITERAL;
+				break;
+
+			case DEC_OFFSET_LO:
+				ctx->pst.dec_off = b;
+				ctx->pst.dec_state = DEC_OFFSET_HI;
+				break;
+
+			case DEC_OFFSET_HI:
+				ctx->pst.dec_off |= (uint16_t)(b << 8);
+
+				if (ctx->pst.dec_off == 0 || ctx->pst.dec_off > SCPI_BLOB_WINDOW || ctx->pst.dec_off > ctx->pst.win_pos) {
+					sprintf(ctx->pst.ebuf, "Compressed data offset %u out of range.", (unsigned) ctx->pst.dec_off);
+					blob_decode_error(ctx, ctx->pst.ebuf);
+					return used + 1;
+				}
+
+				if (ctx->pst.dec_mlen == 15 + 4) {
+					ctx->pst.dec_state = DEC_MATCH_LEN;
+					break;
+				}
+
+				if (!blob_decode_match(ctx)) return used;
+				break;
+
+			case DEC_MATCH_LEN:
+				ctx->pst.dec_mlen += b;
+				if (b == 255) break;
+
+				if (!blob_decode_match(ctx)) return used;
+				break;
+
+			case DEC_RLE_BYTE:
+				// first byte of the run, the rest is copied from it
+				ctx->pst.blob_win[ctx->pst.win_pos & BLOB_WIN_MASK] = b;
+				ctx->pst.win_pos++;
+				ctx->pst.dec_pend = 1;
+				ctx->pst.dec_mlen--;
+				ctx->pst.dec_off = 1;
+
+				if (!blob_decode_match(ctx)) return used;
+				break;
+		}
+
+		used++;
+	}
+
+	return used;
+}
+
+
+/** Check that the compressed data did not end in the middle of a sequence */
+static bool blob_decode_complete(scpi_ctx_t *ctx)
+{
+	switch (ctx->pst.matched_cmd->blob_codec) {
+		case SCPI_CODEC_RLE:
+			return ctx->pst.dec_state == DEC_TOKEN;
+
+		case SCPI_CODEC_LZ4:
+			// last sequence has only literals
+			return ctx->pst.dec_state == DEC_TOKEN || ctx->pst.dec_state == DEC_OFFSET_LO;
+
+		default:
+			return true;
+	}
+}
+
+#endif /* USE_BLOB_CODEC */
+
+
+/** Pass blob body bytes on (decompressed) and update the CRC. Returns number of bytes consumed. */
+static size_t blob_deliver(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+	size_t used;
+
+#ifdef USE_BLOB_CODEC
+	if (ctx->pst.matched_cmd->blob_codec != SCPI_CODEC_NONE) {
+		used = blob_decode(ctx, buf, len);
+	} else
+#endif
+	{
+		used = blob_deliver_do(ctx, buf, len);
+	}
+
+	if (ctx->pst.matched_cmd->blob_crc != SCPI_CRC_NONE) {
+		ctx->pst.blob_crc = scpi_crc32c(ctx->pst.blob_crc, buf, used); // CRC of the data as received
+	}
+
+	ctx->pst.blob_cnt += used;
+	return used;
+}
+
+
+/** Pass the last incomplete chunk (or buffer) of a blob */
+static void blob_deliver_rest(scpi_ctx_t *ctx)
+{
+	if (ctx->pst.sink_len != 0) {
+		if (ctx->pst.sink_fill > 0) {
+			blob_sink_flush(ctx);
+		}
+	} else if (ctx->pst.charbuf_i > 0) {
+		if (ctx->pst.matched_cmd->blob_data_callback != NULL) {
+			const uint16_t cnt = ctx->pst.charbuf_i;
+			ctx->pst.charbuf_i = 0;
+			ctx->pst.matched_cmd->blob_data_callback(ctx, (uint8_t *)ctx->pst.charbuf, cnt, ctx->pst.data_cnt - cnt);
+		} else {
+			blob_chunk_flush(ctx);
+		}
+	}
+}
+
+
+/** All blob data received */
+static void blob_end(scpi_ctx_t *ctx)
+{
+	ctx->pst.state = PARS_TRAILING_WHITE_NOCB; // discard trailing whitespace until newline
+
+	if (!scpi_blob_crc_ok(ctx)) {
+		scpi_add_error(ctx, E_EXE_DATA_CORRUPT_OR_STALE, "Block data CRC mismatch.");
+	}
+
+#ifdef USE_BLOB_CODEC
+	if (!blob_decode_complete(ctx)) {
+		scpi_add_error(ctx, E_CMD_INVALID_BLOCK_DATA, "Compressed block data truncated.");
+	}
+#endif
+
+	if (ctx->pst.matched_cmd->blob_end_callback != NULL) {
+		ctx->pst.matched_cmd->blob_end_callback(ctx, ctx->pst.data_cnt);
+	}
+}
+
+
+/** Receive indefinite length blob (#0) body bytes - newline is held back, it may be the end. */
+static size_t pars_blob_body_indefinite(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+	static const uint8_t nl = '\n';
+
+	if (ctx->pst.blob_nl_pending) {
+		// not followed by END, so it was data
+		if (blob_deliver(ctx, &nl, 1) == 0) return 0;
+
+		ctx->pst.blob_nl_pending = false;
+		if (ctx->pst.state != PARS_ARG_BLOB_BODY) return 0;
+	}
+
+	const uint8_t *nl_pos = memchr(buf, '\n', len);
+	const size_t n = (nl_pos != NULL) ? (size_t)(nl_pos - buf) : len;
+
+	size_t used = blob_deliver(ctx, buf, n);
+
+	if (used == n && nl_pos != NULL && ctx->pst.state == PARS_ARG_BLOB_BODY) {
+		ctx->pst.blob_nl_pending = true;
+		used++;
+	}
+
+	return used;
+}
+
+
+/** Receive blob body bytes. Returns number of bytes consumed. */
+static size_t pars_blob_body(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+	if (ctx->pst.blob_indefinite) {
+		return pars_blob_body_indefinite(ctx, buf, len);
+	}
+
+	if (len > ctx->pst.blob_len - ctx->pst.blob_cnt) {
+		len = ctx->pst.blob_len - ctx->pst.blob_cnt; // rest is not part of the blob
+	}
+
+	const size_t used = blob_deliver(ctx, buf, len);
+
+	if (ctx->pst.state == PARS_ARG_BLOB_BODY && ctx->pst.blob_cnt == ctx->pst.blob_len) {
+		blob_deliver_rest(ctx);
+
+		if (ctx->pst.state == PARS_ARG_BLOB_BODY) {
+			blob_end(ctx);
+		}
+	}
+
+	return used;
+}
+
+
+/** Skip discarded blob bytes. Returns number of bytes consumed. */
+static size_t pars_blob_discard(scpi_ctx_t *ctx, size_t len)
+{
+	if (ctx->pst.blob_indefinite) {
+		return len; // until END
+	}
+
+	if (len > ctx->pst.blob_len - ctx->pst.blob_cnt) {
+		len = ctx->pst.blob_len - ctx->pst.blob_cnt;
+	}
+
+	ctx->pst.blob_cnt += len;
+
+	if (ctx->pst.blob_cnt == ctx->pst.blob_len) {
+		ctx->pst.state = PARS_DISCARD_LINE;
+	}
+
+	return len;
+}
+
+
+
+// ------------------- RESET INTERNAL STATE ------------------
+
+
+/** Zero-copy chunks split between input buffers are collected in charbuf, larger need blob buffers */
+static bool blob_chunk_ok(const SCPI_command_t *cmd)
+{
+	return cmd->blob_data_callback == NULL || cmd->blob_chunk <= MAX_CHARBUF_LEN || cmd->blob_buf_len != 0;
+}
+
+
+// public //
+bool scpi_init(void)
+{
+	bool ok = true;
+
+	for (const SCPI_command_t *cmd = scpi_commands; cmd->levels[0][0] != 0; cmd++) {
+		if (!blob_chunk_ok(cmd)) ok = false;
+	}
+
+	cmd_index_init();
+	return scpi_cmd_index_ok() && ok;
+}
+
+
+// public //
+void scpi_ctx_init(scpi_ctx_t *ctx, void *user)
+{
+	memset(ctx, 0, sizeof(scpi_ctx_t));
+	ctx->user = user;
+
+	scpi_regs_init(&ctx->regs);
+}
+
+
+/** Discard the rest of the currently processed blob */
+void scpi_discard_blob(scpi_ctx_t *ctx)
+{
+	if (ctx->pst.state == PARS_ARG_BLOB_BODY) {
+		ctx->pst.state = PARS_ARG_BLOB_DISCARD;
+	}
+}
+
+
+void scpi_blob_set_buffers(scpi_ctx_t *ctx, uint8_t *buf0, uint8_t *buf1, uint32_t len,
+						   void (*callback)(scpi_ctx_t *ctx, uint8_t *buf, uint32_t len, uint32_t offset))
+{
+	if (buf0 != ctx->pst.sink_buf[0] || buf1 != ctx->pst.sink_buf[1]) {
+		// different buffers, none in use
+		ctx->pst.sink_busy[0] = false;
+		ctx->pst.sink_busy[1] = false;
+	}
+
+	ctx->pst.sink_buf[0] = buf0;
+	ctx->pst.sink_buf[1] = buf1;
+	ctx->pst.sink_len = (buf0 != NULL && buf1 != NULL && callback != NULL) ? len : 0;
+	ctx->pst.sink_cb = callback;
+	ctx->pst.sink_fill = 0;
+}
+
+
+void scpi_blob_release_buffer(scpi_ctx_t *ctx, const uint8_t *buf)
+{
+	for (uint8_t i = 0; i < 2; i++) {
+		if (ctx->pst.sink_buf[i] == buf) {
+			ctx->pst.sink_busy[i] = false;
+		}
+	}
+}
+
+
+SCPI_unit_t scpi_arg_unit(scpi_ctx_t *ctx, uint8_t index)
+{
+	if (index >= SCPI_MAX_PARAM_COUNT) return SCPI_UNIT_NONE;
+	arg_lazy_convert(ctx, index); // the suffix is parsed with the number
+
+	return (SCPI_unit_t) ctx->pst.arg_units[index];
+}
+
+
+/** Argument of the current command, NULL if the param is not of the type */
+static const SCPI_argval_t *arg_typed(scpi_ctx_t *ctx, uint8_t index, SCPI_datatype_t type)
+{
+	if (ctx->pst.matched_cmd == NULL || index >= SCPI_MAX_PARAM_COUNT) return NULL;
+	if (ctx->pst.matched_cmd->params[index] != type) return NULL;
+
+	arg_lazy_convert(ctx, index);
+	return &ctx->pst.args[index];
+}
+
+
+int32_t scpi_arg_int(scpi_ctx_t *ctx, uint8_t index)
+{
+	const SCPI_argval_t *a = arg_typed(ctx, index, SCPI_DT_INT);
+	return a ? a->INT : 0;
+}
+
+
+int64_t scpi_arg_int64(scpi_ctx_t *ctx, uint8_t index)
+{
+	const SCPI_argval_t *a = arg_typed(ctx, index, SCPI_DT_INT64);
+	if (a) return a->INT64;
+
+	return scpi_arg_int(ctx, index);
+}
+
+
+float scpi_arg_float(scpi_ctx_t *ctx, uint8_t index)
+{
+	const SCPI_argval_t *a = arg_typed(ctx, index, SCPI_DT_FLOAT);
+	return a ? a->FLOAT : 0;
+}
+
+
+double scpi_arg_double(scpi_ctx_t *ctx, uint8_t index)
+{
+	const SCPI_argval_t *a = arg_typed(ctx, index, SCPI_DT_DOUBLE);
+	if (a) return a->DOUBLE;
+
+	return scpi_arg_float(ctx, index);
+}
+
+
+int32_t scpi_arg_fixed(scpi_ctx_t *ctx, uint8_t index)
+{
+	const SCPI_argval_t *a = arg_typed(ctx, index, SCPI_DT_FIXED);
+	return a ? a->FIXED : 0;
+}
+
+
+bool scpi_arg_bool(scpi_ctx_t *ctx, uint8_t index)
+{
+	const SCPI_argval_t *a = arg_typed(ctx, index, SCPI_DT_BOOL);
+	return a ? a->BOOL : false;
+}
+
+
+int8_t scpi_arg_enum(scpi_ctx_t *ctx, uint8_t index)
+{
+	const SCPI_argval_t *a = arg_typed(ctx, index, SCPI_DT_ENUM);
+	return a ? (int8_t) a->ENUM : -1;
+}
+
+
+const char *scpi_arg_string(scpi_ctx_t *ctx, uint8_t index)
+{
+	const SCPI_argval_t *a = arg_typed(ctx, index, SCPI_DT_STRING);
+	if (a) return a->STRING;
+
+	a = arg_typed(ctx, index, SCPI_DT_CHARDATA);
+	return a ? a->CHARDATA : "";
+}
+
+
+uint32_t scpi_arg_len(scpi_ctx_t *ctx, uint8_t index)
+{
+	if (ctx->pst.matched_cmd == NULL || index >= SCPI_MAX_PARAM_COUNT) return 0;
+
+	const SCPI_argval_t *a = &ctx->pst.args[index];
+
+	switch (ctx->pst.matched_cmd->params[index]) {
+		case SCPI_DT_STRING:
+		case SCPI_DT_CHARDATA:
+			return strlen(scpi_arg_string(ctx, index));
+
+		case SCPI_DT_STRING_STREAM: return a->STRING_LEN;
+		case SCPI_DT_BLOB: return a->BLOB_LEN;
+		case SCPI_DT_LIST: return a->LIST_LEN;
+		default: return 0;
+	}
+}
+
+
+uint16_t scpi_arg_chanlist(scpi_ctx_t *ctx, uint8_t index, const SCPI_chanrange_t **ranges)
+{
+	const SCPI_argval_t *a = arg_typed(ctx, index, SCPI_DT_CHANLIST);
+
+	if (ranges != NULL) *ranges = a ? a->CHANLIST.ranges : NULL;
+	return a ? a->CHANLIST.count : 0;
+}
+
+
+const char *scpi_arg_raw(scpi_ctx_t *ctx, uint8_t index)
+{
+	// only the args received so far have their text
+	if (ctx->pst.matched_cmd == NULL || index >= ctx->pst.arg_i) return "";
+
+	const char *raw = ctx->pst.arg_raw[index];
+	return raw ? raw : "";
+}
+
+
+bool scpi_arg_ok(scpi_ctx_t *ctx, uint8_t index)
+{
+	if (ctx->pst.matched_cmd == NULL || index >= SCPI_MAX_PARAM_COUNT) return false;
+	if (ctx->pst.matched_cmd->params[index] == SCPI_DT_NONE) return false;
+
+	arg_lazy_convert(ctx, index);
+	return !(ctx->pst.arg_bad & (1UL << index));
+}
+
+
+uint32_t scpi_blob_crc(scpi_ctx_t *ctx)
+{
+	return ctx->pst.blob_crc;
+}
+
+
+bool scpi_blob_crc_ok(scpi_ctx_t *ctx)
+{
+	if (ctx->pst.matched_cmd == NULL || ctx->pst.matched_cmd->blob_crc != SCPI_CRC_CHECK) {
+		return true;
+	}
+
+	return ctx->pst.blob_crc == ctx->pst.blob_crc_expected;
+}
+
+
+/** Reset parser state. */
+static void pars_reset_cmd(scpi_ctx_t *ctx)
+{
+	ctx->pst.state = PARS_COMMAND;
+	ctx->pst.charbuf_i = 0;
+	ctx->pst.cur_level_i = 0;
+	ctx->pst.cmdbuf_kept = false;
+	ctx->pst.matched_cmd = NULL;
+	ctx->pst.cmd_node = 0; // automaton root
+	ctx->pst.arg_i = 0;
+	ctx->pst.list_cnt = 0;
+	ctx->pst.list_fill = 0;
+	ctx->pst.chan_state = CHAN_NONE;
+	ctx->pst.string_escape = false;
+	ctx->pst.string_open = false;
+	ctx->pst.arena_used = 0;
+	ctx->pst.arg_lazy = 0;
+	ctx->pst.arg_bad = 0;
+
+	// end of a message, pass on the responses
+	scpi_send_flush(ctx);
+}
+
+
+/** Reset parser state, keep level (semicolon) */
+static void pars_reset_cmd_keeplevel(scpi_ctx_t *ctx)
+{
+	ctx->pst.state = PARS_COMMAND;
+	ctx->pst.charbuf_i = 0;
+
+	// rewind to last colon
+	if (ctx->pst.cur_level_i > 0) {
+		ctx->pst.cur_level_i--; // keep prev levels
+	}
+
+	ctx->pst.cmdbuf_kept = true;
+	ctx->pst.matched_cmd = NULL;
+	ctx->pst.cmd_node = ctx->pst.level_node[ctx->pst.cur_level_i]; // back to the start of the kept level
+	ctx->pst.arg_i = 0;
+	ctx->pst.list_cnt = 0;
+	ctx->pst.list_fill = 0;
+	ctx->pst.chan_state = CHAN_NONE;
+	ctx->pst.string_escape = false;
+	ctx->pst.string_open = false;
+	ctx->pst.arena_used = 0;
+	ctx->pst.arg_lazy = 0;
+	ctx->pst.arg_bad = 0;
+}
+
+
+// ------------------- COMMAND HELPERS -------------------
+
+/** Get param count from command struct */
+static uint8_t cmd_param_count(const SCPI_command_t *cmd)
+{
+	for (uint8_t i = 0; i < SCPI_MAX_PARAM_COUNT; i++) {
+		if (cmd->params[i] == SCPI_DT_NONE) {
+			return i;
+		}
+	}
+
+	return SCPI_MAX_PARAM_COUNT;
+}
+
+
+/** Get level count from command struct */
+static uint8_t cmd_level_count(const SCPI_command_t *cmd)
+{
+	for (uint8_t i = 0; i < SCPI_MAX_LEVEL_COUNT; i++) {
+		if (cmd->levels[i][0] == 0) {
+			return i;
+		}
+	}
+
+	return SCPI_MAX_LEVEL_COUNT;
+}
+
+
+/** Get the param details of a command (all empty if it has none) */
+static const SCPI_param_ext_t *cmd_ext(const SCPI_command_t *cmd)
+{
+	static const SCPI_param_ext_t none;
+
+	return (cmd->ext != NULL) ? cmd->ext : &none;
+}
+
+
+
+// ----------------- CHAR BUFFER HELPERS -------------------
+
+/** Add a byte to charbuf, error on overflow */
+static void charbuf_append(scpi_ctx_t *ctx, char c)
+{
+	if (ctx->pst.charbuf_i >= MAX_CHARBUF_LEN) {
+		scpi_add_error(ctx, E_DEV_INPUT_BUFFER_OVERRUN, NULL);
+		ctx->pst.state = PARS_DISCARD_LINE;
+	}
+
+	ctx->pst.charbuf[ctx->pst.charbuf_i++] = c;
+}
+
+
+/** Terminate charbuf and rewind the pointer to start */
+static void charbuf_terminate(scpi_ctx_t *ctx)
+{
+	ctx->pst.charbuf[ctx->pst.charbuf_i] = '\0';
+	ctx->pst.charbuf_i = 0;
+}
+
+
+/** Allocate space for an argument in the arena (4-byte aligned), NULL if it's full */
+static void *arena_alloc(scpi_ctx_t *ctx, size_t size)
+{
+	const size_t at = (ctx->pst.arena_used + 3u) & ~3u;
+	if (at + size > SCPI_ARG_ARENA_LEN) return NULL;
+
+	ctx->pst.arena_used = (uint16_t)(at + size);
+	return &ctx->pst.arena[at];
+}
+
+
+/** Copy argument text to the arena. If it's full, raise an error and return "" */
+static const char *arena_strdup(scpi_ctx_t *ctx, const char *str)
+{
+	const size_t len = strlen(str) + 1;
+	char *dest = arena_alloc(ctx, len);
+
+	if (dest == NULL) {
+		scpi_add_error(ctx, E_EXE_OUT_OF_MEMORY, "Argument arena full.");
+		ctx->pst.state = PARS_DISCARD_LINE;
+		return "";
+	}
+
+	return memcpy(dest, str, len);
+}
+
+
+
+// ----------------- PARSING COMMANDS ---------------
+
+/** Colon received when collecting command parts */
+static void pars_cmd_colon(scpi_ctx_t *ctx)
+{
+	if (ctx->pst.charbuf_i == 0) {
+		// No command text before colon
+
+		if (ctx->pst.cur_level_i == 0 || ctx->pst.cmdbuf_kept) {
+			// top level command starts with colon (or after semicolon - reset level)
+			pars_reset_cmd(ctx); // clears keep flag
+		} else {
+			// colon after nothing - error
+			scpi_add_error(ctx, E_CMD_SYNTAX_ERROR, "Unexpected colon.");
+
+			ctx->pst.state = PARS_DISCARD_LINE;
+		}
+
+	} else {
+		// internal colon - partial match
+		if (match_cmd(ctx, true)) {
+			// ok
+			ctx->pst.cmdbuf_kept = false; // drop the flag (needed for rejecting whitespace)
+		} else {
+			// error
+			err_no_such_command_partial(ctx);
+
+			ctx->pst.state = PARS_DISCARD_LINE;
+		}
+	}
+}
+
+
+/** Semiolon received when collecting command parts */
+static void pars_cmd_semicolon(scpi_ctx_t *ctx)
+{
+	if (ctx->pst.cur_level_i == 0 && ctx->pst.charbuf_i == 0) {
+		// nothing before semicolon
+		scpi_add_error(ctx, E_CMD_SYNTAX_ERROR, "Semicolon not preceded by command.");
+		pars_reset_cmd(ctx);
+		return;
+	}
+
+	if (match_cmd(ctx, false)) {
+		int req_cnt = cmd_param_count(ctx->pst.matched_cmd);
+
+		if (req_cnt == 0) {
+			// no param command - OK
+			run_command_callback(ctx);
+			pars_reset_cmd_keeplevel(ctx); // keep level - that's what semicolon does
+		} else {
+			sprintf(ctx->pst.ebuf, "Required %d, got 0.", req_cnt);
+			scpi_add_error(ctx, E_CMD_MISSING_PARAMETER, ctx->pst.ebuf);
+			pars_reset_cmd(ctx);
+		}
+	} else {
+		err_no_such_command(ctx);
+		ctx->pst.state = PARS_DISCARD_LINE;
+	}
+}
+
+
+/** Newline received when collecting command - end command and execute. */
+static void pars_cmd_newline(scpi_ctx_t *ctx)
+{
+	if (ctx->pst.charbuf_i == 0 && (ctx->pst.cur_level_i == 0 || ctx->pst.cmdbuf_kept)) {
+		// nothing before newline (or only a semicolon)
+		pars_reset_cmd(ctx);
+		return;
+	}
+
+	// complete match
+	if (match_cmd(ctx, false)) {
+		int req_cnt = cmd_param_count(ctx->pst.matched_cmd);
+
+		if (req_cnt == 0) {
+			// no param command - OK
+			run_command_callback(ctx);
+			pars_reset_cmd(ctx);
+		} else {
+			// error
+			sprintf(ctx->pst.ebuf, "Required %d, got 0.", req_cnt);
+			scpi_add_error(ctx, E_CMD_MISSING_PARAMETER, ctx->pst.ebuf);
+
+			pars_reset_cmd(ctx);
+		}
+
+	} else {
+		err_no_such_command(ctx);
+		pars_reset_cmd(ctx);
+	}
+}
+
+
+/** Whitespace received when collecting command parts */
+static void pars_cmd_space(scpi_ctx_t *ctx)
+{
+	if ((ctx->pst.cmdbuf_kept || ctx->pst.cur_level_i == 0) && ctx->pst.charbuf_i == 0) {
+		// leading whitespace, ignore
+		return;
+	}
+
+	if (match_cmd(ctx, false)) {
+		if (cmd_param_count(ctx->pst.matched_cmd) == 0 && cmd_ext(ctx->pst.matched_cmd)->limits[0] == NULL) {
+			// no commands (a query with limits takes MIN, MAX or DEF)
+			ctx->pst.state = PARS_TRAILING_WHITE;
+		} else {
+			ctx->pst.state = PARS_ARG;
+		}
+	} else {
+		// error
+		err_no_such_command(ctx);
+		ctx->pst.state = PARS_DISCARD_LINE;
+	}
+}
+
+
+// ----------------- COMMAND INDEX -------------------
+
+#ifdef USE_CMD_TRIE
+
+#define NODE_NONE 0xFFFF
+#define NODE_CMD_BUILTIN 0x8000 // command reference flags
+#define NODE_CMD_END 0x4000
+#define NODE_CMD_INDEX 0x3FFF
+#define NODE_HAS_CHILD 0x8000 // node parent flags
+#define NODE_ALIAS 0x4000
+#define NODE_PARENT 0x3FFF
+
+#if SCPI_CMD_TRIE_NODES > NODE_PARENT
+#error "SCPI_CMD_TRIE_NODES too large"
+#endif
+
+// Edge slots - at most 2 per node (short and long form), kept under 80 % full
+#define CMD_SLOTS (SCPI_CMD_TRIE_NODES * 5 / 2)
+
+#define CMD_HASH_INIT 0x811C9DC5
+#define CMD_HASH_PRIME 0x01000193
+
+/**
+ * Command header automaton node.
+ *
+ * One node for each distinct level of the command headers (SOUR:VOLT:LIM and SOUR:VOLT:OFFS
+ * share the SOUR and VOLT nodes). The level name is not copied, the node refers to a command
+ * that has it - the command ending at the node, if there is one (NODE_CMD_END).
+ */
+typedef struct {
+	uint16_t parent; // node of the previous level (root = 0), NODE_HAS_CHILD, NODE_ALIAS
+	uint16_t cmd; // 1-based index, NODE_CMD_BUILTIN for the built-in table, NODE_CMD_END if it ends here
+} cmd_node_t;
+
+/**
+ * Automaton edge - a node found by the hash of its parent and the short or long form of its name.
+ * The received text is hashed char by char, so the next node is found with one lookup at the delimiter.
+ * Open addressing, linear probing - forms added first are found first.
+ */
+typedef struct {
+	uint16_t node; // 0 = empty (root is never a child)
+	uint16_t check; // low half of the hash
+} cmd_slot_t;
+
+static cmd_node_t cmd_nodes[SCPI_CMD_TRIE_NODES];
+static cmd_slot_t cmd_slots[CMD_SLOTS];
+static uint16_t cmd_node_count; // 0 until built
+static bool cmd_index_full; // the commands did not fit
+
+
+/** Add a header char to a level text hash (case insensitive) */
+static uint32_t cmd_hash_char(uint32_t hash, char c)
+{
+	if (IS_LCASE_CHAR(c)) c = CHAR_TO_UPPER(c);
+
+	return (hash ^ (uint8_t) c) * CMD_HASH_PRIME;
+}
+
+
+/** Combine a level text hash with the parent node */
+static uint32_t cmd_hash_key(uint32_t hash, uint16_t parent)
+{
+	hash = (hash ^ parent) * CMD_HASH_PRIME;
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6B;
+	hash ^= hash >> 13;
+
+	return hash;
+}
+
+
+/** Get a command by its 1-based reference */
+static const SCPI_command_t *cmd_index_ref(uint16_t ref)
+{
+	if (ref & NODE_CMD_BUILTIN) {
+		return &scpi_commands_builtin[(ref & NODE_CMD_INDEX) - 1];
+	}
+
+	return &scpi_commands[(ref & NODE_CMD_INDEX) - 1];
+}
+
+
+/** Level name of a node at a given depth (0 = first level) */
+static const char *cmd_index_label(uint16_t node, uint8_t depth)
+{
+	return cmd_index_ref(cmd_nodes[node].cmd)->levels[depth];
+}
+
+
+/** Check if a received level is the long or the short form (uppercase chars) of a level name */
+static bool level_form_matches(const char *test, const char *pattern)
+{
+	const char *t = test;
+	const char *p = pattern;
+
+	while (*p != 0 && char_equals_ci(*p, *t)) {
+		p++;
+		t++;
+	}
+
+	if (*p == 0 && *t == 0) return true;
+
+	t = test;
+	for (p = pattern; *p != 0; p++) {
+		if (IS_LCASE_CHAR(*p)) continue;
+		if (!char_equals_ci(*p, *t)) return false;
+		t++;
+	}
+
+	return *t == 0;
+}
+
+
+/**
+ * Find the node of a level after a node, by the hash of the level text.
+ * With 'name', the node must have exactly this level name, otherwise 'level' must be its short or long form.
+ * Returns NODE_NONE if there's none.
+ */
+static uint16_t cmd_index_find(uint16_t parent, uint8_t depth, const char *level, uint32_t hash, const char *name)
+{
+	const uint32_t key = cmd_hash_key(hash, parent);
+	const uint16_t check = (uint16_t) key;
+
+	uint16_t i = (uint16_t)(((key >> 16) * CMD_SLOTS) >> 16);
+
+	for (; cmd_slots[i].node != 0; i = (i + 1 < CMD_SLOTS) ? i + 1 : 0) {
+		const uint16_t n = cmd_slots[i].node;
+
+		if (cmd_slots[i].check != check || (cmd_nodes[n].parent & NODE_PARENT) != parent) continue;
+
+		const char *label = cmd_index_label(n, depth);
+		if (name ? (strcmp(label, name) == 0) : level_form_matches(level, label)) return n;
+	}
+
+	return NODE_NONE;
+}
+
+
+/** Add an edge to a node */
+static void cmd_index_edge(uint16_t node, const char *form)
+{
+	uint32_t hash = CMD_HASH_INIT;
+	for (const char *c = form; *c != 0; c++) {
+		hash = cmd_hash_char(hash, *c);
+	}
+
+	const uint32_t key = cmd_hash_key(hash, cmd_nodes[node].parent & NODE_PARENT);
+
+	uint16_t i = (uint16_t)(((key >> 16) * CMD_SLOTS) >> 16);
+	while (cmd_slots[i].node != 0) {
+		i = (i + 1 < CMD_SLOTS) ? i + 1 : 0; // never full, see CMD_SLOTS
+	}
+
+	cmd_slots[i].node = node;
+	cmd_slots[i].check = (uint16_t) key;
+}
+
+
+/** Get or create the node of a command's level after a node. */
+static uint16_t cmd_index_child(uint16_t node, uint16_t cmd_ref, uint8_t depth)
+{
+	const char *name = cmd_index_ref(cmd_ref)->levels[depth];
+	char form[2][SCPI_MAX_CMD_LEN + 1]; // long, short
+	uint8_t len[2] = {0, 0};
+
+	for (const char *c = name; *c != 0 && len[0] < SCPI_MAX_CMD_LEN; c++) {
+		if (IS_LCASE_CHAR(*c)) {
+			form[0][len[0]++] = CHAR_TO_UPPER(*c);
+		} else {
+			form[0][len[0]++] = form[1][len[1]++] = *c;
+		}
+	}
+	form[0][len[0]] = form[1][len[1]] = 0;
+
+	uint32_t hash[2];
+	for (uint8_t f = 0; f < 2; f++) {
+		hash[f] = CMD_HASH_INIT;
+		for (uint8_t j = 0; j < len[f]; j++) {
+			hash[f] = cmd_hash_char(hash[f], form[f][j]);
+		}
+	}
+
+	// added for an earlier command
+	uint16_t i = cmd_index_find(node, depth, form[0], hash[0], name);
+	if (i != NODE_NONE) return i;
+
+	if (cmd_node_count >= SCPI_CMD_TRIE_NODES) {
+		cmd_index_full = true;
+		return NODE_NONE;
+	}
+
+	i = cmd_node_count++;
+	cmd_nodes[i].parent = node;
+	cmd_nodes[i].cmd = cmd_ref; // level name
+	cmd_nodes[node].parent |= NODE_HAS_CHILD;
+
+	// another level name accepting the same text (SYST and SYSTem) - headers through
+	// these nodes are left to the linear scan, which knows the table order
+	for (uint8_t f = 0; f < 2; f++) {
+		const uint16_t other = cmd_index_find(node, depth, form[f], hash[f], NULL);
+
+		if (other != NODE_NONE) {
+			cmd_nodes[other].parent |= NODE_ALIAS;
+			cmd_nodes[i].parent |= NODE_ALIAS;
+		}
+	}
+
+	cmd_index_edge(i, form[0]);
+	if (len[1] > 0 && len[1] != len[0]) {
+		cmd_index_edge(i, form[1]);
+	}
+
+	return i;
+}
+
+
+/** Add all commands from a command array */
+static void cmd_index_add_array(const SCPI_command_t arr[], uint16_t flag)
+{
+	for (uint16_t i = 0; i < NODE_CMD_INDEX; i++) {
+		const SCPI_command_t *cmd = &arr[i];
+		if (cmd->levels[0][0] == 0) break; // end marker
+
+		const uint16_t ref = (i + 1) | flag;
+		const uint8_t level_cnt = cmd_level_count(cmd);
+		uint16_t n = 0;
+
+		for (uint8_t level = 0; level < level_cnt; level++) {
+			n = cmd_index_child(n, ref, level);
+			if (n == NODE_NONE) return; // out of nodes
+		}
+
+		// first match wins - user commands are added first and override built-ins
+		if (!(cmd_nodes[n].cmd & NODE_CMD_END)) {
+			cmd_nodes[n].cmd = ref | NODE_CMD_END; // has the same level names
+		}
+	}
+}
+
+
+/** Build the automaton - once at startup, before the parser is used (not thread safe) */
+static void cmd_index_init(void)
+{
+	memset(cmd_slots, 0, sizeof(cmd_slots));
+	cmd_node_count = 1; // root
+	cmd_nodes[0].parent = 0;
+	cmd_nodes[0].cmd = 0;
+	cmd_index_full = false;
+
+	cmd_index_add_array(scpi_commands, 0);
+	if (!cmd_index_full) {
+		cmd_index_add_array(scpi_commands_builtin, NODE_CMD_BUILTIN);
+	}
+}
+
+
+/** Add a received header char to the hash of the current level */
+static void cmd_index_feed(scpi_ctx_t *ctx, char c)
+{
+	if (ctx->pst.charbuf_i == 0) {
+		ctx->pst.cmd_hash = CMD_HASH_INIT; // first char of a level
+	}
+
+	ctx->pst.cmd_hash = cmd_hash_char(ctx->pst.cmd_hash, c);
+}
+
+
+/**
+ * Find the command or the header level in the automaton.
+ * @returns true if found, false if not; NODE_NONE in cmd_node if the linear scan must decide.
+ */
+static bool cmd_index_match(scpi_ctx_t *ctx, const char *level, bool partial)
+{
+	if (cmd_node_count == 0 || cmd_index_full) {
+		scpi_add_error(ctx, E_DEV_SYSTEM_ERROR, cmd_index_full ?
+					   "Command tables larger than SCPI_CMD_TRIE_NODES." : "scpi_init() not called.");
+		return false;
+	}
+
+	// the level text was hashed as it was received
+	const uint16_t n = cmd_index_find(ctx->pst.cmd_node, ctx->pst.cur_level_i - 1, level, ctx->pst.cmd_hash, NULL);
+	if (n == NODE_NONE) return false;
+
+	if (cmd_nodes[n].parent & NODE_ALIAS) {
+		ctx->pst.cmd_node = NODE_NONE;
+		return false;
+	}
+
+	ctx->pst.cmd_node = n;
+
+	if (partial) {
+		ctx->pst.level_node[ctx->pst.cur_level_i] = n;
+		return (cmd_nodes[n].parent & NODE_HAS_CHILD) != 0; // a level with more levels after it
+	}
+
+	if (!(cmd_nodes[n].cmd & NODE_CMD_END)) return false;
+
+	ctx->pst.matched_cmd = cmd_index_ref(cmd_nodes[n].cmd);
+	return true;
+}
+
+
+bool scpi_cmd_index_ok(void)
+{
+	return cmd_node_count > 0 && !cmd_index_full;
+}
+
+
+uint16_t scpi_cmd_index_nodes(void)
+{
+	return cmd_node_count;
+}
+
+#else
+
+static void cmd_index_init(void)
+{
+}
+
+
+static void cmd_index_feed(scpi_ctx_t *ctx, char c)
+{
+	(void)ctx;
+	(void)c;
+}
+
+
+bool scpi_cmd_index_ok(void)
+{
+	return true;
+}
+
+
+uint16_t scpi_cmd_index_nodes(void)
+{
+	return 0;
+}
+
+#endif
+
+
+#ifdef SCPI_CMD_INDEX
+
+/** Header path hash (FNV-1a with a final mix). Must match hash_path() in cmdgen.py */
+static uint32_t cmd_path_hash(const char *path, uint32_t seed)
+{
+	uint32_t h = 0x811C9DC5 ^ seed;
+
+	while (*path != 0) {
+		h ^= (uint8_t) * path++;
+		h *= 0x01000193;
+	}
+
+	h ^= h >> 16;
+	h *= 0x85EBCA6B;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35;
+	h ^= h >> 16;
+
+	return h;
+}
+
+
+/** Find the collected levels in the generated index */
+static const SCPI_cmd_index_entry_t *cmd_index_lookup(scpi_ctx_t *ctx)
+{
+	char path[SCPI_MAX_LEVEL_COUNT * (SCPI_MAX_CMD_LEN + 1)];
+	char *p = path;
+
+	// normalize - uppercase, levels joined by colons
+	for (uint8_t i = 0; i < ctx->pst.cur_level_i; i++) {
+		if (i > 0) *p++ = ':';
+
+		for (const char *c = ctx->pst.cur_levels[i]; *c != 0; c++) {
+			*p++ = IS_LCASE_CHAR(*c) ? CHAR_TO_UPPER(*c) : *c;
+		}
+	}
+	*p = 0;
+
+	const uint16_t seed = scpi_cmd_index.disp[cmd_path_hash(path, 0) % scpi_cmd_index.buckets];
+	const SCPI_cmd_index_entry_t *entry = &scpi_cmd_index.entries[cmd_path_hash(path, seed) % scpi_cmd_index.size];
+
+	if (strcmp(entry->path, path) != 0) {
+		return NULL; // not a known header
+	}
+
+	return entry;
+}
+
+#endif
+
+
+/** Check if chars equal, ignore case */
+static bool char_equals_ci(char a, char b)
+{
+	if (IS_LCASE_CHAR(a)) {
+
+		if (IS_LCASE_CHAR(b)) {
+			return a == b;
+		} else if (IS_UCASE_CHAR(b)) {
+			return a == CHAR_TO_LOWER(b);
+		} else {
+			return false;
+		}
+
+	} else if (IS_UCASE_CHAR(a)) {
+
+		if (IS_UCASE_CHAR(b)) {
+			return a == b;
+		} else if (IS_LCASE_CHAR(b)) {
+			return a == CHAR_TO_UPPER(b);
+		} else {
+			return false;
+		}
+
+	} else {
+		return a == b; // exact match, not letters
+	}
+}
+
+
+/** Check if command matches a pattern */
+static bool level_str_matches(const char *test, const char *pattern)
+{
+	const uint8_t testlen = strlen(test);
+	const uint8_t patlen = strlen(pattern);
+	uint8_t pat_i, tst_i;
+	bool long_started = false;
+	for (pat_i = 0, tst_i = 0; pat_i < patlen; pat_i++) {
+		if (tst_i > testlen) return false; // not match
+
+		const char pat_c = pattern[pat_i];
+		const char tst_c = test[tst_i]; // may be at the \0 terminator
+
+		if (IS_LCASE_CHAR(pat_c)) {
+			// optional char
+			if (char_equals_ci(pat_c, tst_c)) {
+				tst_i++; // advance test string
+				long_started = true;
+			} else {
+				if (long_started) return false; // once long variant started, it must be completed.
+			}
+
+			continue; // next pi - tc stays in place
+		} else {
+			// require exact match (case insensitive)
+			if (char_equals_ci(pat_c, tst_c)) {
+				tst_i++;
+			} else {
+				return false;
+			}
+		}
+	}
+
+	return (tst_i >= testlen);
+}
+
+
+/**
+ * Match content of the charbuf to a command.
+ * @param partial - match also parts of a command (until a colon)
+ */
+static bool match_cmd(scpi_ctx_t *ctx, bool partial)
+{
+	charbuf_terminate(ctx); // zero-end and rewind index
+
+	// copy to level table
+	char *dest = ctx->pst.cur_levels[ctx->pst.cur_level_i++];
+	strcpy(dest, ctx->pst.charbuf);
+
+#if defined(SCPI_CMD_INDEX)
+	const SCPI_cmd_index_entry_t *entry = cmd_index_lookup(ctx);
+
+	if (partial) {
+		return entry != NULL && entry->partial;
+	}
+
+	ctx->pst.matched_cmd = (entry != NULL) ? entry->cmd : NULL;
+	return ctx->pst.matched_cmd != NULL;
+#elif defined(USE_CMD_TRIE)
+	if (ctx->pst.cmd_node != NODE_NONE) {
+		if (cmd_index_match(ctx, dest, partial)) return true;
+		if (ctx->pst.cmd_node != NODE_NONE) return false; // not a known header
+	}
+
+	if (partial) {
+		ctx->pst.level_node[ctx->pst.cur_level_i] = NODE_NONE; // the rest of the header by the linear scan
+	}
+#endif
+
+
+	// User commands are checked first, can override builtin commands
+	if (match_any_cmd_from_array(ctx, scpi_commands, partial)) {
+		return true;
+	}
+
+	// Try the built-in commands
+	return match_any_cmd_from_array(ctx, scpi_commands_builtin, partial);
+}
+
+
+static bool match_any_cmd_from_array(scpi_ctx_t *ctx, const SCPI_command_t arr[], bool partial)
+{
+	for (uint16_t i = 0; i < 0xFFFF; i++) {
+
+		const SCPI_command_t *cmd = &arr[i];
+		if (cmd->levels[0][0] == 0) break; // end marker
+
+		if (cmd_level_count(cmd) > SCPI_MAX_LEVEL_COUNT) {
+			// FAIL, too deep. Bad config
+			continue;
+		}
+
+		if (match_cmd_do(ctx, cmd, partial)) {
+			if (partial) {
+				// match found, OK
+				return true;
+			} else {
+				// exact match found
+				ctx->pst.matched_cmd = cmd;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+/** Try to match current state to a given command */
+static bool match_cmd_do(scpi_ctx_t *ctx, const SCPI_command_t *cmd, bool partial)
+{
+	const uint8_t level_cnt = cmd_level_count(cmd);
+	if (ctx->pst.cur_level_i > level_cnt) return false; // command too short
+	if (ctx->pst.cur_level_i == 0) return false; // nothing to match
+
+	if (partial) {
+		if (ctx->pst.cur_level_i == level_cnt) {
+			return false; // would be exact match
+		}
+	} else {
+		if (ctx->pst.cur_level_i != level_cnt) {
+			return false; // can be only partial match
+		}
+	}
+
+	// check for match up to current index
+	for (uint8_t j = 0; j < ctx->pst.cur_level_i; j++) {
+		if (!level_str_matches(ctx->pst.cur_levels[j], cmd->levels[j])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/** Run the matched command's callback with the arguments */
+static void run_command_callback(scpi_ctx_t *ctx)
+{
+	if (ctx->pst.matched_cmd != NULL) {
+		ctx->pst.matched_cmd->callback(ctx, ctx->pst.args); // run
+	}
+}
+
+
+
+// ---------------------- PARSING ARGS --------------------------
+
+/** Non-whitespace and non-comma char received in arg. */
+static void pars_arg_char(scpi_ctx_t *ctx, char c)
+{
+	SCPI_datatype_t type = ctx->pst.matched_cmd->params[ctx->pst.arg_i];
+	if (type == SCPI_DT_LIST) type = cmd_ext(ctx->pst.matched_cmd)->list_type; // element of a list
+
+	switch (type) {
+		case SCPI_DT_FLOAT:
+		case SCPI_DT_DOUBLE:
+		case SCPI_DT_FIXED:
+			if (!IS_FLOAT_CHAR(c)) {
+				sprintf(ctx->pst.ebuf, "'%c' not allowed in FLOAT.", c);
+				scpi_add_error(ctx, E_CMD_INVALID_CHARACTER_IN_NUMBER, ctx->pst.ebuf);
+
+				ctx->pst.state = PARS_DISCARD_LINE;
+			} else {
+				charbuf_append(ctx, c);
+			}
+			break;
+
+		case SCPI_DT_INT:
+		case SCPI_DT_INT64:
+			if (!IS_INT_CHAR(c)) {
+				sprintf(ctx->pst.ebuf, "'%c' not allowed in INT.", c);
+				scpi_add_error(ctx, E_CMD_INVALID_CHARACTER_IN_NUMBER, ctx->pst.ebuf);
+
+				ctx->pst.state = PARS_DISCARD_LINE;
+			} else {
+				charbuf_append(ctx, c);
+			}
+			break;
+
+		case SCPI_DT_ENUM:
+		case SCPI_DT_BOOL:
+			if (!IS_CHARDATA_CHAR(c)) {
+				sprintf(ctx->pst.ebuf, "'%c' not allowed in %s.", c, (type == SCPI_DT_BOOL) ? "BOOL" : "ENUM");
+				scpi_add_error(ctx, E_CMD_INVALID_CHARACTER_DATA, ctx->pst.ebuf);
+
+				ctx->pst.state = PARS_DISCARD_LINE;
+			} else {
+				enum_feed(ctx, c);
+				charbuf_append(ctx, c);
+			}
+			break;
+
+		case SCPI_DT_CHARDATA:
+			if (!IS_CHARDATA_CHAR(c)) {
+				sprintf(ctx->pst.ebuf, "'%c' not allowed in CHARDATA.", c);
+				scpi_add_error(ctx, E_CMD_INVALID_CHARACTER_DATA, ctx->pst.ebuf);
+
+				ctx->pst.state = PARS_DISCARD_LINE;
+			} else {
+				charbuf_append(ctx, c);
+			}
+			break;
+
+		case SCPI_DT_STRING:
+		case SCPI_DT_STRING_STREAM:
+			if ((c == '\'' || c == '"') && !ctx->pst.string_open) {
+				ctx->pst.state = PARS_ARG_STRING;
+				ctx->pst.string_quote = c;
+				ctx->pst.string_escape = false;
+				ctx->pst.string_open = true;
+				ctx->pst.string_len = 0;
+
+				const SCPI_param_ext_t *ext = cmd_ext(ctx->pst.matched_cmd);
+				if (type == SCPI_DT_STRING_STREAM && ext->string_buf != NULL && ext->string_buf_len > 0) {
+					ext->string_buf[0] = 0;
+				}
+			} else {
+				scpi_add_error(ctx, E_CMD_INVALID_STRING_DATA, "Invalid quote, or chars after string.");
+				ctx->pst.state = PARS_DISCARD_LINE;
+			}
+			break;
+
+		case SCPI_DT_CHANLIST:
+			if (c == '(' && ctx->pst.chan_state == CHAN_NONE) {
+				chan_start(ctx);
+			} else {
+				scpi_add_error(ctx, E_CMD_INVALID_EXPRESSION, "Expected channel list (@...)");
+				ctx->pst.state = PARS_DISCARD_LINE;
+			}
+			break;
+
+		case SCPI_DT_BLOB:
+			if (c == '#') {
+				ctx->pst.state = PARS_ARG_BLOB_PREAMBLE;
+				ctx->pst.blob_cnt = 0;
+			} else {
+				scpi_add_error(ctx, E_CMD_INVALID_BLOCK_DATA, "Block data must start with #");
+				ctx->pst.state = PARS_DISCARD_LINE;
+			}
+			break;
+
+		default:
+			charbuf_append(ctx, c);
+			break;
+	}
+}
+
+
+/** Check if the current arg has any content yet */
+static bool arg_started(scpi_ctx_t *ctx)
+{
+	return ctx->pst.charbuf_i > 0 || ctx->pst.chan_state != CHAN_NONE || ctx->pst.string_open;
+}
+
+
+// ---- channel lists ----
+
+/** Start of a channel list, '(' received */
+static void chan_start(scpi_ctx_t *ctx)
+{
+	const SCPI_param_ext_t *ext = cmd_ext(ctx->pst.matched_cmd);
+
+	ctx->pst.state = PARS_ARG_CHANLIST;
+	ctx->pst.chan_state = CHAN_OPEN;
+	ctx->pst.args[ctx->pst.arg_i].CHANLIST.count = 0;
+	ctx->pst.args[ctx->pst.arg_i].CHANLIST.ranges = arena_alloc(ctx, 0); // grows with each entry
+
+	if (ext->chan_bitmap != NULL) {
+		memset(ext->chan_bitmap, 0, (ext->chan_bitmap_bits + 7) / 8);
+	}
+}
+
+
+/** Reset the channel address being received */
+static void chan_next(scpi_ctx_t *ctx)
+{
+	ctx->pst.chan_num = 0;
+	ctx->pst.chan_mod = 0;
+	ctx->pst.chan_digits = false;
+	ctx->pst.chan_has_mod = false;
+}
+
+
+/** Raise a channel list error, the rest of the line is discarded */
+static void chan_error(scpi_ctx_t *ctx, int16_t code, const char *msg, char c)
+{
+	scpi_add_error(ctx, code, msg);
+
+	if (c == '\n') {
+		pars_reset_cmd(ctx); // the line ended already
+	} else {
+		ctx->pst.state = PARS_DISCARD_LINE;
+	}
+}
+
+
+/** Add a channel range to the list (and the bitmap) */
+static bool chan_add(scpi_ctx_t *ctx, uint32_t first, uint32_t last)
+{
+	const SCPI_param_ext_t *ext = cmd_ext(ctx->pst.matched_cmd);
+	SCPI_argval_t *dest = &ctx->pst.args[ctx->pst.arg_i];
+
+	SCPI_chanrange_t *range = NULL;
+
+	if (dest->CHANLIST.count < SCPI_MAX_CHAN_RANGES) {
+		range = arena_alloc(ctx, sizeof(SCPI_chanrange_t)); // right after the previous one
+		if (range == NULL) {
+			scpi_add_error(ctx, E_EXE_OUT_OF_MEMORY, "Argument arena full.");
+			return false;
+		}
+
+		range->first = first;
+		range->last = last;
+	} else if (ext->chan_bitmap == NULL || dest->CHANLIST.count == UINT16_MAX) {
+		sprintf(ctx->pst.ebuf, "More than %d channel list entries.", SCPI_MAX_CHAN_RANGES);
+		scpi_add_error(ctx, E_EXE_TOO_MUCH_DATA, ctx->pst.ebuf);
+		return false;
+	}
+
+	dest->CHANLIST.count++;
+
+	if (ext->chan_bitmap == NULL) return true;
+
+	// all channels between, in both dimensions
+	uint32_t m1 = SCPI_CHAN_MODULE(first), m2 = SCPI_CHAN_MODULE(last);
+	uint32_t c1 = SCPI_CHAN_CHANNEL(first), c2 = SCPI_CHAN_CHANNEL(last);
+	if (m1 > m2) { const uint32_t t = m1; m1 = m2; m2 = t; }
+	if (c1 > c2) { const uint32_t t = c1; c1 = c2; c2 = t; }
+
+	for (uint32_t m = m1; m <= m2; m++) {
+		for (uint32_t ch = c1; ch <= c2; ch++) {
+			const uint32_t bit = m * ext->chan_per_module + ch;
+
+			if (bit >= ext->chan_bitmap_bits || (ext->chan_per_module && ch >= ext->chan_per_module)) {
+				sprintf(ctx->pst.ebuf, "No channel %" PRIu32 "!%" PRIu32 ".", m, ch);
+				scpi_add_error(ctx, E_EXE_DATA_OUT_OF_RANGE, ctx->pst.ebuf);
+				return false;
+			}
+
+			ext->chan_bitmap[bit / 8] |= (uint8_t)(1 << (bit % 8));
+		}
+	}
+
+	return true;
+}
+
+
+/** Receive a char of a channel list, after '(' */
+static void pars_chan_char(scpi_ctx_t *ctx, char c)
+{
+	if (IS_WHITESPACE(c)) return;
+
+	if (ctx->pst.chan_state == CHAN_OPEN) {
+		if (c == '@') {
+			ctx->pst.chan_state = CHAN_LIST;
+			ctx->pst.chan_range = false;
+			chan_next(ctx);
+		} else {
+			chan_error(ctx, E_CMD_INVALID_EXPRESSION, "Expected '@' in channel list.", c);
+		}
+		return;
+	}
+
+	if (IS_NUMBER_CHAR(c)) {
+		ctx->pst.chan_num = ctx->pst.chan_num * 10 + (uint32_t)(c - '0');
+		ctx->pst.chan_digits = true;
+
+		if (ctx->pst.chan_num > UINT16_MAX) {
+			chan_error(ctx, E_EXE_DATA_OUT_OF_RANGE, "Channel number too large.", c);
+		}
+		return;
+	}
+
+	switch (c) {
+		case '!': // module!channel
+			if (!ctx->pst.chan_digits || ctx->pst.chan_has_mod) break;
+
+			ctx->pst.chan_mod = ctx->pst.chan_num;
+			ctx->pst.chan_has_mod = true;
+			ctx->pst.chan_num = 0;
+			ctx->pst.chan_digits = false;
+			return;
+
+		case ':': // range
+			if (!ctx->pst.chan_digits || ctx->pst.chan_range) break;
+
+			ctx->pst.chan_first = SCPI_CHAN(ctx->pst.chan_mod, ctx->pst.chan_num);
+			ctx->pst.chan_range = true;
+			chan_next(ctx);
+			return;
+
+		case ',':
+		case ')':
+			if (!ctx->pst.chan_digits) {
+				// only an empty list is allowed, (@)
+				if (c == ',' || ctx->pst.chan_range || ctx->pst.chan_has_mod
+					|| ctx->pst.args[ctx->pst.arg_i].CHANLIST.count > 0) break;
+			} else {
+				// range end without a module is in the module of the start (1!1:8)
+				const uint32_t mod = (ctx->pst.chan_range && !ctx->pst.chan_has_mod)
+									 ? SCPI_CHAN_MODULE(ctx->pst.chan_first) : ctx->pst.chan_mod;
+				const uint32_t addr = SCPI_CHAN(mod, ctx->pst.chan_num);
+
+				if (!chan_add(ctx, ctx->pst.chan_range ? ctx->pst.chan_first : addr, addr)) {
+					ctx->pst.state = PARS_DISCARD_LINE;
+					return;
+				}
+			}
+
+			ctx->pst.chan_range = false;
+			chan_next(ctx);
+
+			if (c == ')') {
+				ctx->pst.chan_state = CHAN_DONE;
+				ctx->pst.state = PARS_ARG; // next will be newline or comma (or ignored spaces)
+			}
+			return;
+
+		default:
+			break;
+	}
+
+	if (c == '\n') {
+		chan_error(ctx, E_CMD_INVALID_EXPRESSION, "Channel list not closed.", c);
+	} else {
+		sprintf(ctx->pst.ebuf, "Unexpected '%c' in channel list.", c);
+		chan_error(ctx, E_CMD_INVALID_EXPRESSION, ctx->pst.ebuf, c);
+	}
+}
+
+
+/** Received a comma while collecting an arg */
+static void pars_arg_comma(scpi_ctx_t *ctx)
+{
+	if (ctx->pst.matched_cmd->params[ctx->pst.arg_i] == SCPI_DT_LIST) {
+		if (ctx->pst.charbuf_i == 0) {
+			scpi_add_error(ctx, E_CMD_SYNTAX_ERROR, "Missing list element before comma.");
+			ctx->pst.state = PARS_DISCARD_LINE;
+			return;
+		}
+
+		charbuf_terminate(ctx);
+		list_element(ctx);
+		return;
+	}
+
+	if (ctx->pst.arg_i + 1 >= cmd_param_count(ctx->pst.matched_cmd)) {
+		// it was the last argument
+		scpi_add_error(ctx, E_CMD_UNEXPECTED_NUMBER_OF_PARAMETERS, "Comma after last argument.");
+		ctx->pst.state = PARS_DISCARD_LINE;
+		return;
+	}
+
+	if (!arg_started(ctx)) {
+		scpi_add_error(ctx, E_CMD_SYNTAX_ERROR, "Missing command before comma.");
+		ctx->pst.state = PARS_DISCARD_LINE;
+		return;
+	}
+
+	// Convert to the right type
+
+	arg_convert_value(ctx);
+}
+
+
+// line ended with \n or ;
+static void pars_arg_eol_do(scpi_ctx_t *ctx, bool keep_levels)
+{
+	int req_cnt = cmd_param_count(ctx->pst.matched_cmd);
+
+	if (req_cnt == 0) {
+		// query with limits - "CMD? MAX", or just trailing whitespace
+		if (ctx->pst.charbuf_i > 0) {
+			limit_query(ctx);
+		} else {
+			run_command_callback(ctx);
+		}
+	} else {
+		if (ctx->pst.arg_i + (arg_started(ctx) ? 1 : 0) < req_cnt) {
+			// not the last arg yet - fail
+
+			if (arg_started(ctx)) ctx->pst.arg_i++; // acknowledge the last arg
+
+			sprintf(ctx->pst.ebuf, "Required %d arg, got %d.", req_cnt, ctx->pst.arg_i);
+			scpi_add_error(ctx, E_CMD_MISSING_PARAMETER, ctx->pst.ebuf);
+
+			ctx->pst.state = PARS_DISCARD_LINE;
+		} else {
+			arg_convert_value(ctx);
 
-/** Non-whitespace and non-comma char received in arg. */
-static void pars_arg_char(char c)
+			// invalid argument - error raised, no callback
+			if (ctx->pst.state != PARS_DISCARD_LINE) run_command_callback(ctx);
+		}
+	}
+
+	if (ctx->pst.state == PARS_DISCARD_LINE) {
+		// the rest of the line is discarded
+		if (!keep_levels) pars_reset_cmd(ctx);
+	} else if (keep_levels) {
+		pars_reset_cmd_keeplevel(ctx);
+	} else {
+		pars_reset_cmd(ctx); // start a new command
+	}
+}
+
+
+static void pars_arg_newline(scpi_ctx_t *ctx)
 {
-	switch (pst.matched_cmd->params[pst.arg_i]) {
-		case SCPI_DT_FLOAT:
-			if (!IS_FLOAT_CHAR(c)) {
-				sprintf(ebuf, "'%c' not allowed in FLOAT.", c);
-				scpi_add_error(E_CMD_INVALID_CHARACTER_IN_NUMBER, ebuf);
+	pars_arg_eol_do(ctx, false);
+}
 
-				pst.state = PARS_DISCARD_LINE;
-			} else {
-				charbuf_append(c);
-			}
-			break;
 
-		case SCPI_DT_INT:
-			if (!IS_INT_CHAR(c)) {
-				sprintf(ebuf, "'%c' not allowed in INT.", c);
-				scpi_add_error(E_CMD_INVALID_CHARACTER_IN_NUMBER, ebuf);
+static void pars_arg_semicolon(scpi_ctx_t *ctx)
+{
+	pars_arg_eol_do(ctx, true);
+}
 
-				pst.state = PARS_DISCARD_LINE;
-			} else {
-				charbuf_append(c);
-			}
-			break;
 
-		case SCPI_DT_CHARDATA:
-			if (!IS_CHARDATA_CHAR(c)) {
-				sprintf(ebuf, "'%c' not allowed in CHARDATA.", c);
-				scpi_add_error(E_CMD_INVALID_CHARACTER_DATA, ebuf);
+/** Raise an error for a failed number conversion */
+static void arg_num_check(scpi_ctx_t *ctx, scpi_num_status_t st, const char *type, const char *str)
+{
+	switch (st) {
+		case SCPI_NUM_OK:
+			return;
 
-				pst.state = PARS_DISCARD_LINE;
-			} else {
-				charbuf_append(c);
-			}
+		case SCPI_NUM_EXPONENT:
+			scpi_add_error(ctx, E_CMD_EXPONENT_TOO_LARGE, NULL);
 			break;
 
-		case SCPI_DT_STRING:
-			if (c == '\'' || c == '"') {
-				pst.state = PARS_ARG_STRING;
-				pst.string_quote = c;
-				pst.string_escape = false;
-			} else {
-				scpi_add_error(E_CMD_INVALID_STRING_DATA, "Invalid quote, or chars after string.");
-				pst.state = PARS_DISCARD_LINE;
-			}
+		case SCPI_NUM_DIGITS:
+			sprintf(ctx->pst.ebuf, "%s too large: '%s'", type, str);
+			scpi_add_error(ctx, E_CMD_TOO_MANY_DIGITS, ctx->pst.ebuf);
 			break;
 
-		case SCPI_DT_BLOB:
-			if (c == '#') {
-				pst.state = PARS_ARG_BLOB_PREAMBLE;
-				pst.blob_cnt = 0;
-			} else {
-				scpi_add_error(E_CMD_INVALID_BLOCK_DATA, "Block data must start with #");
-				pst.state = PARS_DISCARD_LINE;
-			}
+		case SCPI_NUM_RANGE:
+			sprintf(ctx->pst.ebuf, "%s out of range: '%s'", type, str);
+			scpi_add_error(ctx, E_EXE_DATA_OUT_OF_RANGE, ctx->pst.ebuf);
 			break;
 
 		default:
-			charbuf_append(c);
-			break;
+			sprintf(ctx->pst.ebuf, "Invalid %s value: '%s'", type, str);
+			scpi_add_error(ctx, E_CMD_NUMERIC_DATA_ERROR, ctx->pst.ebuf);
 	}
+
+	ctx->pst.state = PARS_DISCARD_LINE;
 }
 
 
-/** Received a comma while collecting an arg */
-static void pars_arg_comma(void)
+// Enumerated arguments
+
+static const char *const bool_mnemonics[] = {"0", "1", "OFF", "ON", NULL};
+
+
+/** Mnemonics of the current ENUM (or BOOL) argument */
+static const char *const *enum_list(scpi_ctx_t *ctx)
 {
-	if (pst.arg_i == cmd_param_count(pst.matched_cmd) - 1) {
-		// it was the last argument
-		scpi_add_error(E_CMD_UNEXPECTED_NUMBER_OF_PARAMETERS, "Comma after last argument.");
-		pst.state = PARS_DISCARD_LINE;
-		return;
+	if (ctx->pst.matched_cmd->params[ctx->pst.arg_i] == SCPI_DT_BOOL) return bool_mnemonics;
+
+	return cmd_ext(ctx->pst.matched_cmd)->enums[ctx->pst.arg_i];
+}
+
+
+/** Drop the mnemonics not matching the next char of an ENUM argument (before it's appended) */
+static void enum_feed(scpi_ctx_t *ctx, char c)
+{
+	const char *const *list = enum_list(ctx);
+	const uint16_t pos = ctx->pst.charbuf_i;
+
+	if (pos == 0) ctx->pst.enum_mask = UINT32_MAX;
+	if (list == NULL) return;
+
+	uint32_t mask = ctx->pst.enum_mask;
+	for (uint8_t j = 0; j < 32 && list[j] != NULL; j++) {
+		// earlier chars matched, so the mnemonic is at least 'pos' long
+		if ((mask & (1UL << j)) && !char_equals_ci(list[j][pos], c)) mask &= ~(1UL << j);
 	}
 
-	if (pst.charbuf_i == 0) {
-		scpi_add_error(E_CMD_SYNTAX_ERROR, "Missing command before comma.");
-		pst.state = PARS_DISCARD_LINE;
-		return;
+	ctx->pst.enum_mask = mask;
+}
+
+
+/** Index of the mnemonic matched by the complete ENUM argument (in the charbuf), -1 if none */
+static int8_t enum_match(scpi_ctx_t *ctx)
+{
+	const char *const *list = enum_list(ctx);
+	const size_t len = strlen(ctx->pst.charbuf);
+
+	if (list == NULL) return -1;
+
+	for (uint8_t j = 0; j < 32 && list[j] != NULL; j++) {
+		if (!(ctx->pst.enum_mask & (1UL << j))) continue;
+
+		const char *m = list[j];
+		const bool is_long = (m[len] == 0);
+		// short form - the upper case chars, the lower case rest is left out
+		const bool is_short = IS_LCASE_CHAR(m[len]) && len > 0 && !IS_LCASE_CHAR(m[len - 1]);
+
+		if (is_long || is_short) return (int8_t) j;
 	}
 
-	// Convert to the right type
+	return -1;
+}
+
+
+// Numeric keywords
 
-	arg_convert_value();
+enum {
+	KW_NONE = 0,
+	KW_MIN,
+	KW_MAX,
+	KW_DEF,
+	KW_INF,
+	KW_NINF,
+};
+
+static const struct {
+	char name[8];
+	uint8_t kw;
+} num_keywords[] = {
+	{"MINimum", KW_MIN},
+	{"MAXimum", KW_MAX},
+	{"DEFault", KW_DEF},
+	{"INF", KW_INF},
+	{"NINF", KW_NINF},
+};
+
+
+/** Find a numeric keyword (MIN, MAXimum, ...), KW_NONE if it is not one */
+static uint8_t num_keyword(const char *str)
+{
+	if (!(IS_LCASE_CHAR(str[0]) || IS_UCASE_CHAR(str[0]))) return KW_NONE;
+
+	for (uint8_t i = 0; i < sizeof(num_keywords) / sizeof(num_keywords[0]); i++) {
+		if (level_str_matches(str, num_keywords[i].name)) return num_keywords[i].kw;
+	}
+
+	return KW_NONE;
 }
 
 
-// line ended with \n or ;
-static void pars_arg_eol_do(bool keep_levels)
+/** Get MIN, MAX or DEF from limits, NULL if not one of them */
+static const SCPI_numval_t *limit_value(const SCPI_limits_t *lim, uint8_t kw)
+{
+	switch (kw) {
+		case KW_MIN: return &lim->min;
+		case KW_MAX: return &lim->max;
+		case KW_DEF: return &lim->def;
+		default: return NULL;
+	}
+}
+
+
+/** Store a numeric value to an argument */
+static void arg_set_num(SCPI_argval_t *dest, SCPI_datatype_t type, const SCPI_numval_t *v)
+{
+	switch (type) {
+		case SCPI_DT_FLOAT: dest->FLOAT = v->FLOAT; break;
+		case SCPI_DT_DOUBLE: dest->DOUBLE = v->DOUBLE; break;
+		case SCPI_DT_INT: dest->INT = v->INT; break;
+		case SCPI_DT_INT64: dest->INT64 = v->INT64; break;
+		default: dest->FIXED = v->FIXED; break; // SCPI_DT_FIXED
+	}
+}
+
+
+/** Check a numeric argument against its limits */
+static bool arg_in_limits(const SCPI_argval_t *a, SCPI_datatype_t type, const SCPI_limits_t *lim)
+{
+	switch (type) {
+		case SCPI_DT_FLOAT: return a->FLOAT >= lim->min.FLOAT && a->FLOAT <= lim->max.FLOAT;
+		case SCPI_DT_DOUBLE: return a->DOUBLE >= lim->min.DOUBLE && a->DOUBLE <= lim->max.DOUBLE;
+		case SCPI_DT_INT: return a->INT >= lim->min.INT && a->INT <= lim->max.INT;
+		case SCPI_DT_INT64: return a->INT64 >= lim->min.INT64 && a->INT64 <= lim->max.INT64;
+		default: return a->FIXED >= lim->min.FIXED && a->FIXED <= lim->max.FIXED; // SCPI_DT_FIXED
+	}
+}
+
+
+/**
+ * Resolve a numeric keyword argument.
+ *
+ * @returns true if the value was set, false on error (raised)
+ */
+static bool arg_keyword(scpi_ctx_t *ctx, SCPI_argval_t *dest, SCPI_datatype_t type, uint8_t kw, uint8_t index,
+						const char *str)
 {
-	int req_cnt = cmd_param_count(pst.matched_cmd);
+	const SCPI_limits_t *lim = cmd_ext(ctx->pst.matched_cmd)->limits[index];
+
+	if (kw == KW_INF || kw == KW_NINF) {
+		if (type == SCPI_DT_FLOAT) {
+			dest->FLOAT = (kw == KW_INF) ? INFINITY : -INFINITY;
+		} else if (type == SCPI_DT_DOUBLE) {
+			dest->DOUBLE = (kw == KW_INF) ? (double) INFINITY : -(double) INFINITY;
+		} else {
+			sprintf(ctx->pst.ebuf, "Not a finite number: '%s'", str);
+			scpi_add_error(ctx, E_EXE_DATA_OUT_OF_RANGE, ctx->pst.ebuf);
+			ctx->pst.state = PARS_DISCARD_LINE;
+			return false;
+		}
+
+		return true;
+	}
 
-	if (pst.arg_i + (pst.charbuf_i ? 1 : 0) < req_cnt) {
-		// not the last arg yet - fail
+	if (lim == NULL) {
+		sprintf(ctx->pst.ebuf, "No limits to use: '%s'", str);
+		scpi_add_error(ctx, E_EXE_ILLEGAL_PARAMETER_VALUE, ctx->pst.ebuf);
+		ctx->pst.state = PARS_DISCARD_LINE;
+		return false;
+	}
+
+	arg_set_num(dest, type, limit_value(lim, kw));
+	return true;
+}
 
-		if (pst.charbuf_i > 0) pst.arg_i++; // acknowledge the last arg
 
-		sprintf(ebuf, "Required %d arg, got %d.", req_cnt, pst.arg_i);
-		scpi_add_error(E_CMD_MISSING_PARAMETER, ebuf);
+/** Answer "CMD? MIN|MAX|DEF" of a query with limits */
+static void limit_query(scpi_ctx_t *ctx)
+{
+	charbuf_terminate(ctx);
+
+	const SCPI_limits_t *lim = cmd_ext(ctx->pst.matched_cmd)->limits[0];
+	const SCPI_numval_t *v = limit_value(lim, num_keyword(ctx->pst.charbuf));
 
-		pst.state = PARS_DISCARD_LINE;
+	if (v == NULL) {
+		sprintf(ctx->pst.ebuf, "Expected MIN, MAX or DEF: '%s'", ctx->pst.charbuf);
+		scpi_add_error(ctx, E_EXE_ILLEGAL_PARAMETER_VALUE, ctx->pst.ebuf);
+		ctx->pst.state = PARS_DISCARD_LINE;
 		return;
 	}
 
-	arg_convert_value();
-	run_command_callback();
+	switch (lim->type) {
+		case SCPI_DT_FLOAT: scpi_resp_float(ctx, v->FLOAT); break;
+		case SCPI_DT_DOUBLE: scpi_resp_double(ctx, v->DOUBLE); break;
+		case SCPI_DT_INT: scpi_resp_int(ctx, v->INT); break;
+		case SCPI_DT_INT64: scpi_resp_int64(ctx, v->INT64); break;
+		default: scpi_resp_fixed(ctx, v->FIXED, cmd_ext(ctx->pst.matched_cmd)->fixed); break; // SCPI_DT_FIXED
+	}
+
+	scpi_resp_end(ctx);
+}
+
+
+// Unit suffixes (IEEE 488.2 7.7.3), upper case. Units are matched first, so MA with
+// ampere allowed is milliampere, and F with farad allowed is farad (not femto).
+
+static const struct {
+	char name[4];
+	uint16_t unit;
+} suffix_units[] = {
+	{"V", SCPI_UNIT_V},
+	{"A", SCPI_UNIT_A},
+	{"W", SCPI_UNIT_W},
+	{"OHM", SCPI_UNIT_OHM},
+	{"HZ", SCPI_UNIT_HZ},
+	{"S", SCPI_UNIT_S},
+	{"F", SCPI_UNIT_F},
+	{"H", SCPI_UNIT_H},
+	{"CEL", SCPI_UNIT_CEL},
+	{"DEG", SCPI_UNIT_DEG},
+	{"PCT", SCPI_UNIT_PCT},
+};
+
+static const struct {
+	char name[3];
+	int8_t exp10;
+} suffix_prefixes[] = {
+	{"EX", 18}, {"PE", 15}, {"T", 12}, {"G", 9}, {"MA", 6}, {"K", 3},
+	{"M", -3}, {"U", -6}, {"N", -9}, {"P", -12}, {"F", -15}, {"A", -18},
+};
+
+#define SUFFIX_MAX_LEN 8
+
+
+/** Find a metric prefix, returns false if not known */
+static bool suffix_prefix(const char *name, int8_t *exp10)
+{
+	if (name[0] == 0) {
+		*exp10 = 0;
+		return true;
+	}
+
+	for (uint8_t i = 0; i < sizeof(suffix_prefixes) / sizeof(suffix_prefixes[0]); i++) {
+		if (strcmp(name, suffix_prefixes[i].name) == 0) {
+			*exp10 = suffix_prefixes[i].exp10;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/**
+ * Look up a unit suffix (any case) in the allowed units.
+ *
+ * @returns unit, SCPI_UNIT_NONE if not valid
+ */
+static SCPI_unit_t suffix_lookup(const char *suffix, uint16_t allowed, int8_t *exp10)
+{
+	char up[SUFFIX_MAX_LEN + 1];
+	size_t len = 0;
+
+	for (; suffix[len] != 0; len++) {
+		const char c = suffix[len];
+		if (len == SUFFIX_MAX_LEN || !(IS_LCASE_CHAR(c) || IS_UCASE_CHAR(c))) return SCPI_UNIT_NONE;
+		up[len] = IS_LCASE_CHAR(c) ? CHAR_TO_UPPER(c) : c;
+	}
+	up[len] = 0;
+
+	for (uint8_t i = 0; i < sizeof(suffix_units) / sizeof(suffix_units[0]); i++) {
+		const uint16_t unit = suffix_units[i].unit;
+		const size_t ulen = strlen(suffix_units[i].name);
+
+		if (!(allowed & unit) || ulen > len || strcmp(up + len - ulen, suffix_units[i].name) != 0) continue;
+
+		// the rest is the prefix
+		char prefix[SUFFIX_MAX_LEN + 1];
+		memcpy(prefix, up, len - ulen);
+		prefix[len - ulen] = 0;
+
+		if ((unit == SCPI_UNIT_HZ || unit == SCPI_UNIT_OHM) && strcmp(prefix, "M") == 0) {
+			*exp10 = 6; // MHZ, MOHM are mega
+			return (SCPI_unit_t) unit;
+		}
+
+		if (suffix_prefix(prefix, exp10)) return (SCPI_unit_t) unit;
+	}
+
+	if ((allowed & SCPI_UNIT_PREFIX) && suffix_prefix(up, exp10)) return SCPI_UNIT_PREFIX;
+
+	return SCPI_UNIT_NONE;
+}
+
+
+/**
+ * Split off a unit suffix of a numeric argument and apply its prefix by adjusting
+ * the exponent of the number text (copied to 'buf'), so the conversion stays exact.
+ *
+ * @returns the number to convert, NULL on error (raised)
+ */
+static const char *arg_suffix(scpi_ctx_t *ctx, uint8_t index, const char *str, char *buf)
+{
+	ctx->pst.arg_units[index] = SCPI_UNIT_NONE;
+
+	scpi_decimal_t dec;
+	const size_t len = scpi_scan_decimal(str, &dec);
+	// no suffix, or not a decimal number (eg. #H) - left to the conversion
+	if (len == 0 || !(IS_LCASE_CHAR(str[len]) || IS_UCASE_CHAR(str[len]))) return str;
+
+	const uint16_t allowed = cmd_ext(ctx->pst.matched_cmd)->units[index];
+	if (allowed == 0) {
+		sprintf(ctx->pst.ebuf, "No suffix allowed: '%s'", str);
+		scpi_add_error(ctx, E_CMD_SUFFIX_NOT_ALLOWED, ctx->pst.ebuf);
+		ctx->pst.state = PARS_DISCARD_LINE;
+		return NULL;
+	}
+
+	int8_t adj;
+	const SCPI_unit_t unit = suffix_lookup(str + len, allowed, &adj);
+	if (unit == SCPI_UNIT_NONE) {
+		sprintf(ctx->pst.ebuf, "Invalid suffix: '%s'", str + len);
+		scpi_add_error(ctx, E_CMD_INVALID_SUFFIX, ctx->pst.ebuf);
+		ctx->pst.state = PARS_DISCARD_LINE;
+		return NULL;
+	}
+
+	ctx->pst.arg_units[index] = unit;
+
+	// mantissa text, then the exponent with the prefix added
+	size_t n = 0;
+	int32_t e = adj;
+
+	while (n < len && str[n] != 'e' && str[n] != 'E') n++;
+
+	if (n < len) {
+		const char *p = str + n + 1;
+		const bool neg = (*p == '-');
+		int32_t old = 0;
+
+		if (*p == '+' || *p == '-') p++;
+		for (; IS_NUMBER_CHAR(*p); p++) {
+			if (old < 1000000) old = old * 10 + (*p - '0'); // saturate, too large anyway
+		}
+
+		e += neg ? -old : old;
+	}
+
+	memcpy(buf, str, n);
+	sprintf(buf + n, "E%" PRId32, e);
+	return buf;
+}
+
 
-	if (keep_levels) {
-		pars_reset_cmd_keeplevel();
+/**
+ * Convert a numeric argument - keyword, or a number with an optional unit suffix
+ *
+ * @param index param of the matched command (units, limits)
+ * @param str the argument text
+ */
+static void arg_convert_number(scpi_ctx_t *ctx, SCPI_argval_t *dest, SCPI_datatype_t type, uint8_t index,
+							   const char *str)
+{
+	const SCPI_limits_t *lim = cmd_ext(ctx->pst.matched_cmd)->limits[index];
+	const uint8_t kw = num_keyword(str);
+
+	if (kw != KW_NONE) {
+		ctx->pst.arg_units[index] = SCPI_UNIT_NONE;
+		if (!arg_keyword(ctx, dest, type, kw, index, str)) return;
 	} else {
-		pars_reset_cmd(); // start a new command
+		char buf[MAX_CHARBUF_LEN + 10]; // number with the suffix replaced by an exponent
+		const char *num = arg_suffix(ctx, index, str, buf);
+		if (num == NULL) return;
+
+		switch (type) {
+			case SCPI_DT_FLOAT:
+				arg_num_check(ctx, scpi_parse_float(num, &dest->FLOAT), "FLOAT", str);
+				break;
+
+			case SCPI_DT_DOUBLE:
+				arg_num_check(ctx, scpi_parse_double(num, &dest->DOUBLE), "DOUBLE", str);
+				break;
+
+			case SCPI_DT_INT:
+				arg_num_check(ctx, scpi_parse_int(num, &dest->INT), "INT", str);
+				break;
+
+			case SCPI_DT_INT64:
+				arg_num_check(ctx, scpi_parse_int64(num, &dest->INT64), "INT64", str);
+				break;
+
+			default: // SCPI_DT_FIXED
+				arg_num_check(ctx, scpi_parse_fixed(num, cmd_ext(ctx->pst.matched_cmd)->fixed, &dest->FIXED), "FIXED", str);
+		}
+
+		if (ctx->pst.state == PARS_DISCARD_LINE) return;
+	}
+
+	if (lim != NULL && !arg_in_limits(dest, type, lim)) {
+		sprintf(ctx->pst.ebuf, "Out of limits: '%s'", str);
+		scpi_add_error(ctx, E_EXE_DATA_OUT_OF_RANGE, ctx->pst.ebuf);
+		ctx->pst.state = PARS_DISCARD_LINE;
 	}
 }
 
 
-static void pars_arg_newline(void)
+/** Convert a LIST element (in the terminated charbuf) and pass it on */
+static void list_element(scpi_ctx_t *ctx)
 {
-	pars_arg_eol_do(false);
+	const SCPI_param_ext_t *ext = cmd_ext(ctx->pst.matched_cmd);
+	SCPI_argval_t v;
+
+	arg_convert_number(ctx, &v, ext->list_type, ctx->pst.arg_i, ctx->pst.charbuf);
+	if (ctx->pst.state == PARS_DISCARD_LINE) return;
+
+	const uint32_t index = ctx->pst.list_cnt++;
+
+	if (ext->list_callback != NULL) {
+		ext->list_callback(ctx, &v, index);
+	}
+
+	if (ext->list_buf != NULL) {
+		if (ctx->pst.list_fill == ext->list_buf_len) {
+			sprintf(ctx->pst.ebuf, "List longer than %" PRIu32 ".", ext->list_buf_len);
+			scpi_add_error(ctx, E_EXE_TOO_MUCH_DATA, ctx->pst.ebuf);
+			ctx->pst.state = PARS_DISCARD_LINE;
+			return;
+		}
+
+		const uint32_t i = ctx->pst.list_fill++;
+		switch (ext->list_type) {
+			case SCPI_DT_FLOAT: ((float *) ext->list_buf)[i] = v.FLOAT; break;
+			case SCPI_DT_DOUBLE: ((double *) ext->list_buf)[i] = v.DOUBLE; break;
+			case SCPI_DT_INT64: ((int64_t *) ext->list_buf)[i] = v.INT64; break;
+			default: ((int32_t *) ext->list_buf)[i] = v.INT; break; // INT, FIXED
+		}
+
+		if (ctx->pst.list_fill == ext->list_buf_len && ext->list_buf_callback != NULL) {
+			ext->list_buf_callback(ctx, ext->list_buf, ctx->pst.list_fill, index + 1 - ctx->pst.list_fill);
+			ctx->pst.list_fill = 0;
+		}
+	}
 }
 
 
-static void pars_arg_semicolon(void)
+/** LIST complete - pass on the rest of the buffer, set the element count */
+static void list_end(scpi_ctx_t *ctx, SCPI_argval_t *dest)
 {
-	pars_arg_eol_do(true);
+	const SCPI_param_ext_t *ext = cmd_ext(ctx->pst.matched_cmd);
+
+	if (ctx->pst.list_fill > 0 && ext->list_buf_callback != NULL) {
+		ext->list_buf_callback(ctx, ext->list_buf, ctx->pst.list_fill, ctx->pst.list_cnt - ctx->pst.list_fill);
+		ctx->pst.list_fill = 0;
+	}
+
+	dest->LIST_LEN = ctx->pst.list_cnt;
 }
 
 
-/** Convert BOOL, FLOAT or INT char to arg type and advance to next */
-static void arg_convert_value(void)
+/** Pass streamed string content to the command's string callback and buffer */
+static void string_deliver(scpi_ctx_t *ctx, const char *data, size_t len)
+{
+	const SCPI_param_ext_t *ext = cmd_ext(ctx->pst.matched_cmd);
+
+	if (ext->string_buf != NULL) {
+		if (ctx->pst.string_len + len >= ext->string_buf_len) {
+			sprintf(ctx->pst.ebuf, "String longer than %"PRIu32" chars.", ext->string_buf_len - 1);
+			scpi_add_error(ctx, E_EXE_TOO_MUCH_DATA, ctx->pst.ebuf);
+			ctx->pst.state = PARS_DISCARD_LINE;
+			return;
+		}
+
+		memcpy(ext->string_buf + ctx->pst.string_len, data, len);
+		ext->string_buf[ctx->pst.string_len + len] = 0;
+	}
+
+	if (ext->string_callback != NULL) {
+		ext->string_callback(ctx, data, len, ctx->pst.string_len);
+	}
+
+	ctx->pst.string_len += len;
+}
+
+
+/** Char of a quoted string received (unescaped) */
+static void string_char(scpi_ctx_t *ctx, char c)
+{
+	if (ctx->pst.matched_cmd->params[ctx->pst.arg_i] == SCPI_DT_STRING_STREAM) {
+		string_deliver(ctx, &c, 1);
+	} else {
+		charbuf_append(ctx, c);
+	}
+}
+
+
+/**
+ * Streamed string - pass a run of plain chars on directly from the input buffer.
+ * Quotes, escapes and newlines go through scpi_handle_byte().
+ *
+ * @returns number of bytes consumed
+ */
+static size_t pars_string_stream(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+	if (ctx->pst.string_escape) {
+		scpi_handle_byte(ctx, buf[0]);
+		return 1;
+	}
+
+	const char quote = ctx->pst.string_quote;
+	size_t n = 0;
+
+	while (n < len && buf[n] != quote && buf[n] != '\\' && buf[n] != '\n') n++;
+
+	if (n == 0) {
+		scpi_handle_byte(ctx, buf[0]);
+		return 1;
+	}
+
+	string_deliver(ctx, (const char *) buf, n);
+	return n;
+}
+
+
+/** Convert a numeric argument of a lazy_args command, on its first access */
+static void arg_lazy_convert(scpi_ctx_t *ctx, uint8_t index)
 {
-	charbuf_terminate();
+	const uint32_t bit = 1UL << index;
+	if (!(ctx->pst.arg_lazy & bit)) return;
+
+	ctx->pst.arg_lazy &= ~bit;
+
+	// the callback is running already - an error is only raised, the parser goes on
+	const uint8_t state = ctx->pst.state;
+	ctx->pst.state = PARS_ARG;
+
+	SCPI_argval_t *dest = &ctx->pst.args[index];
+	arg_convert_number(ctx, dest, ctx->pst.matched_cmd->params[index], index, ctx->pst.arg_raw[index]);
+
+	if (ctx->pst.state == PARS_DISCARD_LINE) {
+		ctx->pst.arg_bad |= bit;
+		memset(dest, 0, sizeof(SCPI_argval_t));
+	}
 
-	SCPI_argval_t *dest = &pst.args[pst.arg_i];
-	int j;
+	ctx->pst.state = state;
+}
+
+
+/** Convert BOOL, FLOAT or INT char to arg type and advance to next */
+static void arg_convert_value(scpi_ctx_t *ctx)
+{
+	charbuf_terminate(ctx);
+
+	const SCPI_datatype_t type = ctx->pst.matched_cmd->params[ctx->pst.arg_i];
+	const bool lazy = ctx->pst.matched_cmd->lazy_args;
+	SCPI_argval_t *dest = &ctx->pst.args[ctx->pst.arg_i];
+	int8_t i;
+
+	ctx->pst.arg_raw[ctx->pst.arg_i] = NULL;
+
+	if (lazy) {
+		// keep the text (STRING and CHARDATA are kept as the value)
+		switch (type) {
+			case SCPI_DT_FLOAT:
+			case SCPI_DT_DOUBLE:
+			case SCPI_DT_INT:
+			case SCPI_DT_INT64:
+			case SCPI_DT_FIXED:
+				// converted when accessed
+				ctx->pst.arg_raw[ctx->pst.arg_i] = arena_strdup(ctx, ctx->pst.charbuf);
+				ctx->pst.arg_lazy |= 1UL << ctx->pst.arg_i;
+				ctx->pst.arg_i++;
+				return;
+
+			case SCPI_DT_BOOL:
+			case SCPI_DT_ENUM:
+				ctx->pst.arg_raw[ctx->pst.arg_i] = arena_strdup(ctx, ctx->pst.charbuf);
+				break;
+
+			default:
+				break;
+		}
+	}
 
-	switch (pst.matched_cmd->params[pst.arg_i]) {
+	switch (type) {
 		case SCPI_DT_BOOL:
-			if (strcasecmp(pst.charbuf, "1") == 0) {
-				dest->BOOL = 1;
-			} else if (strcasecmp(pst.charbuf, "0") == 0) {
-				dest->BOOL = 0;
-			} else if (strcasecmp(pst.charbuf, "ON") == 0) {
-				dest->BOOL = 1;
-			} else if (strcasecmp(pst.charbuf, "OFF") == 0) {
-				dest->BOOL = 0;
+			i = enum_match(ctx);
+			if (i >= 0) {
+				dest->BOOL = (i & 1); // 0, 1, OFF, ON
 			} else {
-				sprintf(ebuf, "Invalid BOOL value: '%s'", pst.charbuf);
-				scpi_add_error(E_CMD_NUMERIC_DATA_ERROR, ebuf);
+				sprintf(ctx->pst.ebuf, "Invalid BOOL value: '%s'", ctx->pst.charbuf);
+				scpi_add_error(ctx, E_CMD_NUMERIC_DATA_ERROR, ctx->pst.ebuf);
 
-				pst.state = PARS_DISCARD_LINE;
+				ctx->pst.state = PARS_DISCARD_LINE;
 			}
 			break;
 
-		case SCPI_DT_FLOAT:
-			j = sscanf(pst.charbuf, "%f", &dest->FLOAT);
-			if (j == 0 || pst.charbuf[0] == '\0') { //fail or empty buffer
-				sprintf(ebuf, "Invalid FLOAT value: '%s'", pst.charbuf);
-				scpi_add_error(E_CMD_NUMERIC_DATA_ERROR, ebuf);
+		case SCPI_DT_ENUM:
+			i = enum_match(ctx);
+			if (i >= 0) {
+				dest->ENUM = (uint8_t) i;
+			} else {
+				sprintf(ctx->pst.ebuf, "Invalid choice: '%s'", ctx->pst.charbuf);
+				scpi_add_error(ctx, E_CMD_INVALID_CHARACTER_DATA, ctx->pst.ebuf);
 
-				pst.state = PARS_DISCARD_LINE;
+				ctx->pst.state = PARS_DISCARD_LINE;
 			}
 			break;
 
+		case SCPI_DT_FLOAT:
+		case SCPI_DT_DOUBLE:
 		case SCPI_DT_INT:
-			j = sscanf(pst.charbuf, "%" SCNu32, &dest->INT);
+		case SCPI_DT_INT64:
+		case SCPI_DT_FIXED:
+			arg_convert_number(ctx, dest, type, ctx->pst.arg_i, ctx->pst.charbuf);
+			break;
 
-			if (j == 0 || pst.charbuf[0] == '\0') { //fail or empty buffer
-				sprintf(ebuf, "Invalid INT value: '%s'", pst.charbuf);
-				scpi_add_error(E_CMD_NUMERIC_DATA_ERROR, ebuf);
+		case SCPI_DT_LIST:
+			// last element
+			list_element(ctx);
+			if (ctx->pst.state != PARS_DISCARD_LINE) list_end(ctx, dest);
+			break;
 
-				pst.state = PARS_DISCARD_LINE;
+		case SCPI_DT_CHANLIST:
+			if (ctx->pst.chan_state != CHAN_DONE) {
+				scpi_add_error(ctx, E_CMD_INVALID_EXPRESSION, "Expected channel list (@...)");
+				ctx->pst.state = PARS_DISCARD_LINE;
 			}
+
+			ctx->pst.chan_state = CHAN_NONE;
 			break;
 
 		case SCPI_DT_STRING:
-			if (strlen(pst.charbuf) > SCPI_MAX_STRING_LEN) {
-				scpi_add_error(E_CMD_STRING_DATA_ERROR, "String too long.");
+			if (strlen(ctx->pst.charbuf) > SCPI_MAX_STRING_LEN) {
+				scpi_add_error(ctx, E_CMD_STRING_DATA_ERROR, "String too long.");
 
-				pst.state = PARS_DISCARD_LINE;
+				ctx->pst.state = PARS_DISCARD_LINE;
 			} else {
-				strcpy(dest->STRING, pst.charbuf); // copy the string
+				dest->STRING = arena_strdup(ctx, ctx->pst.charbuf); // copy the string
+				if (lazy) ctx->pst.arg_raw[ctx->pst.arg_i] = dest->STRING;
 			}
 
+			ctx->pst.string_open = false;
+			break;
+
+		case SCPI_DT_STRING_STREAM:
+			dest->STRING_LEN = ctx->pst.string_len; // content was passed on already
+			ctx->pst.string_open = false;
 			break;
 
 		case SCPI_DT_CHARDATA:
-			if (strlen(pst.charbuf) > SCPI_MAX_STRING_LEN) { // using common buffer
-				scpi_add_error(E_CMD_CHARACTER_DATA_TOO_LONG, NULL);
+			if (strlen(ctx->pst.charbuf) > SCPI_MAX_STRING_LEN) { // using common buffer
+				scpi_add_error(ctx, E_CMD_CHARACTER_DATA_TOO_LONG, NULL);
 
-				pst.state = PARS_DISCARD_LINE;
+				ctx->pst.state = PARS_DISCARD_LINE;
 			} else {
-				strcpy(dest->CHARDATA, pst.charbuf); // copy the character data text
+				dest->CHARDATA = arena_strdup(ctx, ctx->pst.charbuf); // copy the character data text
+				if (lazy) ctx->pst.arg_raw[ctx->pst.arg_i] = dest->CHARDATA;
 			}
 
 			break;
 
 		default:
 			// impossible
-			scpi_add_error(E_DEV_SYSTEM_ERROR, "Unexpected argument data type.");
-			pst.state = PARS_DISCARD_LINE;
+			scpi_add_error(ctx, E_DEV_SYSTEM_ERROR, "Unexpected argument data type.");
+			ctx->pst.state = PARS_DISCARD_LINE;
 	}
 
 	// proceed to next argument
-	pst.arg_i++;
+	ctx->pst.arg_i++;
+}
+
+
+/** Blob preamble complete - run the command callback and receive the body */
+static void pars_blob_start(scpi_ctx_t *ctx, uint32_t len, bool indefinite)
+{
+	ctx->pst.blob_len = len;
+	ctx->pst.blob_indefinite = indefinite;
+	ctx->pst.blob_nl_pending = false;
+
+	ctx->pst.args[ctx->pst.arg_i].BLOB_LEN = indefinite ? SCPI_BLOB_INDEFINITE : len;
+
+	// Enter special blob mode, call handler (it may discard the blob)
+	ctx->pst.state = PARS_ARG_BLOB_BODY;
+	ctx->pst.blob_cnt = 0;
+	ctx->pst.chunk_pos = 0;
+
+	// decompressed length is not known
+	const SCPI_command_t *cmd = ctx->pst.matched_cmd;
+	ctx->pst.data_cnt = 0;
+	ctx->pst.data_len = (cmd->blob_codec != SCPI_CODEC_NONE) ? UINT32_MAX : len;
+
+	ctx->pst.dec_state = DEC_TOKEN;
+	ctx->pst.dec_held = false;
+	ctx->pst.dec_run = 0;
+	ctx->pst.dec_pend = 0;
+	ctx->pst.win_pos = 0;
+
+	// expected CRC is the previous argument (converted now with lazy_args)
+	ctx->pst.blob_crc = 0;
+	ctx->pst.blob_crc_expected = 0;
+
+	if (cmd->blob_crc == SCPI_CRC_CHECK && ctx->pst.arg_i > 0) {
+		if (scpi_arg_ok(ctx, ctx->pst.arg_i - 1)) {
+			ctx->pst.blob_crc_expected = (uint32_t) ctx->pst.args[ctx->pst.arg_i - 1].INT;
+		} else {
+			// the error is raised already - skip the command, as without lazy_args
+			ctx->pst.state = PARS_ARG_BLOB_DISCARD;
+		}
+	}
+
+	scpi_blob_set_buffers(ctx, cmd->blob_buf[0], cmd->blob_buf[1], cmd->blob_buf_len, cmd->blob_buf_callback);
+
+	if (ctx->pst.state == PARS_ARG_BLOB_BODY) {
+		run_command_callback(ctx); // may set the blob buffers
+	}
+
+	if (ctx->pst.state == PARS_ARG_BLOB_BODY && ctx->pst.sink_len == 0
+		&& cmd->blob_data_callback != NULL && cmd->blob_chunk > MAX_CHARBUF_LEN) {
+		// would be passed in parts when split between input buffers
+		scpi_add_error(ctx, E_DEV_SYSTEM_ERROR, "blob_chunk too large without blob buffers.");
+		scpi_discard_blob(ctx);
+	}
+
+#ifndef USE_BLOB_CODEC
+	if (cmd->blob_codec != SCPI_CODEC_NONE && ctx->pst.state == PARS_ARG_BLOB_BODY) {
+		scpi_add_error(ctx, E_CMD_BLOCK_DATA_NOT_ALLOWED, "Compressed block data not supported.");
+		scpi_discard_blob(ctx);
+	}
+#endif
+
+	if (!indefinite && len == 0) {
+		// empty block, no body follows
+		if (ctx->pst.state == PARS_ARG_BLOB_BODY) {
+			blob_end(ctx);
+		} else {
+			ctx->pst.state = PARS_DISCARD_LINE;
+		}
+	}
 }
 
 
-static void pars_blob_preamble_char(uint8_t c)
+static void pars_blob_preamble_char(scpi_ctx_t *ctx, uint8_t c)
 {
-	if (pst.blob_cnt == 0) {
+	if (ctx->pst.blob_cnt == 0) {
+		if (c == '0') {
+			// #0 - indefinite length, ends with newline + END
+			pars_blob_start(ctx, UINT32_MAX, true);
+			return;
+		}
+
 		if (!INRANGE(c, '1', '9')) {
-			sprintf(ebuf, "Unexpected '%c' in binary data preamble.", c);
-			scpi_add_error(E_CMD_BLOCK_DATA_ERROR, ebuf);
+			sprintf(ctx->pst.ebuf, "Unexpected '%c' in binary data preamble.", c);
+			scpi_add_error(ctx, E_CMD_BLOCK_DATA_ERROR, ctx->pst.ebuf);
 
-			pst.state = PARS_DISCARD_LINE;// (but not enough to remove the blob containing \n)
+			ctx->pst.state = PARS_DISCARD_LINE;// (but not enough to remove the blob containing \n)
 			return;
 		}
 
-		pst.blob_cnt = c - '0'; // 1-9
+		ctx->pst.blob_cnt = c - '0'; // 1-9
+		ctx->pst.blob_len = 0; // length accumulated from the digits
 	} else {
 		if (c == '\n') {
-			scpi_add_error(E_CMD_BLOCK_DATA_ERROR, "Unexpected newline in binary data preamble.");
+			scpi_add_error(ctx, E_CMD_BLOCK_DATA_ERROR, "Unexpected newline in binary data preamble.");
 
-			pars_reset_cmd();
+			pars_reset_cmd(ctx);
 			return;
 		}
 
 		if (!IS_NUMBER_CHAR(c)) {
-			sprintf(ebuf, "Unexpected '%c' in binary data preamble.", c);
-			scpi_add_error(E_CMD_BLOCK_DATA_ERROR, ebuf);
+			sprintf(ctx->pst.ebuf, "Unexpected '%c' in binary data preamble.", c);
+			scpi_add_error(ctx, E_CMD_BLOCK_DATA_ERROR, ctx->pst.ebuf);
 
-			pst.state = PARS_DISCARD_LINE;
+			ctx->pst.state = PARS_DISCARD_LINE;
 			return;
 		}
 
-		charbuf_append(c);
-		if (--pst.blob_cnt == 0) {
-			// end of preamble sequence
-			charbuf_terminate();
-
-			sscanf(pst.charbuf, "%" SCNu32, &pst.blob_len);
+		// at most 9 digits, does not overflow
+		ctx->pst.blob_len = ctx->pst.blob_len * 10 + (uint32_t)(c - '0');
 
-			pst.args[pst.arg_i].BLOB_LEN = pst.blob_len;
-			run_command_callback();
-
-			// Call handler, enter special blob mode
-			pst.state = PARS_ARG_BLOB_BODY;
-			pst.blob_cnt = 0;
+		if (--ctx->pst.blob_cnt == 0) {
+			// end of preamble sequence
+			pars_blob_start(ctx, ctx->pst.blob_len, false);
 		}
 	}
 }
@@ -6,37 +6,41 @@
 #include "scpi_regs.h"
 #include "scpi_errors.h"
 #include "scpi_parser.h"
+#include "scpi_ctx.h"
 
-SCPI_REG_QUES_t SCPI_REG_QUES;
-SCPI_REG_QUES_t SCPI_REG_QUES_EN = {.u16 = 0xFFFF};
+static const SCPI_regs_t regs_power_on = {
+	.QUES_EN = {.u16 = 0xFFFF},
+	.OPER_EN = {.u16 = 0xFFFF},
+	.SESR = {.POWER_ON = 1}, // indicates the startup condition
+};
 
-SCPI_REG_OPER_t SCPI_REG_OPER;
-SCPI_REG_OPER_t SCPI_REG_OPER_EN = {.u16 = 0xFFFF};
 
-SCPI_REG_SESR_t SCPI_REG_SESR = {.POWER_ON = 1}; // indicates the startup condition
-SCPI_REG_SESR_t SCPI_REG_SESR_EN;
+void scpi_regs_init(SCPI_regs_t *regs)
+{
+	*regs = regs_power_on;
+}
 
-SCPI_REG_STB_t SCPI_REG_STB;
-SCPI_REG_STB_t SCPI_REG_SRE;
 
 /** Update status registers (propagate using enable registers) */
-void scpi_status_update(void)
+void scpi_status_update(scpi_ctx_t *ctx)
 {
+	SCPI_regs_t *regs = &ctx->regs;
+
 	// propagate to STB
-	SCPI_REG_STB.ERRQ = scpi_error_count() > 0;
-	SCPI_REG_STB.QUES = SCPI_REG_QUES.u16 & SCPI_REG_QUES_EN.u16;
-	SCPI_REG_STB.OPER = SCPI_REG_OPER.u16 & SCPI_REG_OPER_EN.u16;
-	SCPI_REG_STB.SESR = SCPI_REG_SESR.u8 & SCPI_REG_SESR_EN.u8;
-	SCPI_REG_STB.MAV = false; // TODO!!!
+	regs->STB.ERRQ = scpi_error_count(ctx) > 0;
+	regs->STB.QUES = regs->QUES.u16 & regs->QUES_EN.u16;
+	regs->STB.OPER = regs->OPER.u16 & regs->OPER_EN.u16;
+	regs->STB.SESR = regs->SESR.u8 & regs->SESR_EN.u8;
+	regs->STB.MAV = false; // TODO!!!
 
 	// Request Service
-	SCPI_REG_STB.RQS = SCPI_REG_STB.u8 & SCPI_REG_SRE.u8;
+	regs->STB.RQS = regs->STB.u8 & regs->SRE.u8;
 
 
 	// Run service request callback
-	if (SCPI_REG_STB.RQS) {
+	if (regs->STB.RQS) {
 		if (scpi_user_SRQ) {
-			scpi_user_SRQ();
+			scpi_user_SRQ(ctx);
 		}
 	}
 }
@@ -0,0 +1,744 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "scpi_resp.h"
+#include "scpi_parser.h"
+#include "scpi_ctx.h"
+
+
+/**
+ * Format a number into the end of a buffer.
+ *
+ * @param end pointer past the last digit
+ * @returns pointer to the first digit
+ */
+static char *fmt_uint(char *end, uint32_t value)
+{
+	do {
+		*--end = (char)('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	return end;
+}
+
+
+void scpi_resp_uint(scpi_ctx_t *ctx, uint32_t value)
+{
+	char buf[10];
+	char *end = buf + sizeof(buf);
+	char *p = fmt_uint(end, value);
+
+	scpi_send_buf(ctx, (const uint8_t *) p, (size_t)(end - p));
+}
+
+
+void scpi_resp_int(scpi_ctx_t *ctx, int32_t value)
+{
+	char buf[11];
+	char *end = buf + sizeof(buf);
+	// negate as unsigned, INT32_MIN has no positive counterpart
+	char *p = fmt_uint(end, (value < 0) ? -(uint32_t)value : (uint32_t)value);
+
+	if (value < 0) *--p = '-';
+
+	scpi_send_buf(ctx, (const uint8_t *) p, (size_t)(end - p));
+}
+
+
+void scpi_resp_int64(scpi_ctx_t *ctx, int64_t value)
+{
+	char buf[20];
+	char *p = buf + sizeof(buf);
+	uint64_t v = (value < 0) ? -(uint64_t)value : (uint64_t)value;
+
+	do {
+		*--p = (char)('0' + v % 10);
+		v /= 10;
+	} while (v > 0);
+
+	if (value < 0) *--p = '-';
+
+	scpi_send_buf(ctx, (const uint8_t *) p, (size_t)(buf + sizeof(buf) - p));
+}
+
+
+void scpi_resp_hex(scpi_ctx_t *ctx, uint32_t value)
+{
+	static const char digits[] = "0123456789ABCDEF";
+
+	char buf[10];
+	char *end = buf + sizeof(buf);
+	char *p = end;
+
+	do {
+		*--p = digits[value & 0xF];
+		value >>= 4;
+	} while (value > 0);
+
+	*--p = 'H';
+	*--p = '#';
+
+	scpi_send_buf(ctx, (const uint8_t *) p, (size_t)(end - p));
+}
+
+
+void scpi_resp_fixed(scpi_ctx_t *ctx, int32_t value, uint8_t format)
+{
+	char buf[11 + 1 + 31]; // sign, integer part, point, up to 31 fraction digits
+	const uint32_t mag = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+
+	uint32_t ip, frac;
+	char *f = buf + 12; // fraction digits
+	char *fend = f;
+
+	if (format & 0x80) {
+		static const uint32_t pow10[] = {
+			1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL
+		};
+
+		const uint8_t digits = format & 0x7F;
+		ip = mag / pow10[digits];
+		frac = mag % pow10[digits];
+
+		for (uint32_t p = pow10[digits] / 10; p > 0; p /= 10) {
+			*fend++ = (char)('0' + frac / p);
+			frac %= p;
+		}
+	} else {
+		// 2^-q has q decimal digits, so the fraction is exact
+		const uint8_t q = format;
+		ip = (uint32_t)((uint64_t) mag >> q);
+		uint64_t r = mag & ((1ULL << q) - 1);
+
+		while (r != 0) {
+			r *= 10;
+			*fend++ = (char)('0' + (r >> q));
+			r &= (1ULL << q) - 1;
+		}
+
+		if (q > 0 && fend == f) *fend++ = '0';
+	}
+
+	// keep one fraction digit (2.0)
+	while (fend > f + 1 && fend[-1] == '0') fend--;
+
+	char *p = fmt_uint(buf + 11, ip);
+	if (value < 0) *--p = '-';
+
+	if (fend > f) {
+		buf[11] = '.';
+	} else {
+		fend = buf + 11;
+	}
+
+	scpi_send_buf(ctx, (const uint8_t *) p, (size_t)(fend - p));
+}
+
+
+void scpi_resp_string_quoted(scpi_ctx_t *ctx, const char *str)
+{
+	scpi_send_buf(ctx, (const uint8_t *) "\"", 1);
+
+	while (*str != 0) {
+		// send up to and including the next quote, then double it
+		const char *q = strchr(str, '"');
+		if (q == NULL) {
+			scpi_send_string_raw(ctx, str);
+			break;
+		}
+
+		scpi_send_buf(ctx, (const uint8_t *) str, (size_t)(q - str + 1));
+		scpi_send_buf(ctx, (const uint8_t *) "\"", 1);
+		str = q + 1;
+	}
+
+	scpi_send_buf(ctx, (const uint8_t *) "\"", 1);
+}
+
+
+void scpi_resp_sep(scpi_ctx_t *ctx)
+{
+	scpi_send_buf(ctx, (const uint8_t *) ",", 1);
+}
+
+
+void scpi_resp_end(scpi_ctx_t *ctx)
+{
+	scpi_send_string_raw(ctx, scpi_eol);
+	scpi_send_flush(ctx);
+}
+
+
+// ---- floating point ----
+//
+// Shortest representation with Grisu2 (F. Loitsch, "Printing Floating-Point Numbers
+// Quickly and Accurately with Integers", 2010). The digits always read back as the same
+// value; in rare cases (well under 1 %) they are one digit longer than the shortest.
+
+/** Floating point number f * 2^e with a 64-bit significand */
+typedef struct {
+	uint64_t f;
+	int e;
+} diy_fp_t;
+
+/** 10^k normalized, k = -348, -340, ..., 340 (rounded) */
+static const diy_fp_t cached_powers[] = {
+	{0xFA8FD5A0081C0288, -1220}, {0xBAAEE17FA23EBF76, -1193},
+	{0x8B16FB203055AC76, -1166}, {0xCF42894A5DCE35EA, -1140},
+	{0x9A6BB0AA55653B2D, -1113}, {0xE61ACF033D1A45DF, -1087},
+	{0xAB70FE17C79AC6CA, -1060}, {0xFF77B1FCBEBCDC4F, -1034},
+	{0xBE5691EF416BD60C, -1007}, {0x8DD01FAD907FFC3C, -980},
+	{0xD3515C2831559A83, -954}, {0x9D71AC8FADA6C9B5, -927},
+	{0xEA9C227723EE8BCB, -901}, {0xAECC49914078536D, -874},
+	{0x823C12795DB6CE57, -847}, {0xC21094364DFB5637, -821},
+	{0x9096EA6F3848984F, -794}, {0xD77485CB25823AC7, -768},
+	{0xA086CFCD97BF97F4, -741}, {0xEF340A98172AACE5, -715},
+	{0xB23867FB2A35B28E, -688}, {0x84C8D4DFD2C63F3B, -661},
+	{0xC5DD44271AD3CDBA, -635}, {0x936B9FCEBB25C996, -608},
+	{0xDBAC6C247D62A584, -582}, {0xA3AB66580D5FDAF6, -555},
+	{0xF3E2F893DEC3F126, -529}, {0xB5B5ADA8AAFF80B8, -502},
+	{0x87625F056C7C4A8B, -475}, {0xC9BCFF6034C13053, -449},
+	{0x964E858C91BA2655, -422}, {0xDFF9772470297EBD, -396},
+	{0xA6DFBD9FB8E5B88F, -369}, {0xF8A95FCF88747D94, -343},
+	{0xB94470938FA89BCF, -316}, {0x8A08F0F8BF0F156B, -289},
+	{0xCDB02555653131B6, -263}, {0x993FE2C6D07B7FAC, -236},
+	{0xE45C10C42A2B3B06, -210}, {0xAA242499697392D3, -183},
+	{0xFD87B5F28300CA0E, -157}, {0xBCE5086492111AEB, -130},
+	{0x8CBCCC096F5088CC, -103}, {0xD1B71758E219652C, -77},
+	{0x9C40000000000000, -50}, {0xE8D4A51000000000, -24},
+	{0xAD78EBC5AC620000, 3}, {0x813F3978F8940984, 30},
+	{0xC097CE7BC90715B3, 56}, {0x8F7E32CE7BEA5C70, 83},
+	{0xD5D238A4ABE98068, 109}, {0x9F4F2726179A2245, 136},
+	{0xED63A231D4C4FB27, 162}, {0xB0DE65388CC8ADA8, 189},
+	{0x83C7088E1AAB65DB, 216}, {0xC45D1DF942711D9A, 242},
+	{0x924D692CA61BE758, 269}, {0xDA01EE641A708DEA, 295},
+	{0xA26DA3999AEF774A, 322}, {0xF209787BB47D6B85, 348},
+	{0xB454E4A179DD1877, 375}, {0x865B86925B9BC5C2, 402},
+	{0xC83553C5C8965D3D, 428}, {0x952AB45CFA97A0B3, 455},
+	{0xDE469FBD99A05FE3, 481}, {0xA59BC234DB398C25, 508},
+	{0xF6C69A72A3989F5C, 534}, {0xB7DCBF5354E9BECE, 561},
+	{0x88FCF317F22241E2, 588}, {0xCC20CE9BD35C78A5, 614},
+	{0x98165AF37B2153DF, 641}, {0xE2A0B5DC971F303A, 667},
+	{0xA8D9D1535CE3B396, 694}, {0xFB9B7CD9A4A7443C, 720},
+	{0xBB764C4CA7A44410, 747}, {0x8BAB8EEFB6409C1A, 774},
+	{0xD01FEF10A657842C, 800}, {0x9B10A4E5E9913129, 827},
+	{0xE7109BFBA19C0C9D, 853}, {0xAC2820D9623BF429, 880},
+	{0x80444B5E7AA7CF85, 907}, {0xBF21E44003ACDD2D, 933},
+	{0x8E679C2F5E44FF8F, 960}, {0xD433179D9C8CB841, 986},
+	{0x9E19DB92B4E31BA9, 1013}, {0xEB96BF6EBADF77D9, 1039},
+	{0xAF87023B9BF0EE6B, 1066},
+};
+
+#define CACHED_POWERS_K0 (-348)
+#define CACHED_POWERS_STEP 8
+
+static const uint32_t pow10_u32[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+
+static diy_fp_t fp_mul(diy_fp_t x, diy_fp_t y)
+{
+	const uint64_t M32 = 0xFFFFFFFF;
+	const uint64_t a = x.f >> 32, b = x.f & M32;
+	const uint64_t c = y.f >> 32, d = y.f & M32;
+	const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+
+	uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+	tmp += 1U << 31; // round
+
+	return (diy_fp_t) {ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+}
+
+
+static diy_fp_t fp_normalize(diy_fp_t x)
+{
+	while ((x.f & (1ULL << 63)) == 0) {
+		x.f <<= 1;
+		x.e--;
+	}
+
+	return x;
+}
+
+
+/** Cached power c = 10^-K such that the exponent of (w * c) is in -60..-32 */
+static diy_fp_t cached_power(int e, int *K)
+{
+	// k = ceil((-61 - e) * log10(2)) + 347, with log10(2) in 0.32 fixed point
+	const int64_t t = (int64_t)(-61 - e) * 1292913986;
+	const int k = (int)(-((-t) >> 32)) + 347;
+	const unsigned index = (unsigned)(k / CACHED_POWERS_STEP) + 1;
+
+	*K = -(CACHED_POWERS_K0 + (int)index * CACHED_POWERS_STEP);
+	return cached_powers[index];
+}
+
+
+static void grisu_round(char *buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+	while (rest < wp_w && delta - rest >= ten_kappa
+		   && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+		buf[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+
+/** Generate the digits of W, as few as possible within the boundaries (Mp - delta .. Mp) */
+static int digit_gen(diy_fp_t W, diy_fp_t Mp, uint64_t delta, char *buf, int *K)
+{
+	const int shift = -Mp.e;
+	const uint64_t one = 1ULL << shift;
+	const uint64_t wp_w = Mp.f - W.f;
+
+	uint32_t p1 = (uint32_t)(Mp.f >> shift);
+	uint64_t p2 = Mp.f & (one - 1);
+	int len = 0;
+
+	int kappa = 1;
+	while (kappa < 10 && p1 >= pow10_u32[kappa]) kappa++;
+
+	while (kappa > 0) {
+		const uint32_t d = p1 / pow10_u32[kappa - 1];
+		p1 %= pow10_u32[kappa - 1];
+
+		if (d || len) buf[len++] = (char)('0' + d);
+		kappa--;
+
+		const uint64_t rest = ((uint64_t)p1 << shift) + p2;
+		if (rest <= delta) {
+			*K += kappa;
+			grisu_round(buf, len, delta, rest, (uint64_t)pow10_u32[kappa] << shift, wp_w);
+			return len;
+		}
+	}
+
+	while (true) {
+		p2 *= 10;
+		delta *= 10;
+
+		const char d = (char)(p2 >> shift);
+		if (d || len) buf[len++] = (char)('0' + d);
+		p2 &= one - 1;
+		kappa--;
+
+		if (p2 < delta) {
+			*K += kappa;
+			grisu_round(buf, len, delta, p2, one, wp_w * ((-kappa < 10) ? pow10_u32[-kappa] : 0));
+			return len;
+		}
+	}
+}
+
+
+/**
+ * Shortest digits of a positive number f * 2^e.
+ *
+ * @param hidden hidden bit of the source format (its precision)
+ * @returns number of digits, value = digits * 10^K
+ */
+static int grisu2(uint64_t f, int e, uint64_t hidden, char *buf, int *K)
+{
+	// boundaries - halfway to the neighbouring values
+	diy_fp_t mp = fp_normalize((diy_fp_t) {(f << 1) + 1, e - 1});
+	diy_fp_t mm = (f == hidden) ? (diy_fp_t) {(f << 2) - 1, e - 2} : (diy_fp_t) {(f << 1) - 1, e - 1};
+	mm.f <<= mm.e - mp.e;
+	mm.e = mp.e;
+
+	const diy_fp_t c = cached_power(mp.e, K);
+	const diy_fp_t W = fp_mul(fp_normalize((diy_fp_t) {f, e}), c);
+	diy_fp_t Wp = fp_mul(mp, c);
+	diy_fp_t Wm = fp_mul(mm, c);
+	Wm.f++;
+	Wp.f--;
+
+	return digit_gen(W, Wp, Wp.f - Wm.f, buf, K);
+}
+
+
+/**
+ * Round the counted digits, if the product error (unit) allows to tell the direction.
+ * Ties and values too close to one return false.
+ */
+static bool round_weed_counted(char *buf, int len, uint64_t rest, uint64_t ten_kappa, uint64_t unit, int *kappa)
+{
+	if (unit >= ten_kappa || ten_kappa - unit <= unit) return false;
+
+	// rest + unit below a half - round down
+	if (ten_kappa - rest > rest && ten_kappa - 2 * rest >= 2 * unit) return true;
+
+	// rest - unit above a half - round up
+	if (rest > unit && ten_kappa - (rest - unit) <= rest - unit) {
+		int i = len - 1;
+		while (i >= 0 && buf[i] == '9') {
+			buf[i--] = '0';
+		}
+
+		if (i < 0) {
+			buf[0] = '1'; // 9.99 -> 10.0
+			(*kappa)++;
+		} else {
+			buf[i]++;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+
+/** Generate a number of digits of W (error 1 unit), false if they can't be rounded for sure */
+static bool digit_gen_counted(diy_fp_t W, int digits, char *buf, int *kappa)
+{
+	const int shift = -W.e;
+	const uint64_t one = 1ULL << shift;
+	uint64_t unit = 1;
+
+	uint32_t p1 = (uint32_t)(W.f >> shift);
+	uint64_t p2 = W.f & (one - 1);
+	int len = 0;
+
+	*kappa = 1;
+	while (*kappa < 10 && p1 >= pow10_u32[*kappa]) (*kappa)++;
+
+	while (*kappa > 0) {
+		const uint32_t div = pow10_u32[*kappa - 1];
+		buf[len++] = (char)('0' + p1 / div);
+		p1 %= div;
+		(*kappa)--;
+
+		if (len == digits) {
+			return round_weed_counted(buf, len, ((uint64_t) p1 << shift) + p2, (uint64_t) div << shift, unit, kappa);
+		}
+	}
+
+	while (len < digits && p2 > unit) {
+		p2 *= 10;
+		unit *= 10;
+		buf[len++] = (char)('0' + (p2 >> shift));
+		p2 &= one - 1;
+		(*kappa)--;
+	}
+
+	if (len < digits) return false;
+
+	return round_weed_counted(buf, len, p2, one, unit, kappa);
+}
+
+
+// Big integers for the fixed digit count when the 64-bit product is not enough to round
+// the last digit (near a tie, eg. 9.995 is 9.99499.. as a double).
+
+#define BIG_WORDS 40 // largest: 2^53 * 10^324 (smallest subnormal, scaled)
+
+typedef struct {
+	uint32_t w[BIG_WORDS]; // least significant first
+	int n; // words used, the top one is not zero
+} big_t;
+
+
+static void big_set(big_t *b, uint64_t v)
+{
+	b->w[0] = (uint32_t) v;
+	b->w[1] = (uint32_t)(v >> 32);
+	b->n = (b->w[1] != 0) ? 2 : (b->w[0] != 0);
+}
+
+
+static void big_mul_small(big_t *b, uint32_t m)
+{
+	uint64_t carry = 0;
+
+	for (int i = 0; i < b->n; i++) {
+		carry += (uint64_t) b->w[i] * m;
+		b->w[i] = (uint32_t) carry;
+		carry >>= 32;
+	}
+
+	if (carry) b->w[b->n++] = (uint32_t) carry;
+}
+
+
+static void big_mul_pow10(big_t *b, int k)
+{
+	for (; k >= 9; k -= 9) {
+		big_mul_small(b, pow10_u32[9]);
+	}
+
+	if (k > 0) big_mul_small(b, pow10_u32[k]);
+}
+
+
+static void big_shl(big_t *b, int bits)
+{
+	const int words = bits / 32;
+	bits %= 32;
+
+	if (b->n == 0) return;
+
+	const uint32_t top = bits ? (b->w[b->n - 1] >> (32 - bits)) : 0;
+
+	for (int i = b->n - 1; i >= 0; i--) {
+		uint32_t v = b->w[i] << bits;
+		if (bits && i > 0) v |= b->w[i - 1] >> (32 - bits);
+		b->w[i + words] = v;
+	}
+
+	for (int i = 0; i < words; i++) {
+		b->w[i] = 0;
+	}
+
+	b->n += words;
+	if (top) b->w[b->n++] = top;
+}
+
+
+static int big_cmp(const big_t *a, const big_t *b)
+{
+	if (a->n != b->n) return (a->n > b->n) ? 1 : -1;
+
+	for (int i = a->n - 1; i >= 0; i--) {
+		if (a->w[i] != b->w[i]) return (a->w[i] > b->w[i]) ? 1 : -1;
+	}
+
+	return 0;
+}
+
+
+/** a -= b, a must not be smaller */
+static void big_sub(big_t *a, const big_t *b)
+{
+	uint64_t borrow = 0;
+
+	for (int i = 0; i < a->n; i++) {
+		const uint64_t d = (uint64_t) a->w[i] - ((i < b->n) ? b->w[i] : 0) - borrow;
+		a->w[i] = (uint32_t) d;
+		borrow = (d >> 32) & 1;
+	}
+
+	while (a->n > 0 && a->w[a->n - 1] == 0) a->n--;
+}
+
+
+/** Exact fixed digit count, see digits_fixed() */
+static int digits_fixed_big(uint64_t f, int e, int digits, char *buf, int *exp10)
+{
+	big_t r, s; // value = r / s
+	big_set(&r, f);
+	big_set(&s, 1);
+
+	if (e >= 0) {
+		big_shl(&r, e);
+	} else {
+		big_shl(&s, -e);
+	}
+
+	// k = floor(log10(value)), estimated from the top bit and corrected below
+	int top = 63;
+	while (!(f >> top)) top--;
+	int k = (int)(((int64_t)(e + top) * 1292913986) >> 32);
+
+	if (k >= 0) {
+		big_mul_pow10(&s, k);
+	} else {
+		big_mul_pow10(&r, -k);
+	}
+
+	// scale so that 1 <= r / s < 10
+	big_t s10 = s;
+	big_mul_small(&s10, 10);
+	if (big_cmp(&r, &s10) >= 0) {
+		s = s10;
+		k++;
+	} else if (big_cmp(&r, &s) < 0) {
+		big_mul_small(&r, 10);
+		k--;
+	}
+
+	for (int i = 0; i < digits; i++) {
+		char d = '0';
+		while (big_cmp(&r, &s) >= 0) {
+			big_sub(&r, &s);
+			d++;
+		}
+		buf[i] = d;
+
+		if (i + 1 < digits) big_mul_small(&r, 10);
+	}
+
+	// compare the rest with a half of the last digit
+	big_shl(&r, 1);
+	const int half = big_cmp(&r, &s);
+
+	if (half > 0 || (half == 0 && (buf[digits - 1] & 1))) {
+		int i = digits - 1;
+		while (i >= 0 && buf[i] == '9') {
+			buf[i--] = '0';
+		}
+
+		if (i < 0) {
+			buf[0] = '1'; // 9.99 -> 10.0
+			k++;
+		} else {
+			buf[i]++;
+		}
+	}
+
+	*exp10 = k;
+	return digits;
+}
+
+
+/**
+ * A number of significant digits of a positive number f * 2^e, correctly rounded
+ * (half to even, like printf).
+ *
+ * @returns number of digits (= digits), value = d.ddd * 10^exp10
+ */
+static int digits_fixed(uint64_t f, int e, int digits, char *buf, int *exp10)
+{
+	const diy_fp_t w = fp_normalize((diy_fp_t) {f, e});
+	int K, kappa;
+	const diy_fp_t c = cached_power(w.e, &K);
+
+	if (digit_gen_counted(fp_mul(w, c), digits, buf, &kappa)) {
+		*exp10 = K + kappa + digits - 1;
+		return digits;
+	}
+
+	return digits_fixed_big(f, e, digits, buf, exp10);
+}
+
+
+/** Send digits in the NR3 format, d.dddE+XX */
+static void resp_nr3(scpi_ctx_t *ctx, bool negative, char *digits, int len, int exp10)
+{
+	char buf[40];
+	char *p = buf;
+
+	const int prec = ctx->resp_digits; // digits are generated for it already
+
+	if (negative) *p++ = '-';
+
+	*p++ = digits[0];
+	*p++ = '.';
+
+	if (len > 1) {
+		memcpy(p, digits + 1, (size_t)(len - 1));
+		p += len - 1;
+	}
+
+	// pad to the number of digits (at least one after the point)
+	const int shown = (prec > len) ? prec : ((len > 1) ? len : 2);
+	for (int i = len; i < shown; i++) {
+		*p++ = '0';
+	}
+
+	*p++ = 'E';
+	*p++ = (exp10 < 0) ? '-' : '+';
+
+	// at least two digits
+	const uint32_t ex = (uint32_t)((exp10 < 0) ? -exp10 : exp10);
+	if (ex < 10) *p++ = '0';
+
+	char *end = p + ((ex >= 100) ? 3 : (ex >= 10) ? 2 : 1);
+	fmt_uint(end, ex);
+
+	scpi_send_buf(ctx, (const uint8_t *) buf, (size_t)(end - buf));
+}
+
+
+/** Send a special value, returns true if it was one */
+static bool resp_special(scpi_ctx_t *ctx, bool negative, bool inf, bool nan, bool zero)
+{
+	if (nan) {
+		scpi_send_string_raw(ctx, "9.91E+37"); // SCPI NaN
+	} else if (inf) {
+		scpi_send_string_raw(ctx, negative ? "-9.9E+37" : "9.9E+37"); // SCPI (N)INFinity
+	} else if (zero) {
+		char digits[1] = {'0'};
+		resp_nr3(ctx, false, digits, 1, 0);
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+/** Send a positive number f * 2^e (with a sign), shortest or with the set number of digits */
+static void resp_digits(scpi_ctx_t *ctx, bool negative, uint64_t f, int e, uint64_t hidden)
+{
+	char digits[20];
+	int len, exp10;
+
+	if (ctx->resp_digits > 0) {
+		len = digits_fixed(f, e, ctx->resp_digits, digits, &exp10);
+	} else {
+		int K;
+		len = grisu2(f, e, hidden, digits, &K);
+		exp10 = len + K - 1;
+	}
+
+	resp_nr3(ctx, negative, digits, len, exp10);
+}
+
+
+void scpi_resp_double(scpi_ctx_t *ctx, double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	const bool negative = (bits >> 63) != 0;
+	const int biased_e = (int)((bits >> 52) & 0x7FF);
+	const uint64_t hidden = 1ULL << 52;
+	uint64_t f = bits & (hidden - 1);
+
+	if (resp_special(ctx, negative, biased_e == 0x7FF && f == 0, biased_e == 0x7FF && f != 0,
+					 biased_e == 0 && f == 0)) return;
+
+	int e;
+	if (biased_e != 0) {
+		f |= hidden;
+		e = biased_e - 1075;
+	} else {
+		e = -1074; // subnormal
+	}
+
+	resp_digits(ctx, negative, f, e, hidden);
+}
+
+
+void scpi_resp_float(scpi_ctx_t *ctx, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	const bool negative = (bits >> 31) != 0;
+	const int biased_e = (int)((bits >> 23) & 0xFF);
+	const uint32_t hidden = 1UL << 23;
+	uint32_t f = bits & (hidden - 1);
+
+	if (resp_special(ctx, negative, biased_e == 0xFF && f == 0, biased_e == 0xFF && f != 0,
+					 biased_e == 0 && f == 0)) return;
+
+	int e;
+	if (biased_e != 0) {
+		f |= hidden;
+		e = biased_e - 150;
+	} else {
+		e = -149; // subnormal
+	}
+
+	// same algorithm, with the boundaries of a float
+	resp_digits(ctx, negative, f, e, hidden);
+}
+
+
+void scpi_resp_set_digits(scpi_ctx_t *ctx, uint8_t digits)
+{
+	ctx->resp_digits = (digits > 17) ? 17 : digits;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "scpi.h"
+
+// Host test helpers - input fed to scpi_handle_buffer() in pieces, checks counted.
+// Each test is one .c file including this header, main() returns test_done().
+
+static int test_checks;
+static int test_fails;
+static const char *test_case = "";
+
+#define CHECK(cond) test_check((cond), #cond, __LINE__)
+
+#define CHECK_EQ(a, b) do { \
+		const long long a_ = (long long)(a), b_ = (long long)(b); \
+		if (!test_check(a_ == b_, #a " == " #b, __LINE__)) { \
+			printf("      %lld != %lld\n", a_, b_); \
+		} \
+	} while (0)
+
+
+static bool test_check(bool ok, const char *what, int line)
+{
+	test_checks++;
+
+	if (!ok) {
+		test_fails++;
+		printf("FAIL  %s: line %d: %s\n", test_case, line, what);
+	}
+
+	return ok;
+}
+
+
+static int test_done(const char *name)
+{
+	printf("%-10s %d checks, %d failed\n", name, test_checks, test_fails);
+	return test_fails != 0;
+}
+
+
+// ---- library stubs ----
+
+const char *scpi_eol = "\n";
+
+const SCPI_error_desc scpi_user_errors[] = {
+	{0}
+};
+
+const char *scpi_user_IDN(scpi_ctx_t *ctx)
+{
+	(void)ctx;
+	return "TEST,HOST,0,0";
+}
+
+/** Responses sent, NUL terminated */
+static char test_out[4096];
+static size_t test_out_len;
+
+void scpi_send_buf_impl(scpi_ctx_t *ctx, const uint8_t *buf, size_t len)
+{
+	(void)ctx;
+
+	if (test_out_len + len < sizeof(test_out)) {
+		memcpy(&test_out[test_out_len], buf, len);
+		test_out_len += len;
+		test_out[test_out_len] = 0;
+	}
+}
+
+
+/** Clear the responses */
+static void test_out_reset(void)
+{
+	test_out_len = 0;
+	test_out[0] = 0;
+}
+
+
+// ---- input ----
+
+/** Called when the parser stops taking input (blob buffers full) - must release a buffer */
+static void (*test_on_stall)(scpi_ctx_t *ctx);
+
+
+/** Pass data to the parser in pieces of 'chunk' bytes, the way it would arrive from an interface */
+static void test_feed(scpi_ctx_t *ctx, const void *data, size_t len, size_t chunk)
+{
+	const uint8_t *p = data;
+	int stalls = 0;
+
+	while (len > 0) {
+		const size_t n = (len < chunk) ? len : chunk;
+		const size_t used = scpi_handle_buffer(ctx, p, n);
+
+		if (used == 0) {
+			if (test_on_stall == NULL || ++stalls > 100000) {
+				test_check(false, "parser stalled", __LINE__);
+				return;
+			}
+			test_on_stall(ctx);
+		} else {
+			stalls = 0;
+		}
+
+		p += used;
+		len -= used;
+	}
+}
+
+
+/** Pass a string in two pieces, split at 'at' */
+static void test_feed_split(scpi_ctx_t *ctx, const void *data, size_t len, size_t at)
+{
+	test_feed(ctx, data, at, at ? at : 1);
+	test_feed(ctx, (const uint8_t *) data + at, len - at, len);
+}
+
+
+/** Take all errors from the queue, returns the first one (0 = none) */
+static int16_t test_errors(scpi_ctx_t *ctx)
+{
+	int16_t first = 0;
+
+	while (scpi_error_count(ctx) > 0) {
+		const int16_t code = scpi_read_error_code(ctx);
+		if (first == 0) first = code;
+	}
+
+	return first;
+}
@@ -0,0 +1,184 @@
+#include "test.h"
+
+// Argument storage - the longest values of every argument of a command fit in the arena,
+// typed accessors.
+
+static scpi_ctx_t session;
+
+static bool called;
+static char text[SCPI_MAX_PARAM_COUNT][SCPI_MAX_STRING_LEN + 1];
+static uint16_t chans[SCPI_MAX_PARAM_COUNT];
+static SCPI_chanrange_t last_range[SCPI_MAX_PARAM_COUNT];
+
+
+static void text_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	called = true;
+
+	for (uint8_t i = 0; i < SCPI_MAX_PARAM_COUNT; i++) {
+		const char *s = scpi_arg_string(ctx, i);
+		CHECK(s != NULL);
+		if (s == NULL) continue;
+
+		CHECK(s == args[i].STRING);
+		CHECK_EQ(scpi_arg_len(ctx, i), strlen(s));
+		strcpy(text[i], s);
+	}
+}
+
+
+static void chan_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	called = true;
+
+	for (uint8_t i = 0; i < SCPI_MAX_PARAM_COUNT; i++) {
+		const SCPI_chanrange_t *ranges;
+		chans[i] = scpi_arg_chanlist(ctx, i, &ranges);
+
+		CHECK(ranges == args[i].CHANLIST.ranges);
+		if (chans[i] > 0) last_range[i] = ranges[chans[i] - 1];
+	}
+}
+
+
+static void mix_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)args;
+	called = true;
+
+	strcpy(text[0], scpi_arg_string(ctx, 0));
+	chans[1] = scpi_arg_chanlist(ctx, 1, NULL);
+	strcpy(text[2], scpi_arg_string(ctx, 2));
+	CHECK_EQ(scpi_arg_int(ctx, 3), -7);
+
+	// wrong type or index
+	CHECK_EQ(scpi_arg_int(ctx, 0), 0);
+	CHECK_EQ(scpi_arg_chanlist(ctx, 0, NULL), 0);
+	CHECK(strcmp(scpi_arg_string(ctx, 3), "") == 0);
+	CHECK(strcmp(scpi_arg_string(ctx, SCPI_MAX_PARAM_COUNT), "") == 0);
+}
+
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"TEXT"},
+		.params = {SCPI_DT_STRING, SCPI_DT_STRING, SCPI_DT_CHARDATA, SCPI_DT_STRING},
+		.callback = text_cb,
+	},
+	{
+		.levels = {"CHANnels"},
+		.params = {SCPI_DT_CHANLIST, SCPI_DT_CHANLIST, SCPI_DT_CHANLIST, SCPI_DT_CHANLIST},
+		.callback = chan_cb,
+	},
+	{
+		.levels = {"MIX"},
+		.params = {SCPI_DT_STRING, SCPI_DT_CHANLIST, SCPI_DT_CHARDATA, SCPI_DT_INT},
+		.callback = mix_cb,
+	},
+	{/*END*/}
+};
+
+
+static char msg[1024];
+static char longest[SCPI_MAX_PARAM_COUNT][SCPI_MAX_STRING_LEN + 1];
+
+
+static void run(void)
+{
+	called = false;
+	memset(text, 0, sizeof(text));
+	memset(chans, 0, sizeof(chans));
+	test_feed(&session, msg, strlen(msg), 7);
+}
+
+
+/** Every argument as long as it may be */
+static void test_longest(void)
+{
+	test_case = "longest strings";
+
+	for (int i = 0; i < SCPI_MAX_PARAM_COUNT; i++) {
+		for (int j = 0; j < SCPI_MAX_STRING_LEN; j++) {
+			longest[i][j] = (char)('A' + (i * 7 + j) % 26);
+		}
+	}
+
+	sprintf(msg, "TEXT \"%s\",'%s',%s,\"%s\"\n", longest[0], longest[1], longest[2], longest[3]);
+	run();
+
+	CHECK(called);
+	for (int i = 0; i < SCPI_MAX_PARAM_COUNT; i++) {
+		CHECK(strcmp(text[i], longest[i]) == 0);
+	}
+	CHECK_EQ(test_errors(&session), 0);
+
+	// a string over the limit is still refused (the input buffer overflows)
+	sprintf(msg, "TEXT \"%sX\",'a',b,'c'\n", longest[0]);
+	run();
+	CHECK(!called);
+	CHECK(test_errors(&session) != 0);
+
+	test_case = "full channel lists";
+
+	char *p = msg + sprintf(msg, "CHAN ");
+	for (int i = 0; i < SCPI_MAX_PARAM_COUNT; i++) {
+		p += sprintf(p, "%s(@", i ? "," : "");
+		for (int r = 0; r < SCPI_MAX_CHAN_RANGES; r++) {
+			p += sprintf(p, "%s%d!%d:%d", r ? "," : "", i, r * 10, r * 10 + 5);
+		}
+		p += sprintf(p, ")");
+	}
+	sprintf(p, "\n");
+	run();
+
+	CHECK(called);
+	for (int i = 0; i < SCPI_MAX_PARAM_COUNT; i++) {
+		CHECK_EQ(chans[i], SCPI_MAX_CHAN_RANGES);
+		CHECK_EQ(last_range[i].first, SCPI_CHAN(i, (SCPI_MAX_CHAN_RANGES - 1) * 10));
+		CHECK_EQ(last_range[i].last, SCPI_CHAN(i, (SCPI_MAX_CHAN_RANGES - 1) * 10 + 5));
+	}
+	CHECK_EQ(test_errors(&session), 0);
+
+	test_case = "mixed";
+
+	sprintf(msg, "MIX '%s',(@1:8,10,12,14,16,18,20,22),%s,-7\n", longest[1], longest[2]);
+	run();
+
+	CHECK(called);
+	CHECK(strcmp(text[0], longest[1]) == 0);
+	CHECK_EQ(chans[1], SCPI_MAX_CHAN_RANGES);
+	CHECK(strcmp(text[2], longest[2]) == 0);
+	CHECK_EQ(test_errors(&session), 0);
+}
+
+
+/** The arena is reused - many commands in one message */
+static void test_reuse(void)
+{
+	test_case = "reuse";
+
+	char *p = msg;
+	for (int i = 0; i < 6; i++) {
+		p += sprintf(p, "%sTEXT '%s','%d',x,'%s'", i ? ";:" : "", longest[i % 4], i, longest[(i + 1) % 4]);
+	}
+	sprintf(p, "\n");
+	run();
+
+	CHECK(called);
+	CHECK(strcmp(text[0], longest[1]) == 0);
+	CHECK(strcmp(text[1], "5") == 0);
+	CHECK(strcmp(text[3], longest[2]) == 0);
+	CHECK_EQ(test_errors(&session), 0);
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	test_longest();
+	test_reuse();
+
+	return test_done("args");
+}
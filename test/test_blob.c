@@ -0,0 +1,405 @@
+#include <stdlib.h>
+
+#include "test.h"
+
+// Compressed block data (SCPI_CODEC_RLE, SCPI_CODEC_LZ4), received in pieces.
+// Built with SCPI_BLOB_WINDOW=1024.
+
+#define DATA_LEN 3000
+#define WINDOW SCPI_BLOB_WINDOW
+
+static scpi_ctx_t session;
+
+static uint8_t got[DATA_LEN * 2];
+static size_t got_len;
+static bool ended;
+static uint32_t end_len;
+
+static uint8_t bbuf0[16], bbuf1[16];
+static uint8_t *held[2];
+
+
+static void data_cb(scpi_ctx_t *ctx, const uint8_t *data, size_t len, uint32_t offset)
+{
+	(void)ctx;
+	CHECK_EQ(offset, got_len);
+
+	if (got_len + len <= sizeof(got)) {
+		memcpy(&got[got_len], data, len);
+	}
+	got_len += len;
+}
+
+
+static void buf_cb(scpi_ctx_t *ctx, uint8_t *buf, uint32_t len, uint32_t offset)
+{
+	data_cb(ctx, buf, len, offset);
+
+	// kept until the parser stalls
+	held[(buf == bbuf0) ? 0 : 1] = buf;
+}
+
+
+static void release_held(scpi_ctx_t *ctx)
+{
+	for (int i = 0; i < 2; i++) {
+		if (held[i] != NULL) {
+			scpi_blob_release_buffer(ctx, held[i]);
+			held[i] = NULL;
+		}
+	}
+}
+
+
+static void end_cb(scpi_ctx_t *ctx, uint32_t len)
+{
+	(void)ctx;
+	ended = true;
+	end_len = len;
+}
+
+
+static void cmd_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	(void)args;
+}
+
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"RLE"},
+		.params = {SCPI_DT_BLOB},
+		.callback = cmd_cb,
+		.blob_data_callback = data_cb,
+		.blob_end_callback = end_cb,
+		.blob_codec = SCPI_CODEC_RLE,
+	},
+	{
+		.levels = {"LZ4"},
+		.params = {SCPI_DT_BLOB},
+		.callback = cmd_cb,
+		.blob_data_callback = data_cb,
+		.blob_end_callback = end_cb,
+		.blob_codec = SCPI_CODEC_LZ4,
+	},
+	{
+		.levels = {"LZ4", "BUFfered"},
+		.params = {SCPI_DT_BLOB},
+		.callback = cmd_cb,
+		.blob_buf = {bbuf0, bbuf1},
+		.blob_buf_len = sizeof(bbuf0),
+		.blob_buf_callback = buf_cb,
+		.blob_end_callback = end_cb,
+		.blob_codec = SCPI_CODEC_LZ4,
+	},
+	{/*END*/}
+};
+
+
+// ---- encoders (as in blobpack.py) ----
+
+static size_t rle_encode(const uint8_t *in, size_t n, uint8_t *out)
+{
+	size_t o = 0, i = 0, lit = 0; // literals waiting: in[i - lit .. i]
+
+	while (i <= n) {
+		size_t run = 1;
+		while (i < n && i + run < n && run < 128 && in[i + run] == in[i]) run++;
+
+		if (i == n || run >= 3 || lit == 128) {
+			// flush literals
+			if (lit > 0) {
+				out[o++] = (uint8_t)(lit - 1);
+				memcpy(&out[o], &in[i - lit], lit);
+				o += lit;
+				lit = 0;
+			}
+			if (i == n) break;
+		}
+
+		if (run >= 3) {
+			out[o++] = (uint8_t)(257 - run);
+			out[o++] = in[i];
+			i += run;
+		} else {
+			lit++;
+			i++;
+		}
+	}
+
+	return o;
+}
+
+
+static size_t lz4_len_ext(uint8_t *out, size_t len)
+{
+	size_t o = 0;
+
+	for (; len >= 255; len -= 255) out[o++] = 255;
+	out[o++] = (uint8_t) len;
+
+	return o;
+}
+
+
+/** One LZ4 sequence, mlen = 0 for the last one (literals only) */
+static size_t lz4_sequence(uint8_t *out, const uint8_t *lit, size_t lit_len, unsigned off, size_t mlen)
+{
+	size_t o = 0;
+	const size_t ml = mlen ? mlen - 4 : 0;
+
+	out[o++] = (uint8_t)(((lit_len < 15) ? lit_len : 15) << 4 | ((ml < 15) ? ml : 15));
+	if (lit_len >= 15) o += lz4_len_ext(&out[o], lit_len - 15);
+
+	memcpy(&out[o], lit, lit_len);
+	o += lit_len;
+
+	if (mlen) {
+		out[o++] = (uint8_t) off;
+		out[o++] = (uint8_t)(off >> 8);
+		if (ml >= 15) o += lz4_len_ext(&out[o], ml - 15);
+	}
+
+	return o;
+}
+
+
+/** Greedy LZ4 block compressor, offsets up to the window */
+static size_t lz4_encode(const uint8_t *in, size_t n, uint8_t *out)
+{
+	size_t o = 0, anchor = 0, i = 0;
+
+	while (i + 12 < n) { // no match starts in the last 12 bytes
+		size_t best = 0;
+		unsigned best_off = 0;
+
+		for (unsigned off = 1; off <= WINDOW && off <= i; off++) {
+			size_t len = 0;
+			while (i + len < n - 5 && in[i + len] == in[i + len - off]) len++; // last 5 are literals
+
+			if (len > best) {
+				best = len;
+				best_off = off;
+			}
+		}
+
+		if (best >= 4) {
+			o += lz4_sequence(&out[o], &in[anchor], i - anchor, best_off, best);
+			i += best;
+			anchor = i;
+		} else {
+			i++;
+		}
+	}
+
+	o += lz4_sequence(&out[o], &in[anchor], n - anchor, 0, 0);
+	return o;
+}
+
+
+// ---- tests ----
+
+static uint8_t plain[DATA_LEN];
+static uint8_t packed[DATA_LEN * 2];
+static uint8_t msg[DATA_LEN * 2 + 32];
+
+
+/** Test data - text, runs, noise, long literal runs and repeats from far back */
+static void make_data(void)
+{
+	size_t n = 0;
+	uint32_t r = 12345;
+
+	while (n < DATA_LEN) {
+		const size_t part = n % 7;
+		size_t len = 0;
+
+		if (part == 0 || part == 3) {
+			static const char text[] = "SOURce:VOLTage 1.25;CURRent 0.5\n";
+			len = sizeof(text) - 1;
+			if (n + len > DATA_LEN) len = DATA_LEN - n;
+			memcpy(&plain[n], text, len);
+		} else if (part == 1) {
+			len = 40 + n % 300; // run
+			if (n + len > DATA_LEN) len = DATA_LEN - n;
+			memset(&plain[n], 'A' + (int)(n % 26), len);
+		} else if (part == 2 || part == 5) {
+			len = 20 + n % 290; // noise, long literals
+			if (n + len > DATA_LEN) len = DATA_LEN - n;
+			for (size_t i = 0; i < len; i++) {
+				r = r * 1103515245 + 12345;
+				plain[n + i] = (uint8_t)(r >> 16);
+			}
+		} else {
+			// copy of earlier data, up to the window back
+			len = 50;
+			if (n + len > DATA_LEN) len = DATA_LEN - n;
+			const size_t back = (n > WINDOW - 10) ? WINDOW - 10 : n;
+			memmove(&plain[n], &plain[n - back], len);
+		}
+
+		n += len;
+	}
+}
+
+
+/** Wrap packed data in a command with a definite length block */
+static size_t make_msg(const char *cmd, const uint8_t *payload, size_t len)
+{
+	const int h = sprintf((char *) msg, "%s #4%04u", cmd, (unsigned) len);
+	memcpy(&msg[h], payload, len);
+	msg[h + len] = '\n';
+
+	return h + len + 1;
+}
+
+
+static void reset_sink(void)
+{
+	got_len = 0;
+	ended = false;
+	end_len = 0;
+	release_held(&session);
+}
+
+
+static void check_received(const uint8_t *expect, size_t len)
+{
+	CHECK(ended);
+	CHECK_EQ(end_len, len);
+	CHECK_EQ(got_len, len);
+	CHECK(got_len == len && memcmp(got, expect, len) == 0);
+	CHECK_EQ(test_errors(&session), 0);
+}
+
+
+static void test_roundtrip(const char *cmd, size_t packed_len)
+{
+	static const size_t chunks[] = {1, 2, 3, 7, 16, 61, 4096};
+	const size_t len = make_msg(cmd, packed, packed_len);
+
+	for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+		reset_sink();
+		test_feed(&session, msg, len, chunks[i]);
+		check_received(plain, DATA_LEN);
+	}
+}
+
+
+/** Every split point of a short message - matches and lengths cut between pieces */
+static void test_splits(void)
+{
+	uint8_t small[300];
+	uint8_t small_packed[400];
+
+	for (size_t i = 0; i < sizeof(small); i++) {
+		small[i] = (uint8_t)((i < 40) ? 'a' + i % 3 : (i < 120) ? 'x' : (i * 7) % 251);
+	}
+
+	const size_t plen = lz4_encode(small, sizeof(small), small_packed);
+	const size_t len = make_msg("LZ4", small_packed, plen);
+
+	for (size_t at = 0; at <= len; at++) {
+		reset_sink();
+		test_feed_split(&session, msg, len, at);
+		check_received(small, sizeof(small));
+	}
+
+	const size_t rlen = rle_encode(small, sizeof(small), small_packed);
+	const size_t len2 = make_msg("RLE", small_packed, rlen);
+
+	for (size_t at = 0; at <= len2; at++) {
+		reset_sink();
+		test_feed_split(&session, msg, len2, at);
+		check_received(small, sizeof(small));
+	}
+}
+
+
+static void test_errors_lz4(void)
+{
+	// match before the start of the data
+	static const uint8_t bad_off[] = {0x10, 'a', 0x05, 0x00, 0x00};
+	size_t len = make_msg("LZ4", bad_off, sizeof(bad_off));
+
+	for (size_t at = 0; at <= len; at++) {
+		reset_sink();
+		test_feed_split(&session, msg, len, at);
+		CHECK(!ended);
+		CHECK_EQ(test_errors(&session), E_CMD_INVALID_BLOCK_DATA);
+	}
+
+	// offset beyond the window
+	uint8_t far[WINDOW + 64];
+	size_t o = lz4_sequence(far, plain, WINDOW + 40, WINDOW + 1, 4);
+	len = make_msg("LZ4", far, o);
+	reset_sink();
+	test_feed(&session, msg, len, 64);
+	CHECK(!ended);
+	CHECK_EQ(test_errors(&session), E_CMD_INVALID_BLOCK_DATA);
+
+	// ends in the middle of a sequence
+	static const uint8_t truncated[] = {0x40, 'a', 'b'};
+	len = make_msg("LZ4", truncated, sizeof(truncated));
+	reset_sink();
+	test_feed(&session, msg, len, 1);
+	CHECK(ended);
+	CHECK_EQ(got_len, 2);
+	CHECK_EQ(test_errors(&session), E_CMD_INVALID_BLOCK_DATA);
+
+	// the parser goes on after an error
+	len = make_msg("LZ4", packed, lz4_encode(plain, DATA_LEN, packed));
+	reset_sink();
+	test_feed(&session, msg, len, 100);
+	check_received(plain, DATA_LEN);
+}
+
+
+static void test_errors_rle(void)
+{
+	// 0x80 is a no-op, then 3 literals and a run of 4
+	static const uint8_t nop[] = {0x80, 0x02, 'a', 'b', 'c', 0xFD, 'z', 0x80};
+	size_t len = make_msg("RLE", nop, sizeof(nop));
+	reset_sink();
+	test_feed(&session, msg, len, 1);
+	check_received((const uint8_t *) "abczzzz", 7);
+
+	// literals cut off
+	static const uint8_t truncated[] = {0x05, 'a', 'b'};
+	len = make_msg("RLE", truncated, sizeof(truncated));
+	reset_sink();
+	test_feed(&session, msg, len, 2);
+	CHECK(ended);
+	CHECK_EQ(test_errors(&session), E_CMD_INVALID_BLOCK_DATA);
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+	make_data();
+
+	test_case = "rle";
+	test_roundtrip("RLE", rle_encode(plain, DATA_LEN, packed));
+
+	test_case = "lz4";
+	test_roundtrip("LZ4", lz4_encode(plain, DATA_LEN, packed));
+
+	test_case = "lz4 buffers";
+	test_on_stall = release_held;
+	test_roundtrip("LZ4:BUF", lz4_encode(plain, DATA_LEN, packed));
+	test_on_stall = NULL;
+
+	test_case = "splits";
+	test_splits();
+
+	test_case = "lz4 errors";
+	test_errors_lz4();
+
+	test_case = "rle errors";
+	test_errors_rle();
+
+	return test_done("blob");
+}
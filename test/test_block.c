@@ -0,0 +1,262 @@
+#include "test.h"
+
+// Plain block data (#<n><len><data>), received in pieces - preamble and lengths,
+// whole chunks for the zero-copy callback.
+
+static scpi_ctx_t session;
+
+static bool called;
+static uint32_t arg_len;
+static uint8_t got[256];
+static size_t got_len;
+static bool ended;
+
+
+static void data_cb(scpi_ctx_t *ctx, const uint8_t *data, size_t len, uint32_t offset)
+{
+	(void)ctx;
+	CHECK_EQ(offset, got_len);
+
+	if (got_len + len <= sizeof(got)) {
+		memcpy(&got[got_len], data, len);
+	}
+	got_len += len;
+}
+
+
+static void end_cb(scpi_ctx_t *ctx, uint32_t len)
+{
+	(void)ctx;
+	ended = true;
+	CHECK_EQ(len, got_len);
+}
+
+
+#define CHUNK 16
+
+static int chunks;
+static bool chunks_whole;
+
+
+static void chunk_cb(scpi_ctx_t *ctx, const uint8_t *data, size_t len, uint32_t offset)
+{
+	// whole chunks, only the last may be shorter
+	if (chunks > 0 && got_len % CHUNK != 0) chunks_whole = false;
+	if (len != CHUNK && offset + len != arg_len) chunks_whole = false;
+
+	chunks++;
+	data_cb(ctx, data, len, offset);
+}
+
+
+static void data_cmd_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	called = true;
+	arg_len = args[0].BLOB_LEN;
+}
+
+
+static void size_cmd_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	data_cmd_cb(ctx, args);
+	scpi_discard_blob(ctx); // only the length is checked
+}
+
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"DATA"},
+		.params = {SCPI_DT_BLOB},
+		.callback = data_cmd_cb,
+		.blob_data_callback = data_cb,
+		.blob_end_callback = end_cb,
+	},
+	{
+		.levels = {"SIZE"},
+		.params = {SCPI_DT_BLOB},
+		.callback = size_cmd_cb,
+	},
+	{
+		.levels = {"CHUNk"},
+		.params = {SCPI_DT_BLOB},
+		.callback = data_cmd_cb,
+		.blob_chunk = CHUNK,
+		.blob_data_callback = chunk_cb,
+		.blob_end_callback = end_cb,
+	},
+	{
+		.levels = {"CHUNk", "BIG"},
+		.params = {SCPI_DT_BLOB},
+		.callback = data_cmd_cb,
+		.blob_chunk = SCPI_MAX_STRING_LEN + 1, // can't be collected, scpi_init() fails
+		.blob_data_callback = chunk_cb,
+		.blob_end_callback = end_cb,
+	},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	const char *data;
+} block_case_t;
+
+static const block_case_t valid[] = {
+	{"DATA #15hello\n", "hello"},
+	{"DATA #10\n", ""},
+	{"DATA #3005a;b\nc\n", "a;b\nc"}, // leading zeros, any bytes in the body
+	{"DATA #9000000012hello world!\n", "hello world!"},
+	{"DATA  #212abcdefghijkl \n", "abcdefghijkl"},
+};
+
+typedef struct {
+	const char *msg;
+	int16_t error;
+} block_error_t;
+
+static const block_error_t invalid[] = {
+	{"DATA #A\n", E_CMD_BLOCK_DATA_ERROR},
+	{"DATA #2x1\n", E_CMD_BLOCK_DATA_ERROR},
+	{"DATA #21-\n", E_CMD_BLOCK_DATA_ERROR},
+	{"DATA #3\n", E_CMD_BLOCK_DATA_ERROR},
+	{"DATA #31\n", E_CMD_BLOCK_DATA_ERROR},
+	{"DATA 5hello\n", E_CMD_INVALID_BLOCK_DATA},
+};
+
+
+static void run_split(const char *msg, size_t at)
+{
+	called = false;
+	arg_len = 0;
+	got_len = 0;
+	ended = false;
+	test_feed_split(&session, msg, strlen(msg), at);
+}
+
+
+static void test_valid(void)
+{
+	for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+		const block_case_t *c = &valid[i];
+		const size_t len = strlen(c->data);
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(called && ended);
+			CHECK_EQ(arg_len, len);
+			CHECK(got_len == len && memcmp(got, c->data, len) == 0);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+}
+
+
+static void test_invalid(void)
+{
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		const block_error_t *c = &invalid[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(!called);
+			CHECK_EQ(test_errors(&session), c->error);
+
+			// the next command is parsed normally
+			run_split("DATA #12ok\n", 0);
+			CHECK(called && ended && got_len == 2 && memcmp(got, "ok", 2) == 0);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+}
+
+
+/** Lengths up to 9 digits - only the preamble is sent */
+static void test_lengths(void)
+{
+	static const struct {
+		const char *msg;
+		uint32_t len;
+	} lengths[] = {
+		{"SIZE #19", 9},
+		{"SIZE #41000", 1000},
+		{"SIZE #6065536", 65536},
+		{"SIZE #9123456789", 123456789},
+		{"SIZE #9999999999", 999999999},
+	};
+
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+		test_case = lengths[i].msg;
+
+		for (size_t at = 0; at <= strlen(lengths[i].msg); at++) {
+			scpi_ctx_init(&session, NULL); // the body is never sent
+			run_split(lengths[i].msg, at);
+
+			CHECK(called);
+			CHECK_EQ(arg_len, lengths[i].len);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+
+	scpi_ctx_init(&session, NULL);
+}
+
+
+/** Zero-copy chunks are passed whole, also when split between input buffers */
+static void test_chunks(void)
+{
+	static char msg[200];
+	static char data[100];
+
+	for (size_t i = 0; i < sizeof(data); i++) {
+		data[i] = (char)('a' + (i * 7) % 26);
+	}
+
+	const size_t len = (size_t) sprintf(msg, "CHUNK #3100%.100s\n", data);
+	test_case = "chunks";
+
+	for (size_t piece = 1; piece <= len; piece++) {
+		chunks = 0;
+		chunks_whole = true;
+		called = false;
+		got_len = 0;
+		ended = false;
+		test_feed(&session, msg, len, piece);
+
+		CHECK(called && ended);
+		CHECK(got_len == sizeof(data) && memcmp(got, data, sizeof(data)) == 0);
+		CHECK_EQ(chunks, (sizeof(data) + CHUNK - 1) / CHUNK);
+		CHECK(chunks_whole);
+		CHECK_EQ(test_errors(&session), 0);
+	}
+
+	test_case = "chunk too large";
+
+	run_split("CHUNK:BIG #15hello\n", 12);
+	CHECK(called && !ended);
+	CHECK_EQ(got_len, 0);
+	CHECK_EQ(test_errors(&session), E_DEV_SYSTEM_ERROR);
+
+	// not a problem for the other commands
+	run_split("CHUNK #217abcdefghijklmnopq\n", 9);
+	CHECK(called && ended && got_len == 17);
+	CHECK_EQ(test_errors(&session), 0);
+}
+
+
+int main(void)
+{
+	CHECK(!scpi_init()); // CHUNK:BIG
+	scpi_ctx_init(&session, NULL);
+
+	test_valid();
+	test_invalid();
+	test_lengths();
+	test_chunks();
+
+	return test_done("block");
+}
@@ -0,0 +1,219 @@
+#include "test.h"
+
+// Channel list params (SCPI_DT_CHANLIST), received in pieces.
+
+static scpi_ctx_t session;
+
+static bool called;
+static uint16_t count;
+static SCPI_chanrange_t ranges[SCPI_MAX_CHAN_RANGES];
+static int32_t scan_delay;
+
+static uint8_t bitmap[8]; // 4 modules of 16 channels
+
+
+static void chan_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	called = true;
+	count = args[0].CHANLIST.count;
+
+	const uint16_t n = (count < SCPI_MAX_CHAN_RANGES) ? count : SCPI_MAX_CHAN_RANGES;
+	memcpy(ranges, args[0].CHANLIST.ranges, n * sizeof(SCPI_chanrange_t));
+}
+
+
+static void scan_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	chan_cb(ctx, args);
+	scan_delay = args[1].INT;
+}
+
+
+static const SCPI_param_ext_t close_ext = {
+	.chan_bitmap = bitmap,
+	.chan_bitmap_bits = 64,
+	.chan_per_module = 16,
+};
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"ROUTe", "OPEN"},
+		.params = {SCPI_DT_CHANLIST},
+		.callback = chan_cb,
+	},
+	{
+		.levels = {"ROUTe", "CLOSe"},
+		.params = {SCPI_DT_CHANLIST},
+		.callback = chan_cb,
+		.ext = &close_ext,
+	},
+	{
+		.levels = {"ROUTe", "SCAN"},
+		.params = {SCPI_DT_CHANLIST, SCPI_DT_INT},
+		.callback = scan_cb,
+	},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	uint16_t count;
+	SCPI_chanrange_t ranges[4];
+} chan_case_t;
+
+static const chan_case_t valid[] = {
+	{"ROUT:OPEN (@1,3,5:8)\n", 3, {{1, 1}, {3, 3}, {5, 8}}},
+	{"ROUT:OPEN (@8:5)\n", 1, {{8, 5}}},
+	{"ROUT:OPEN (@1!1:1!8,2!3)\n", 2, {{SCPI_CHAN(1, 1), SCPI_CHAN(1, 8)}, {SCPI_CHAN(2, 3), SCPI_CHAN(2, 3)}}},
+	{"ROUT:OPEN (@2!1:4)\n", 1, {{SCPI_CHAN(2, 1), SCPI_CHAN(2, 4)}}}, // end in the module of the start
+	{"ROUT:OPEN ( @ 10 , 65535 )\n", 2, {{10, 10}, {65535, 65535}}},
+	{"ROUT:OPEN (@)\n", 0, {{0, 0}}},
+};
+
+typedef struct {
+	const char *msg;
+	int16_t error;
+} chan_error_t;
+
+static const chan_error_t invalid[] = {
+	{"ROUT:OPEN (@1,,2)\n", E_CMD_INVALID_EXPRESSION},
+	{"ROUT:OPEN (@1:2:3)\n", E_CMD_INVALID_EXPRESSION},
+	{"ROUT:OPEN (@1!2!3)\n", E_CMD_INVALID_EXPRESSION},
+	{"ROUT:OPEN (@1\n", E_CMD_INVALID_EXPRESSION},
+	{"ROUT:OPEN (1)\n", E_CMD_INVALID_EXPRESSION},
+	{"ROUT:OPEN (@x)\n", E_CMD_INVALID_EXPRESSION},
+	{"ROUT:OPEN (@65536)\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"ROUT:OPEN (@1,2,3,4,5,6,7,8,9)\n", E_EXE_TOO_MUCH_DATA}, // no bitmap, ranges don't fit
+	{"ROUT:CLOS (@4!0)\n", E_EXE_DATA_OUT_OF_RANGE}, // outside the bitmap
+	{"ROUT:CLOS (@0!16)\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"ROUT:CLOS (@3!15:4!15)\n", E_EXE_DATA_OUT_OF_RANGE},
+};
+
+
+static bool bit(unsigned n)
+{
+	return (bitmap[n / 8] >> (n % 8)) & 1;
+}
+
+
+static void run_split(const char *msg, size_t at)
+{
+	called = false;
+	count = 0;
+	memset(ranges, 0, sizeof(ranges));
+	test_feed_split(&session, msg, strlen(msg), at);
+}
+
+
+static void test_valid(void)
+{
+	for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+		const chan_case_t *c = &valid[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(called);
+			CHECK_EQ(count, c->count);
+			for (uint16_t r = 0; r < c->count; r++) {
+				CHECK_EQ(ranges[r].first, c->ranges[r].first);
+				CHECK_EQ(ranges[r].last, c->ranges[r].last);
+			}
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+}
+
+
+static void test_invalid(void)
+{
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		const chan_error_t *c = &invalid[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(!called);
+			CHECK_EQ(test_errors(&session), c->error);
+
+			// the next command is parsed normally
+			run_split("ROUT:OPEN (@7)\n", 0);
+			CHECK(called && count == 1 && ranges[0].first == 7);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+}
+
+
+static void test_bitmap(void)
+{
+	static const char msg[] = "ROUT:CLOS (@0!0:1!3,3!15)\n";
+	test_case = msg;
+
+	for (size_t at = 0; at <= strlen(msg); at++) {
+		memset(bitmap, 0xAA, sizeof(bitmap)); // cleared by the parser
+		run_split(msg, at);
+
+		CHECK(called);
+		CHECK_EQ(count, 2);
+
+		// both modules 0 and 1, channels 0..3 in each
+		unsigned set = 0;
+		for (unsigned b = 0; b < 64; b++) {
+			const bool expect = (b < 4) || (b >= 16 && b < 20) || b == 63;
+			CHECK_EQ(bit(b), expect);
+			set += bit(b);
+		}
+		CHECK_EQ(set, 9);
+		CHECK_EQ(test_errors(&session), 0);
+	}
+
+	// with a bitmap, lists longer than SCPI_MAX_CHAN_RANGES are accepted
+	static const char longer[] = "ROUT:CLOS (@1,2,3,4,5,6,7,8,9,10,11,12)\n";
+	test_case = longer;
+	run_split(longer, 17);
+
+	CHECK(called);
+	CHECK_EQ(count, 12);
+	CHECK_EQ(ranges[SCPI_MAX_CHAN_RANGES - 1].first, SCPI_MAX_CHAN_RANGES);
+	for (unsigned b = 1; b <= 12; b++) {
+		CHECK(bit(b));
+	}
+	CHECK(!bit(0) && !bit(13));
+	CHECK_EQ(test_errors(&session), 0);
+}
+
+
+static void test_next_param(void)
+{
+	static const char msg[] = "ROUT:SCAN (@1:4) , 250\n";
+	test_case = msg;
+
+	for (size_t at = 0; at <= strlen(msg); at++) {
+		scan_delay = 0;
+		run_split(msg, at);
+
+		CHECK(called);
+		CHECK_EQ(count, 1);
+		CHECK_EQ(scan_delay, 250);
+		CHECK_EQ(test_errors(&session), 0);
+	}
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	test_valid();
+	test_invalid();
+	test_bitmap();
+	test_next_param();
+
+	return test_done("chanlist");
+}
@@ -0,0 +1,162 @@
+#include "test.h"
+
+// ENUM params - mnemonics in the short or long form, matched while received; BOOL.
+
+static scpi_ctx_t session;
+
+static bool called;
+static int8_t arg_enum[2];
+static bool arg_bool;
+
+
+static void enum_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	called = true;
+	arg_enum[0] = scpi_arg_enum(ctx, 0);
+	arg_enum[1] = scpi_arg_enum(ctx, 1);
+	CHECK_EQ(arg_enum[0], args[0].ENUM);
+}
+
+
+static void bool_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	called = true;
+	arg_enum[0] = scpi_arg_enum(ctx, 0);
+	arg_bool = scpi_arg_bool(ctx, 1);
+	CHECK_EQ(arg_bool, args[1].BOOL);
+}
+
+
+static const char *const functions[] = {"VOLTage", "CURRent", "RESistance", "FREQuency", NULL};
+static const char *const modes[] = {"MODE", "MODulation", "M", NULL};
+static const char *const sources[] = {"IMMediate", "BUS", "EXTernal", NULL};
+
+static const SCPI_param_ext_t func_ext = {
+	.enums = {functions, modes},
+};
+
+static const SCPI_param_ext_t trig_ext = {
+	.enums = {sources},
+};
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"FUNCtion"},
+		.params = {SCPI_DT_ENUM, SCPI_DT_ENUM},
+		.callback = enum_cb,
+		.ext = &func_ext,
+	},
+	{
+		.levels = {"TRIGger", "SOURce"},
+		.params = {SCPI_DT_ENUM, SCPI_DT_BOOL},
+		.callback = bool_cb,
+		.ext = &trig_ext,
+	},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	int8_t index[2];
+	int16_t error;
+} enum_case_t;
+
+static const enum_case_t cases[] = {
+	{"FUNC VOLT,MODE\n", {0, 0}},
+	{"FUNC voltage,mod\n", {0, 1}},
+	{"FUNC VoLtAgE,MODULATION\n", {0, 1}},
+	{"FUNC CURR,M\n", {1, 2}},
+	{"FUNC res , modulation \n", {2, 1}},
+	{"FUNC FREQ,m\n", {3, 2}},
+	{"FUNC frequency,Mode\n", {3, 0}},
+
+	{"FUNC VOL,MODE\n", {0}, E_CMD_INVALID_CHARACTER_DATA},
+	{"FUNC VOLTA,MODE\n", {0}, E_CMD_INVALID_CHARACTER_DATA},
+	{"FUNC VOLTAGES,MODE\n", {0}, E_CMD_INVALID_CHARACTER_DATA},
+	{"FUNC FOO,MODE\n", {0}, E_CMD_INVALID_CHARACTER_DATA},
+	{"FUNC VOLT,MODU\n", {0}, E_CMD_INVALID_CHARACTER_DATA},
+	{"FUNC VOLT,MO\n", {0}, E_CMD_INVALID_CHARACTER_DATA},
+	{"FUNC 1.5,MODE\n", {0}, E_CMD_INVALID_CHARACTER_DATA},
+	{"FUNC \"VOLT\",MODE\n", {0}, E_CMD_INVALID_CHARACTER_DATA},
+	{"FUNC VOLT\n", {0}, E_CMD_MISSING_PARAMETER},
+};
+
+typedef struct {
+	const char *msg;
+	int8_t index;
+	bool value;
+	int16_t error;
+} bool_case_t;
+
+static const bool_case_t bools[] = {
+	{"TRIG:SOUR BUS,ON\n", 1, true},
+	{"TRIG:SOUR imm,off\n", 0, false},
+	{"TRIG:SOUR EXTERNAL,1\n", 2, true},
+	{"TRIG:SOUR ext,0\n", 2, false},
+
+	{"TRIG:SOUR BUS,2\n", 0, false, E_CMD_NUMERIC_DATA_ERROR},
+	{"TRIG:SOUR BUS,ONN\n", 0, false, E_CMD_NUMERIC_DATA_ERROR},
+	{"TRIG:SOUR BUS,TRUE\n", 0, false, E_CMD_NUMERIC_DATA_ERROR},
+	{"TRIG:SOUR BU,ON\n", 0, false, E_CMD_INVALID_CHARACTER_DATA},
+};
+
+
+static void run_split(const char *msg, size_t at)
+{
+	called = false;
+	arg_enum[0] = arg_enum[1] = -2;
+	test_feed_split(&session, msg, strlen(msg), at);
+}
+
+
+static void test_enum(void)
+{
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const enum_case_t *c = &cases[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK_EQ(test_errors(&session), c->error);
+			CHECK_EQ(called, c->error == 0);
+			if (!called) continue;
+
+			CHECK_EQ(arg_enum[0], c->index[0]);
+			CHECK_EQ(arg_enum[1], c->index[1]);
+		}
+	}
+}
+
+
+static void test_bool(void)
+{
+	for (size_t i = 0; i < sizeof(bools) / sizeof(bools[0]); i++) {
+		const bool_case_t *c = &bools[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK_EQ(test_errors(&session), c->error);
+			CHECK_EQ(called, c->error == 0);
+			if (!called) continue;
+
+			CHECK_EQ(arg_enum[0], c->index);
+			CHECK_EQ(arg_bool, c->value);
+		}
+	}
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	test_enum();
+	test_bool();
+
+	return test_done("enum");
+}
@@ -0,0 +1,189 @@
+#include "test.h"
+
+// Error responses - SYST:ERR? and SYST:ERR:ALL? framing, quotes in the message,
+// scpi_error_string(). Error queue - overflow, extra info cut off, user callback.
+
+static scpi_ctx_t session;
+
+static char cb_text[SCPI_MAX_ERROR_LEN + 1];
+static int16_t cb_errno;
+static int cb_count;
+
+
+void scpi_user_error(scpi_ctx_t *ctx, int16_t errno, const char *error_string)
+{
+	(void)ctx;
+	cb_count++;
+	cb_errno = errno;
+	strcpy(cb_text, error_string);
+}
+
+
+static void err_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	scpi_add_error(ctx, (int16_t) args[0].INT, args[1].STRING[0] ? args[1].STRING : NULL);
+}
+
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"ERRor"},
+		.params = {SCPI_DT_INT, SCPI_DT_STRING},
+		.callback = err_cb,
+	},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	const char *out;
+} resp_case_t;
+
+static const resp_case_t cases[] = {
+	{"SYST:ERR?\n", "0,\"No error\"\n"},
+	{"SYST:ERR:NEXT?\n", "0,\"No error\"\n"},
+	{"SYST:ERR:ALL?\n", "0,\"No error\"\n"},
+	{"ERR -222,'too big';:SYST:ERR?\n", "-222,\"Data out of range; too big\"\n"},
+	{"ERR -222,'';:SYST:ERR?\n", "-222,\"Data out of range\"\n"},
+	{"ERR -225,'x';:SYST:ERR?;ERR?\n", "-225,\"Out of memory; x\"\n0,\"No error\"\n"},
+	{"ERR -113,'say \"hi\"';:SYST:ERR?\n", "-113,\"Undefined header; say \"\"hi\"\"\"\n"},
+	{"ERR -119,'';:SYST:ERR?\n", "-110,\"Command header error\"\n"}, // coerced to the group
+
+	// one line, entries separated by commas
+	{"ERR -222,'a';ERR -109,'';ERR -350,'b';:SYST:ERR:ALL?\n",
+		"-222,\"Data out of range; a\",-109,\"Missing parameter\",-350,\"Queue overflow; b\"\n"},
+	{"ERR -222,'';:SYST:ERR:ALL?;ALL?\n", "-222,\"Data out of range\"\n0,\"No error\"\n"},
+	{"ERR -222,'';:SYST:ERR:CODE:ALL?\n", "-222\n"},
+};
+
+
+static void test_responses(void)
+{
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const resp_case_t *c = &cases[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			test_out_reset();
+			test_feed_split(&session, c->msg, strlen(c->msg), at);
+
+			CHECK(strcmp(test_out, c->out) == 0);
+			CHECK_EQ(scpi_error_count(&session), 0);
+		}
+	}
+}
+
+
+static void test_string(void)
+{
+	char buf[SCPI_MAX_ERROR_LEN + 1];
+	char extra[200];
+
+	test_case = "scpi_error_string";
+
+	CHECK_EQ(scpi_error_string(buf, E_NO_ERROR, NULL), 0);
+	CHECK(strcmp(buf, "0,\"No error\"") == 0);
+
+	CHECK_EQ(scpi_error_string(buf, -222, "abc"), -222);
+	CHECK(strcmp(buf, "-222,\"Data out of range; abc\"") == 0);
+
+	CHECK_EQ(scpi_error_string(buf, -119, NULL), -110);
+	CHECK(strcmp(buf, "-110,\"Command header error\"") == 0);
+
+	CHECK_EQ(scpi_error_string(buf, 42, NULL), 42);
+	CHECK(strcmp(buf, "42,\"Unknown error\"") == 0);
+
+	CHECK_EQ(scpi_error_string(buf, -32768, NULL), -32768);
+	CHECK(strcmp(buf, "-32768,\"Unknown error\"") == 0);
+
+	// cut off, still quoted
+	memset(extra, 'x', sizeof(extra) - 1);
+	extra[sizeof(extra) - 1] = 0;
+	scpi_error_string(buf, -222, extra);
+	CHECK_EQ(strlen(buf), SCPI_MAX_ERROR_LEN);
+	CHECK(buf[SCPI_MAX_ERROR_LEN - 1] == '"' && buf[SCPI_MAX_ERROR_LEN - 2] == 'x');
+}
+
+
+static void test_queue(void)
+{
+	char buf[SCPI_MAX_ERROR_LEN + 1];
+	char extra[SCPI_ERR_EXTRA_LEN + 20];
+
+	test_case = "queue";
+	scpi_clear_errors(&session);
+
+	// oldest first, the last entry is replaced by an overflow error
+	for (int i = 0; i < SCPI_ERR_QUEUE_LEN + 2; i++) {
+		scpi_add_error(&session, (int16_t)(-221 - i), NULL);
+	}
+	CHECK_EQ(scpi_error_count(&session), SCPI_ERR_QUEUE_LEN);
+	CHECK_EQ(cb_errno, E_DEV_QUEUE_OVERFLOW);
+
+	for (int i = 0; i < SCPI_ERR_QUEUE_LEN - 1; i++) {
+		CHECK_EQ(scpi_read_error_code(&session), -221 - i);
+	}
+	scpi_read_error_noremove(&session, buf);
+	CHECK(strcmp(buf, "-350,\"Queue overflow\"") == 0);
+	CHECK_EQ(scpi_error_count(&session), 1);
+	CHECK_EQ(scpi_read_error_code(&session), E_DEV_QUEUE_OVERFLOW);
+	CHECK_EQ(scpi_read_error_code(&session), 0);
+
+	test_case = "extra cut off";
+
+	memset(extra, 'e', sizeof(extra) - 1);
+	extra[sizeof(extra) - 1] = 0;
+	cb_count = 0;
+	scpi_add_error(&session, -222, extra);
+	CHECK_EQ(cb_count, 1);
+	CHECK_EQ(cb_errno, -222);
+
+	// the callback gets the same text as the queue
+	scpi_read_error(&session, buf);
+	CHECK(strcmp(cb_text, buf) == 0);
+	CHECK_EQ(strlen(buf), strlen("-222,\"Data out of range; \"") + SCPI_ERR_EXTRA_LEN);
+
+	// coerced codes, in the callback too
+	scpi_add_error(&session, -119, "x");
+	CHECK_EQ(cb_errno, -110);
+	CHECK(strcmp(cb_text, "-110,\"Command header error; x\"") == 0);
+	scpi_clear_errors(&session);
+	CHECK_EQ(scpi_error_count(&session), 0);
+
+	test_case = "status";
+
+	static const struct {
+		int16_t errno;
+		const char *esr;
+	} groups[] = {
+		{-410, "4\n"},
+		{-310, "8\n"},
+		{7, "8\n"}, // user error
+		{-222, "16\n"},
+		{-113, "32\n"},
+	};
+
+	test_feed(&session, "*ESR?\n", 6, 6); // cleared when read
+
+	for (size_t i = 0; i < sizeof(groups) / sizeof(groups[0]); i++) {
+		scpi_add_error(&session, groups[i].errno, NULL);
+		test_out_reset();
+		test_feed(&session, "*ESR?\n", 6, 6);
+		CHECK(strcmp(test_out, groups[i].esr) == 0);
+		scpi_clear_errors(&session);
+	}
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	test_responses();
+	test_string();
+	test_queue();
+
+	return test_done("errors");
+}
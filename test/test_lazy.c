@@ -0,0 +1,204 @@
+#include "test.h"
+
+// Lazy arguments - the text of each argument, numbers converted on access,
+// conversion errors raised on access.
+
+static scpi_ctx_t session;
+
+static bool called;
+static int16_t errors_before; // raised before the callback
+static char raw[4][32];
+static float arg_float;
+static int32_t arg_int;
+static int8_t arg_enum;
+static char arg_string[32];
+static SCPI_unit_t arg_unit;
+static bool arg_ok[2];
+
+
+static void copy_raw(scpi_ctx_t *ctx, uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++) {
+		strncpy(raw[i], scpi_arg_raw(ctx, i), sizeof(raw[i]) - 1);
+	}
+}
+
+
+static void setup_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)args;
+	called = true;
+	errors_before = (int16_t) scpi_error_count(ctx);
+	copy_raw(ctx, 4);
+
+	arg_float = scpi_arg_float(ctx, 0);
+	arg_unit = scpi_arg_unit(ctx, 0);
+	arg_int = scpi_arg_int(ctx, 1);
+	arg_enum = scpi_arg_enum(ctx, 2);
+	strcpy(arg_string, scpi_arg_string(ctx, 3));
+
+	arg_ok[0] = scpi_arg_ok(ctx, 0);
+	arg_ok[1] = scpi_arg_ok(ctx, 1);
+}
+
+
+static void pass_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)args;
+	called = true;
+	copy_raw(ctx, 2); // passed on, never converted
+}
+
+
+static void normal_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	called = true;
+	copy_raw(ctx, 1);
+	arg_float = args[0].FLOAT;
+	arg_ok[0] = scpi_arg_ok(ctx, 0);
+}
+
+
+static const char *const modes[] = {"VOLTage", "CURRent", NULL};
+static const SCPI_limits_t int_lim = SCPI_LIMITS_INT(0, 100, 50);
+
+static const SCPI_param_ext_t setup_ext = {
+	.units = {SCPI_UNIT_V},
+	.limits = {NULL, &int_lim},
+	.enums = {NULL, NULL, modes},
+};
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"SETup"},
+		.params = {SCPI_DT_FLOAT, SCPI_DT_INT, SCPI_DT_ENUM, SCPI_DT_STRING},
+		.callback = setup_cb,
+		.ext = &setup_ext,
+		.lazy_args = true,
+	},
+	{
+		.levels = {"PASS"},
+		.params = {SCPI_DT_DOUBLE, SCPI_DT_INT64},
+		.callback = pass_cb,
+		.lazy_args = true,
+	},
+	{
+		.levels = {"NORMal"},
+		.params = {SCPI_DT_FLOAT},
+		.callback = normal_cb,
+	},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	const char *raw[4];
+	float value;
+	int32_t count;
+	int8_t mode;
+	const char *string;
+	SCPI_unit_t unit;
+	bool ok[2];
+	int16_t error; // raised on access
+} lazy_case_t;
+
+static const lazy_case_t cases[] = {
+	{"SET 1.5mV,#H1F,curr,'abc'\n", {"1.5mV", "#H1F", "curr", "abc"}, 0.0015f, 31, 1, "abc", SCPI_UNIT_V, {true, true}},
+	{"SET  -2 , 100 , VOLT , \"\" \n", {"-2", "100", "VOLT", ""}, -2, 100, 0, "", SCPI_UNIT_NONE, {true, true}},
+	{"SET 2V,MAX,VOLT,'x'\n", {"2V", "MAX", "VOLT", "x"}, 2, 100, 0, "x", SCPI_UNIT_V, {true, true}},
+	{"SET 2,101,VOLT,'x'\n", {"2", "101", "VOLT", "x"}, 2, 0, 0, "x", SCPI_UNIT_NONE, {true, false}, E_EXE_DATA_OUT_OF_RANGE},
+	{"SET 2..0,5,VOLT,'x'\n", {"2..0", "5", "VOLT", "x"}, 0, 5, 0, "x", SCPI_UNIT_NONE, {false, true}, E_CMD_NUMERIC_DATA_ERROR},
+	{"SET 2A,5,VOLT,'x'\n", {"2A", "5", "VOLT", "x"}, 0, 5, 0, "x", SCPI_UNIT_NONE, {false, true}, E_CMD_INVALID_SUFFIX},
+};
+
+
+static void run_split(const char *msg, size_t at)
+{
+	called = false;
+	errors_before = -1;
+	memset(raw, 0, sizeof(raw));
+	arg_float = -1;
+	arg_int = -1;
+	arg_enum = -1;
+	arg_string[0] = 0;
+	arg_unit = SCPI_UNIT_NONE;
+	arg_ok[0] = arg_ok[1] = false;
+	test_feed_split(&session, msg, strlen(msg), at);
+}
+
+
+static void test_access(void)
+{
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const lazy_case_t *c = &cases[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(called);
+			CHECK_EQ(errors_before, 0);
+			CHECK_EQ(test_errors(&session), c->error);
+
+			for (uint8_t a = 0; a < 4; a++) {
+				CHECK(strcmp(raw[a], c->raw[a]) == 0);
+			}
+
+			CHECK(arg_float == c->value);
+			CHECK_EQ(arg_unit, c->unit);
+			CHECK_EQ(arg_int, c->count);
+			CHECK_EQ(arg_enum, c->mode);
+			CHECK(strcmp(arg_string, c->string) == 0);
+			CHECK_EQ(arg_ok[0], c->ok[0]);
+			CHECK_EQ(arg_ok[1], c->ok[1]);
+		}
+	}
+}
+
+
+static void test_other(void)
+{
+	static const char *pass = "PASS 1..5,#Hxyz\n";
+	test_case = pass;
+
+	// not read - no conversion, no error
+	for (size_t at = 0; at <= strlen(pass); at++) {
+		run_split(pass, at);
+
+		CHECK(called);
+		CHECK(strcmp(raw[0], "1..5") == 0 && strcmp(raw[1], "#Hxyz") == 0);
+		CHECK_EQ(test_errors(&session), 0);
+	}
+
+	// parse errors of the other params are raised before the callback
+	test_case = "SET 1,2,FOO,'x'";
+	run_split("SET 1,2,FOO,'x'\n", 0);
+	CHECK(!called);
+	CHECK_EQ(test_errors(&session), E_CMD_INVALID_CHARACTER_DATA);
+
+	// without lazy_args, no text
+	test_case = "NORM 1.5";
+	run_split("NORM 1.5\n", 0);
+	CHECK(called && arg_ok[0]);
+	CHECK(arg_float == 1.5f);
+	CHECK(strcmp(raw[0], "") == 0);
+	CHECK_EQ(test_errors(&session), 0);
+
+	test_case = "NORM 1..5";
+	run_split("NORM 1..5\n", 0);
+	CHECK(!called);
+	CHECK_EQ(test_errors(&session), E_CMD_NUMERIC_DATA_ERROR);
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	test_access();
+	test_other();
+
+	return test_done("lazy");
+}
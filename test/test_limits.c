@@ -0,0 +1,203 @@
+#include "test.h"
+
+// Limits of numeric params - MIN, MAX, DEF, INF, NINF keywords, range checks (-222)
+// before the callback, "CMD? MIN|MAX|DEF" queries.
+
+static scpi_ctx_t session;
+
+static bool called;
+static SCPI_argval_t arg[2];
+
+
+static void set_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	called = true;
+	arg[0] = args[0];
+	arg[1] = args[1];
+}
+
+
+static void volt_q_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)args;
+	called = true;
+	scpi_resp_float(ctx, 7.5f);
+	scpi_resp_end(ctx);
+}
+
+
+static const SCPI_limits_t volt_lim = SCPI_LIMITS_FLOAT(0, 30, 5);
+static const SCPI_limits_t count_lim = SCPI_LIMITS_INT(1, 100, 10);
+static const SCPI_limits_t big_lim = SCPI_LIMITS_INT64(-5000000000LL, 5000000000LL, 0);
+static const SCPI_limits_t offs_lim = SCPI_LIMITS_FIXED(-1000, 1000, 250);
+
+static const SCPI_param_ext_t volt_ext = {
+	.limits = {&volt_lim},
+};
+
+static const SCPI_param_ext_t count_ext = {
+	.limits = {&count_lim, &big_lim},
+};
+
+static const SCPI_param_ext_t offs_ext = {
+	.fixed = SCPI_FIXED_DEC(3),
+	.limits = {&offs_lim},
+};
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"VOLTage"},
+		.params = {SCPI_DT_FLOAT},
+		.callback = set_cb,
+		.ext = &volt_ext,
+	},
+	{
+		.levels = {"VOLTage?"},
+		.callback = volt_q_cb,
+		.ext = &volt_ext, // answers VOLT? MIN|MAX|DEF
+	},
+	{
+		.levels = {"COUNt"},
+		.params = {SCPI_DT_INT, SCPI_DT_INT64},
+		.callback = set_cb,
+		.ext = &count_ext,
+	},
+	{
+		.levels = {"TIMe"},
+		.params = {SCPI_DT_DOUBLE, SCPI_DT_FLOAT},
+		.callback = set_cb,
+	},
+	{
+		.levels = {"OFFSet"},
+		.params = {SCPI_DT_FIXED},
+		.callback = set_cb,
+		.ext = &offs_ext,
+	},
+	{
+		.levels = {"OFFSet?"},
+		.callback = volt_q_cb,
+		.ext = &offs_ext,
+	},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	double value[2]; // FLOAT, DOUBLE, or the integer value
+	int16_t error;
+} limit_case_t;
+
+static const limit_case_t cases[] = {
+	{"VOLT 12.5\n", {12.5}},
+	{"VOLT 0\n", {0}},
+	{"VOLT 30\n", {30}},
+	{"VOLT MIN\n", {0}},
+	{"VOLT max\n", {30}},
+	{"VOLT MAXimum\n", {30}},
+	{"VOLT DEF\n", {5}},
+	{"VOLT default\n", {5}},
+	{"COUN 100,-5000000000\n", {100, -5000000000.0}},
+	{"COUN MIN,MAX\n", {1, 5000000000.0}},
+	{"COUN DEF,DEF\n", {10, 0}},
+	{"TIM INF,NINF\n", {1.0 / 0.0, -1.0 / 0.0}},
+	{"TIM 1e300,ninf\n", {1e300, -1.0 / 0.0}},
+	{"OFFS -1\n", {-1000}},
+	{"OFFS 0.9995\n", {1000}}, // rounded, then checked
+	{"OFFS DEF\n", {250}},
+
+	{"VOLT 30.001\n", {0}, E_EXE_DATA_OUT_OF_RANGE},
+	{"VOLT -1e-30\n", {0}, E_EXE_DATA_OUT_OF_RANGE},
+	{"VOLT INF\n", {0}, E_EXE_DATA_OUT_OF_RANGE},
+	{"VOLT MAXI\n", {0}, E_CMD_NUMERIC_DATA_ERROR}, // not a form of MAXimum
+	{"COUN 0,0\n", {0}, E_EXE_DATA_OUT_OF_RANGE},
+	{"COUN 1,5000000001\n", {0}, E_EXE_DATA_OUT_OF_RANGE},
+	{"COUN INF,0\n", {0}, E_EXE_DATA_OUT_OF_RANGE}, // integers are finite
+	{"TIM MIN,0\n", {0}, E_EXE_ILLEGAL_PARAMETER_VALUE}, // no limits
+	{"OFFS 1.0005\n", {0}, E_EXE_DATA_OUT_OF_RANGE},
+	{"OFFS NINF\n", {0}, E_EXE_DATA_OUT_OF_RANGE},
+};
+
+
+/** Value of a param as a double (0 past the params of the command) */
+static double arg_number(const char *msg, uint8_t i)
+{
+	if (strncmp(msg, "VOLT", 4) == 0) return i ? 0 : arg[i].FLOAT;
+	if (strncmp(msg, "TIM", 3) == 0) return i ? arg[i].FLOAT : arg[i].DOUBLE;
+	if (strncmp(msg, "OFFS", 4) == 0) return i ? 0 : arg[i].FIXED;
+
+	return i ? (double) arg[i].INT64 : arg[i].INT; // COUN
+}
+
+
+static void test_cases(void)
+{
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const limit_case_t *c = &cases[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			called = false;
+			memset(arg, 0, sizeof(arg));
+			test_feed_split(&session, c->msg, strlen(c->msg), at);
+
+			CHECK_EQ(test_errors(&session), c->error);
+			CHECK_EQ(called, c->error == 0);
+			if (!called) continue;
+
+			for (uint8_t a = 0; a < 2; a++) {
+				CHECK(arg_number(c->msg, a) == c->value[a]);
+			}
+		}
+	}
+}
+
+
+typedef struct {
+	const char *msg;
+	const char *out;
+	int16_t error;
+} query_case_t;
+
+static const query_case_t queries[] = {
+	{"VOLT?\n", "7.5E+00\n"}, // the callback
+	{"VOLT? MIN\n", "0.0E+00\n"},
+	{"VOLT? MAX\n", "3.0E+01\n"},
+	{"volt? def\n", "5.0E+00\n"},
+	{"VOLT? MAX;VOLT? MIN\n", "3.0E+01\n0.0E+00\n"},
+	{"OFFS? MAX\n", "1.0\n"},
+	{"OFFS? DEF\n", "0.25\n"},
+	{"VOLT? FOO\n", "", E_EXE_ILLEGAL_PARAMETER_VALUE},
+	{"VOLT? INF\n", "", E_EXE_ILLEGAL_PARAMETER_VALUE},
+};
+
+
+static void test_queries(void)
+{
+	for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+		const query_case_t *c = &queries[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			called = false;
+			test_out_reset();
+			test_feed_split(&session, c->msg, strlen(c->msg), at);
+
+			CHECK(strcmp(test_out, c->out) == 0);
+			CHECK_EQ(test_errors(&session), c->error);
+		}
+	}
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	test_cases();
+	test_queries();
+
+	return test_done("limits");
+}
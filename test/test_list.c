@@ -0,0 +1,225 @@
+#include "test.h"
+
+// LIST params - elements passed on one by one, collected in the command's buffer
+// (in batches when it fills up); units and limits of each element.
+
+static scpi_ctx_t session;
+
+#define MAX_ELEMS 16
+
+static bool called;
+static int32_t arg_chan;
+static uint32_t arg_len;
+
+static float values[MAX_ELEMS]; // from list_callback
+static uint32_t values_len;
+static bool values_ordered;
+
+static float batched[MAX_ELEMS]; // from list_buf_callback
+static uint32_t batched_len;
+static int batches;
+
+
+static void value_cb(scpi_ctx_t *ctx, const SCPI_argval_t *value, uint32_t index)
+{
+	(void)ctx;
+	if (index != values_len) values_ordered = false;
+	if (values_len < MAX_ELEMS) values[values_len] = value->FLOAT;
+	values_len++;
+}
+
+
+static void batch_cb(scpi_ctx_t *ctx, const void *buf, uint32_t count, uint32_t index)
+{
+	(void)ctx;
+	CHECK_EQ(index, batched_len);
+
+	for (uint32_t i = 0; i < count && index + i < MAX_ELEMS; i++) {
+		batched[index + i] = ((const float *) buf)[i];
+	}
+	batched_len += count;
+	batches++;
+}
+
+
+static void volt_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	called = true;
+	arg_chan = args[0].INT;
+	arg_len = args[1].LIST_LEN;
+	CHECK_EQ(scpi_arg_len(ctx, 1), arg_len);
+}
+
+
+static void count_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	called = true;
+	arg_len = args[0].LIST_LEN;
+}
+
+
+static float volt_buf[4];
+static int32_t count_buf[4];
+
+static const SCPI_limits_t volt_lim = SCPI_LIMITS_FLOAT(0, 30, 0);
+
+static const SCPI_param_ext_t volt_ext = {
+	.units = {0, SCPI_UNIT_V},
+	.limits = {NULL, &volt_lim},
+	.list_type = SCPI_DT_FLOAT,
+	.list_callback = value_cb,
+	.list_buf = volt_buf,
+	.list_buf_len = 4,
+	.list_buf_callback = batch_cb,
+};
+
+static const SCPI_param_ext_t count_ext = {
+	.list_type = SCPI_DT_INT,
+	.list_buf = count_buf,
+	.list_buf_len = 4,
+};
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"LIST", "VOLTage"},
+		.params = {SCPI_DT_INT, SCPI_DT_LIST},
+		.callback = volt_cb,
+		.ext = &volt_ext,
+	},
+	{
+		.levels = {"LIST", "COUNt"},
+		.params = {SCPI_DT_LIST},
+		.callback = count_cb,
+		.ext = &count_ext,
+	},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	int32_t chan;
+	uint32_t len;
+	int batches;
+	float values[MAX_ELEMS];
+} list_case_t;
+
+static const list_case_t cases[] = {
+	{"LIST:VOLT 1,5\n", 1, 1, 1, {5}},
+	{"LIST:VOLT 2,0.5,2V,3mV,30\n", 2, 4, 1, {0.5f, 2, 0.003f, 30}},
+	{"list:volt 3 , 1 ,2, 3 ,4,5\n", 3, 5, 2, {1, 2, 3, 4, 5}},
+	{"LIST:VOLT 4,1,2,3,4,5,6,7,8,9\n", 4, 9, 3, {1, 2, 3, 4, 5, 6, 7, 8, 9}},
+	{"LIST:VOLT 5,MIN,MAX,1e1\n", 5, 3, 1, {0, 30, 10}},
+};
+
+typedef struct {
+	const char *msg;
+	int16_t error;
+} list_error_t;
+
+static const list_error_t invalid[] = {
+	{"LIST:VOLT 1,31\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"LIST:VOLT 1,1,-1\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"LIST:VOLT 1,1,,2\n", E_CMD_SYNTAX_ERROR},
+	{"LIST:VOLT 1,2A\n", E_CMD_INVALID_SUFFIX},
+	{"LIST:VOLT 1,abc\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"LIST:VOLT 1\n", E_CMD_MISSING_PARAMETER},
+	{"LIST:COUN 1,2,3,4,5\n", E_EXE_TOO_MUCH_DATA}, // no list_buf_callback
+	{"LIST:COUN 1,2..5\n", E_CMD_NUMERIC_DATA_ERROR},
+};
+
+
+static void run_split(const char *msg, size_t at)
+{
+	called = false;
+	arg_chan = 0;
+	arg_len = 0;
+	values_len = 0;
+	values_ordered = true;
+	batched_len = 0;
+	batches = 0;
+	test_feed_split(&session, msg, strlen(msg), at);
+}
+
+
+static void test_valid(void)
+{
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const list_case_t *c = &cases[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK_EQ(test_errors(&session), 0);
+			CHECK(called);
+			CHECK_EQ(arg_chan, c->chan);
+			CHECK_EQ(arg_len, c->len);
+
+			// each element, and the buffer in batches of up to 4
+			CHECK(values_ordered);
+			CHECK_EQ(values_len, c->len);
+			CHECK_EQ(batched_len, c->len);
+			CHECK_EQ(batches, c->batches);
+			CHECK(memcmp(values, c->values, c->len * sizeof(float)) == 0);
+			CHECK(memcmp(batched, c->values, c->len * sizeof(float)) == 0);
+		}
+	}
+}
+
+
+static void test_invalid(void)
+{
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		const list_error_t *c = &invalid[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(!called);
+			CHECK_EQ(test_errors(&session), c->error);
+
+			// the next list starts from the beginning
+			run_split("LIST:COUN 4,3,2,1\n", 0);
+			CHECK(called);
+			CHECK_EQ(arg_len, 4);
+			CHECK(count_buf[0] == 4 && count_buf[3] == 1);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+}
+
+
+/** Lists in a compound message, each collected anew */
+static void test_compound(void)
+{
+	static const char *msg = "LIST:COUN 7,8;COUN 9;:LIST:VOLT 6,1,2,3,4,5,6\n";
+	test_case = msg;
+
+	for (size_t at = 0; at <= strlen(msg); at++) {
+		run_split(msg, at);
+
+		CHECK_EQ(test_errors(&session), 0);
+		CHECK(called);
+		CHECK_EQ(arg_len, 6);
+		CHECK_EQ(batched_len, 6);
+		CHECK_EQ(batches, 2);
+		CHECK_EQ(count_buf[0], 9);
+		CHECK_EQ(count_buf[1], 8); // not overwritten by the shorter list
+	}
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	test_valid();
+	test_invalid();
+	test_compound();
+
+	return test_done("list");
+}
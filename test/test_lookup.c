@@ -0,0 +1,143 @@
+#include "test.h"
+
+// Command header lookup - short and long forms, user commands overriding built-ins,
+// semicolons, unknown headers. Built with the automaton, with the linear scan
+// (SCPI_CMD_TRIE_NODES=0) and with an automaton too small for the commands (TEST_SMALL).
+
+static scpi_ctx_t session;
+
+static int called[8];
+static int called_n;
+
+
+#define CB(n) static void cb_##n(scpi_ctx_t *ctx, const SCPI_argval_t *args) \
+	{ (void)ctx; (void)args; if (called_n < 8) called[called_n++] = n; }
+
+CB(1) CB(2) CB(3) CB(4) CB(5) CB(6) CB(7) CB(8) CB(9)
+
+const SCPI_command_t scpi_commands[] = {
+	{.levels = {"SOURce", "VOLTage"}, .params = {SCPI_DT_FLOAT}, .callback = cb_1},
+	{.levels = {"SOURce", "CURRent"}, .params = {SCPI_DT_FLOAT}, .callback = cb_2},
+	{.levels = {"SOURce", "VOLTage", "LIMit"}, .params = {SCPI_DT_FLOAT}, .callback = cb_3},
+	{.levels = {"MEASure1", "VOLTage?"}, .callback = cb_4},
+	{.levels = {"*IDN?"}, .callback = cb_5}, // overrides the built-in
+	{.levels = {"SYST", "BEEP"}, .callback = cb_6}, // next to the built-in SYSTem
+	{.levels = {"SYSTem", "ERRor", "COUNt?"}, .callback = cb_7}, // overrides the built-in
+	{.levels = {"OUTPut"}, .callback = cb_8},
+	{.levels = {"OUTPut", "STATe"}, .callback = cb_9},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	int called[3]; // user callbacks, in order
+	const char *out; // response of a built-in
+	int16_t error;
+} lookup_case_t;
+
+static const lookup_case_t cases[] __attribute__((unused)) = { // not run with TEST_SMALL
+	{"SOUR:VOLT 1\n", {1}},
+	{"source:voltage 1\n", {1}},
+	{"SoUrCe:VoLt 1\n", {1}},
+	{":SOURCE:VOLTAGE:LIMIT 2\n", {3}},
+	{"SOUR:VOLT:LIM 2\n", {3}},
+	{"MEAS1:VOLT?\n", {4}},
+	{"measure1:voltage?\n", {4}},
+	{"*IDN?\n", {5}},
+	{"*idn?\n", {5}},
+	{"SYST:BEEP\n", {6}},
+	{"SYST:ERR:COUN?\n", {7}},
+	{"SYSTEM:ERROR:COUNT?\n", {7}},
+	{"OUTP\n", {8}},
+	{"OUTPUT:STAT\n", {9}},
+
+	// built-ins
+	{"*SRE 4;*SRE?\n", {0}, "4\n"},
+	{"STAT:OPER:ENAB 5;ENAB?\n", {0}, "5\n"},
+	{"SYST:ERR?\n", {0}, "0,\"No error\"\n"},
+	{"system:error:next?\n", {0}, "0,\"No error\"\n"},
+
+	// semicolons
+	{"SOUR:VOLT 1;CURR 2\n", {1, 2}},
+	{"SOUR:VOLT 1;VOLT:LIM 3;:OUTP\n", {1, 3, 8}},
+	{"OUTP;OUTP:STAT\n", {8, 9}},
+	{"OUTP:STAT;STAT\n", {9, 9}},
+	{"OUTP;*IDN?\n", {8, 5}}, // no colon - nothing kept
+
+	// unknown
+	{"FOO\n", {0}, NULL, E_CMD_UNDEFINED_HEADER},
+	{"SOUR:FOO 1\n", {0}, NULL, E_CMD_UNDEFINED_HEADER},
+	{"SOU:VOLT 1\n", {0}, NULL, E_CMD_UNDEFINED_HEADER},
+	{"SOURC:VOLT 1\n", {0}, NULL, E_CMD_UNDEFINED_HEADER},
+	{"SOURCES:VOLT 1\n", {0}, NULL, E_CMD_UNDEFINED_HEADER},
+	{"MEAS:VOLT?\n", {0}, NULL, E_CMD_UNDEFINED_HEADER},
+	{"SOUR:VOLT:LIM:X 1\n", {0}, NULL, E_CMD_UNDEFINED_HEADER},
+	{"OUTP:STAT:FOO\n", {0}, NULL, E_CMD_UNDEFINED_HEADER},
+	{"SYSTEM:BEEP\n", {0}, NULL, E_CMD_UNDEFINED_HEADER}, // SYST has no long form
+	{"SOUR:VOLT 1;FOO 2\n", {1}, NULL, E_CMD_UNDEFINED_HEADER},
+};
+
+
+static void check_case(const lookup_case_t *c, size_t at)
+{
+	called_n = 0;
+	test_out_reset();
+	test_feed_split(&session, c->msg, strlen(c->msg), at);
+
+	int n = 0;
+	while (n < 3 && c->called[n] != 0) n++;
+
+	CHECK_EQ(called_n, n);
+	for (int i = 0; i < n && i < called_n; i++) {
+		CHECK_EQ(called[i], c->called[i]);
+	}
+
+	CHECK(strcmp(test_out, c->out ? c->out : "") == 0);
+	CHECK_EQ(test_errors(&session), c->error);
+}
+
+
+int main(void)
+{
+#ifdef TEST_SMALL
+	test_case = "too small";
+
+	CHECK(!scpi_init());
+	CHECK(!scpi_cmd_index_ok());
+	CHECK_EQ(scpi_cmd_index_nodes(), SCPI_CMD_TRIE_NODES);
+
+	// no command is found, not even the ones that fit
+	scpi_ctx_init(&session, NULL);
+	called_n = 0;
+	test_feed(&session, "SOUR:VOLT 1\n", 12, 12);
+	CHECK_EQ(called_n, 0);
+	CHECK_EQ(test_errors(&session), E_DEV_SYSTEM_ERROR);
+
+	return test_done("lookup/16");
+#else
+
+#if SCPI_CMD_TRIE_NODES > 0
+	test_case = "no scpi_init()";
+
+	scpi_ctx_init(&session, NULL);
+	test_feed(&session, "*IDN?\n", 6, 6);
+	CHECK_EQ(called_n, 0);
+	CHECK_EQ(test_errors(&session), E_DEV_SYSTEM_ERROR);
+#endif
+
+	CHECK(scpi_init());
+	CHECK(scpi_cmd_index_ok());
+	scpi_ctx_init(&session, NULL);
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		test_case = cases[i].msg;
+
+		for (size_t at = 0; at <= strlen(cases[i].msg); at++) {
+			check_case(&cases[i], at);
+		}
+	}
+
+	return test_done((SCPI_CMD_TRIE_NODES > 0) ? "lookup" : "lookup/lin");
+#endif
+}
@@ -0,0 +1,501 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include "test.h"
+
+// Numeric arguments - FLOAT and DOUBLE correctly rounded (compared with the C library),
+// INT and INT64 with range checks and the #H, #Q, #B formats, FIXED in Q and decimal formats,
+// unit suffixes with metric prefixes.
+
+static scpi_ctx_t session;
+
+static bool called;
+static float arg_float;
+static double arg_double;
+static int32_t arg_int;
+static int64_t arg_int64;
+static int32_t arg_fixed[2];
+static SCPI_argval_t arg_value;
+static SCPI_unit_t arg_unit;
+
+
+static void float_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	called = true;
+	arg_float = args[0].FLOAT;
+	arg_double = args[1].DOUBLE;
+}
+
+
+static void int_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	called = true;
+	arg_int = args[0].INT;
+	arg_int64 = args[1].INT64;
+}
+
+
+static void fixed_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	called = true;
+	arg_fixed[0] = args[0].FIXED;
+	arg_fixed[1] = args[1].FIXED;
+}
+
+
+static void unit_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	called = true;
+	arg_value = args[0];
+	arg_unit = scpi_arg_unit(ctx, 0);
+}
+
+
+static const SCPI_param_ext_t q16_ext = {
+	.fixed = SCPI_FIXED_Q(16),
+};
+
+static const SCPI_param_ext_t micro_ext = {
+	.fixed = SCPI_FIXED_DEC(6),
+};
+
+static const SCPI_param_ext_t volt_ext = {
+	.units = {SCPI_UNIT_V},
+};
+
+static const SCPI_param_ext_t freq_ext = {
+	.units = {SCPI_UNIT_HZ},
+};
+
+static const SCPI_param_ext_t res_ext = {
+	.units = {SCPI_UNIT_OHM | SCPI_UNIT_PREFIX},
+};
+
+static const SCPI_param_ext_t volt_micro_ext = {
+	.fixed = SCPI_FIXED_DEC(6),
+	.units = {SCPI_UNIT_V},
+};
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"FLOat"},
+		.params = {SCPI_DT_FLOAT, SCPI_DT_DOUBLE},
+		.callback = float_cb,
+	},
+	{
+		.levels = {"INTeger"},
+		.params = {SCPI_DT_INT, SCPI_DT_INT64},
+		.callback = int_cb,
+	},
+	{
+		.levels = {"FIXed", "Q"},
+		.params = {SCPI_DT_FIXED, SCPI_DT_FIXED},
+		.callback = fixed_cb,
+		.ext = &q16_ext,
+	},
+	{
+		.levels = {"FIXed", "MICRo"},
+		.params = {SCPI_DT_FIXED, SCPI_DT_FIXED},
+		.callback = fixed_cb,
+		.ext = &micro_ext,
+	},
+	{
+		.levels = {"UNIT", "VOLTage"},
+		.params = {SCPI_DT_FLOAT},
+		.callback = unit_cb,
+		.ext = &volt_ext,
+	},
+	{
+		.levels = {"UNIT", "FREQuency"},
+		.params = {SCPI_DT_DOUBLE},
+		.callback = unit_cb,
+		.ext = &freq_ext,
+	},
+	{
+		.levels = {"UNIT", "RESistance"},
+		.params = {SCPI_DT_INT},
+		.callback = unit_cb,
+		.ext = &res_ext,
+	},
+	{
+		.levels = {"UNIT", "FIXed"},
+		.params = {SCPI_DT_FIXED},
+		.callback = unit_cb,
+		.ext = &volt_micro_ext,
+	},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	int16_t error;
+} num_error_t;
+
+
+static void run_split(const char *msg, size_t at)
+{
+	called = false;
+	test_feed_split(&session, msg, strlen(msg), at);
+}
+
+
+/** Check that a message is refused with an error, at every split */
+static void check_invalid(const num_error_t *cases, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		test_case = cases[i].msg;
+
+		for (size_t at = 0; at <= strlen(cases[i].msg); at++) {
+			run_split(cases[i].msg, at);
+
+			CHECK(!called);
+			CHECK_EQ(test_errors(&session), cases[i].error);
+		}
+	}
+}
+
+
+// ---- FLOAT, DOUBLE ----
+
+static const char *const floats[] = {
+	"0", "-0", "1", "+7", "1.5", "-0.25", ".5", "5.", "1e3", "1E-3", "-2.5e+2",
+	"0.1", "3.14159265358979323846", "123456789", "16777217", "9007199254740993",
+	"1.17549435e-38", "3.4028234e38", "1.4e-45", "0.000000000000000000000001",
+	"000000000000000000000000000012.5", "2.2250738585072014e-308",
+};
+
+static const num_error_t float_invalid[] = {
+	{"FLO 1.2.3,1\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"FLO 1,--1\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"FLO +,1\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"FLO .,1\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"FLO 1e40,1\n", E_EXE_DATA_OUT_OF_RANGE}, // fits DOUBLE only
+	{"FLO 1,1e400\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"FLO 1,1e32001\n", E_CMD_EXPONENT_TOO_LARGE},
+};
+
+
+static void test_float(void)
+{
+	static char msg[200];
+
+	for (size_t i = 0; i < sizeof(floats) / sizeof(floats[0]); i++) {
+		const float f = strtof(floats[i], NULL);
+		const double d = strtod(floats[i], NULL);
+
+		sprintf(msg, "FLOAT %s,%s\n", floats[i], floats[i]);
+		test_case = msg;
+
+		for (size_t at = 0; at <= strlen(msg); at++) {
+			run_split(msg, at);
+
+			CHECK(called);
+			CHECK(memcmp(&arg_float, &f, sizeof(f)) == 0);
+			CHECK(memcmp(&arg_double, &d, sizeof(d)) == 0);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+
+	check_invalid(float_invalid, sizeof(float_invalid) / sizeof(float_invalid[0]));
+}
+
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+
+/** Random decimal strings, all the exponent range - same result as strtod() / strtof() */
+static void test_float_random(void)
+{
+	char str[64];
+	int bad = 0;
+
+	test_case = "random";
+
+	for (int i = 0; i < 50000; i++) {
+		char *p = str;
+		const uint32_t digits = 1 + rnd(25);
+		const uint32_t point = rnd(digits + 1);
+
+		if (rnd(2)) *p++ = '-';
+		for (uint32_t d = 0; d < digits; d++) {
+			if (d == point) *p++ = '.';
+			*p++ = (char)('0' + rnd(10));
+		}
+		if (rnd(4)) p += sprintf(p, "e%d", (int) rnd(700) - 350);
+		*p = 0;
+
+		double d = 0;
+		const double d_ref = strtod(str, NULL);
+		const scpi_num_status_t st = scpi_parse_double(str, &d);
+
+		if (isinf(d_ref)) {
+			if (st != SCPI_NUM_RANGE) bad++;
+		} else if (st != SCPI_NUM_OK || memcmp(&d, &d_ref, sizeof(d)) != 0) {
+			bad++;
+		}
+
+		float f = 0;
+		const float f_ref = strtof(str, NULL);
+		const scpi_num_status_t fst = scpi_parse_float(str, &f);
+
+		if (isinf(f_ref)) {
+			if (fst != SCPI_NUM_RANGE) bad++;
+		} else if (fst != SCPI_NUM_OK || memcmp(&f, &f_ref, sizeof(f)) != 0) {
+			bad++;
+		}
+
+		if (bad == 1) {
+			printf("      '%s'\n", str);
+			bad++;
+		}
+	}
+
+	CHECK_EQ(bad, 0);
+}
+
+
+// ---- INT, INT64 ----
+
+typedef struct {
+	const char *msg;
+	int32_t i;
+	int64_t i64;
+} int_case_t;
+
+static const int_case_t ints[] = {
+	{"INT 0,0\n", 0, 0},
+	{"INT -17,+17\n", -17, 17},
+	{"INT 2147483647,9223372036854775807\n", INT32_MAX, INT64_MAX},
+	{"INT -2147483648,-9223372036854775808\n", INT32_MIN, INT64_MIN},
+	{"INT 1.5,-2.5\n", 2, -3}, // rounded half away from zero
+	{"INT 1.49,-0.4\n", 1, 0},
+	{"INT 1.5E3,12e17\n", 1500, 1200000000000000000LL},
+	{"INT 000000000000000000000042,1e-30\n", 42, 0},
+	{"INT #HFF,#h7fffffffffffffff\n", 255, INT64_MAX},
+	{"INT #HFFFFFFFF,#HFFFFFFFF\n", -1, 0xFFFFFFFFLL}, // a bit pattern of the type
+	{"INT #Q17,#q777\n", 15, 511},
+	{"INT #B101,#HFFFFFFFFFFFFFFFF\n", 5, -1},
+	{"INT #H80000000,#H8000000000000000\n", INT32_MIN, INT64_MIN},
+};
+
+static const num_error_t int_invalid[] = {
+	{"INT 2147483648,0\n", E_CMD_TOO_MANY_DIGITS},
+	{"INT -2147483649,0\n", E_CMD_TOO_MANY_DIGITS},
+	{"INT 0,9223372036854775808\n", E_CMD_TOO_MANY_DIGITS},
+	{"INT 0,12345678901234567890123\n", E_CMD_TOO_MANY_DIGITS},
+	{"INT 3e9,0\n", E_CMD_EXPONENT_TOO_LARGE},
+	{"INT 0,1e19\n", E_CMD_EXPONENT_TOO_LARGE},
+	{"INT #H100000000,0\n", E_CMD_TOO_MANY_DIGITS},
+	{"INT #Q8,0\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"INT #B2,0\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"INT #HG,0\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"INT #H,0\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"INT #X1,0\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"INT 1.2.3,0\n", E_CMD_NUMERIC_DATA_ERROR},
+	{"INT 1,2*3\n", E_CMD_INVALID_CHARACTER_IN_NUMBER},
+};
+
+
+static void test_int(void)
+{
+	for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+		const int_case_t *c = &ints[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(called);
+			CHECK_EQ(arg_int, c->i);
+			CHECK(arg_int64 == c->i64);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+
+	check_invalid(int_invalid, sizeof(int_invalid) / sizeof(int_invalid[0]));
+
+	// hex masks in the status commands
+	test_case = "*ESE #H";
+	test_out_reset();
+	test_feed(&session, "*ESE #H24;*ESE?;*SRE #B110000;*SRE?\n", 36, 5);
+	CHECK(strcmp(test_out, "36\n48\n") == 0);
+	CHECK_EQ(test_errors(&session), 0);
+}
+
+
+// ---- FIXED ----
+
+typedef struct {
+	const char *msg;
+	int32_t value[2];
+} fixed_case_t;
+
+static const fixed_case_t fixeds[] = {
+	{"FIX:Q 1.5,-0.25\n", {98304, -16384}},
+	{"FIX:Q 0,-0\n", {0, 0}},
+	{"FIX:Q 2.5e2,1e-5\n", {16384000, 1}}, // 0.65536 rounded up
+	{"FIX:Q 0.0000076,-0.0000077\n", {0, -1}}, // 0.498, -0.505
+	{"FIX:Q 32767.99998,-32768\n", {INT32_MAX, INT32_MIN}},
+	{"FIX:Q 0.1,3.14159265358979323846264338\n", {6554, 205887}},
+	{"FIX:MICR 1.5,-0.0000005\n", {1500000, -1}},
+	{"FIX:MICR 2147.483647,-2147.483648\n", {INT32_MAX, INT32_MIN}},
+	{"FIX:MICR 1e-7,12E-4\n", {0, 1200}},
+	{"FIX:MICR 0.000001,2e3\n", {1, 2000000000}},
+};
+
+static const num_error_t fixed_invalid[] = {
+	{"FIX:Q 32768,0\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"FIX:Q 0,-32768.00001\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"FIX:MICR 2147.4836475,0\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"FIX:MICR 1e5,0\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"FIX:MICR 1e40000,0\n", E_CMD_EXPONENT_TOO_LARGE},
+	{"FIX:Q 1..5,0\n", E_CMD_NUMERIC_DATA_ERROR},
+};
+
+
+/** Round half away from zero (without libm) */
+static int32_t round_away(double x)
+{
+	return (x < 0) ? (int32_t) -(int64_t)(-x + 0.5) : (int32_t)(int64_t)(x + 0.5);
+}
+
+
+static void test_fixed(void)
+{
+	for (size_t i = 0; i < sizeof(fixeds) / sizeof(fixeds[0]); i++) {
+		const fixed_case_t *c = &fixeds[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(called);
+			CHECK_EQ(arg_fixed[0], c->value[0]);
+			CHECK_EQ(arg_fixed[1], c->value[1]);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+
+	check_invalid(fixed_invalid, sizeof(fixed_invalid) / sizeof(fixed_invalid[0]));
+
+	// Q formats against the double result, for all fraction bits
+	int32_t v;
+	test_case = "Q formats";
+
+	for (uint8_t q = 0; q <= 31; q++) {
+		CHECK(scpi_parse_fixed("0.7", SCPI_FIXED_Q(q), &v) == SCPI_NUM_OK);
+		CHECK_EQ(v, round_away(0.7 * (double)(1ULL << q)));
+
+		CHECK(scpi_parse_fixed("-0.3", SCPI_FIXED_Q(q), &v) == SCPI_NUM_OK);
+		CHECK_EQ(v, round_away(-0.3 * (double)(1ULL << q)));
+	}
+
+	CHECK(scpi_parse_fixed("1", SCPI_FIXED_Q(31), &v) == SCPI_NUM_RANGE);
+	CHECK(scpi_parse_fixed("-1", SCPI_FIXED_Q(31), &v) == SCPI_NUM_OK && v == INT32_MIN);
+	CHECK(scpi_parse_fixed("2.147483647", SCPI_FIXED_DEC(9), &v) == SCPI_NUM_OK && v == INT32_MAX);
+}
+
+
+// ---- unit suffixes ----
+
+typedef struct {
+	const char *msg;
+	const char *value; // the number with the prefix as an exponent (FLOAT, DOUBLE), or INT, FIXED
+	SCPI_unit_t unit;
+} unit_case_t;
+
+static const unit_case_t units[] = {
+	{"UNIT:VOLT 2V\n", "2", SCPI_UNIT_V},
+	{"UNIT:VOLT 3.3\n", "3.3", SCPI_UNIT_NONE},
+	{"UNIT:VOLT 1.5mV\n", "1.5e-3", SCPI_UNIT_V},
+	{"UNIT:VOLT 0.1mv\n", "0.1e-3", SCPI_UNIT_V}, // no multiply - same as the text with an exponent
+	{"UNIT:VOLT 5uV\n", "5e-6", SCPI_UNIT_V},
+	{"UNIT:VOLT 1e3MV\n", "1e0", SCPI_UNIT_V},
+	{"UNIT:VOLT -2.5E-2KV\n", "-2.5e1", SCPI_UNIT_V},
+	{"UNIT:VOLT MAX\n", NULL, SCPI_UNIT_NONE}, // keyword, not a suffix - no limits
+	{"UNIT:FREQ 10MHZ\n", "10e6", SCPI_UNIT_HZ}, // MHZ is mega
+	{"UNIT:FREQ 1.5kHz\n", "1.5e3", SCPI_UNIT_HZ},
+	{"UNIT:FREQ 2GHZ\n", "2e9", SCPI_UNIT_HZ},
+	{"UNIT:FREQ 0.3HZ\n", "0.3", SCPI_UNIT_HZ},
+	{"UNIT:RES 10K\n", "10000", SCPI_UNIT_PREFIX},
+	{"UNIT:RES 1MOHM\n", "1000000", SCPI_UNIT_OHM}, // MOHM is mega
+	{"UNIT:RES 4.7kohm\n", "4700", SCPI_UNIT_OHM},
+	{"UNIT:RES 220\n", "220", SCPI_UNIT_NONE},
+	{"UNIT:FIX 1.5mV\n", "1500", SCPI_UNIT_V},
+	{"UNIT:FIX 2KV\n", "2000000000", SCPI_UNIT_V},
+};
+
+static const num_error_t unit_invalid[] = {
+	{"UNIT:VOLT 1A\n", E_CMD_INVALID_SUFFIX}, // not allowed for this param
+	{"UNIT:VOLT 1XV\n", E_CMD_INVALID_SUFFIX},
+	{"UNIT:VOLT 1VOLTS\n", E_CMD_INVALID_SUFFIX},
+	{"UNIT:VOLT 1ABCDEFGHIJKLMNOP\n", E_CMD_INVALID_SUFFIX},
+	{"UNIT:FREQ 1K\n", E_CMD_INVALID_SUFFIX}, // no prefix alone
+	{"UNIT:RES 1V\n", E_CMD_INVALID_SUFFIX},
+	{"UNIT:FIX 3KV\n", E_EXE_DATA_OUT_OF_RANGE},
+	{"FLO 1V,1\n", E_CMD_SUFFIX_NOT_ALLOWED},
+	{"INT 1,2K\n", E_CMD_SUFFIX_NOT_ALLOWED},
+};
+
+
+static void test_units(void)
+{
+	for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+		const unit_case_t *c = &units[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			memset(&arg_value, 0, sizeof(arg_value));
+			arg_unit = (SCPI_unit_t) -1;
+			run_split(c->msg, at);
+
+			if (c->value == NULL) {
+				CHECK(!called);
+				CHECK_EQ(test_errors(&session), E_EXE_ILLEGAL_PARAMETER_VALUE);
+				continue;
+			}
+
+			CHECK(called);
+			CHECK_EQ(arg_unit, c->unit);
+
+			if (strncmp(c->msg, "UNIT:VOLT", 9) == 0) {
+				const float f = strtof(c->value, NULL);
+				CHECK(memcmp(&arg_value.FLOAT, &f, sizeof(f)) == 0);
+			} else if (strncmp(c->msg, "UNIT:FREQ", 9) == 0) {
+				const double d = strtod(c->value, NULL);
+				CHECK(memcmp(&arg_value.DOUBLE, &d, sizeof(d)) == 0);
+			} else {
+				CHECK_EQ(arg_value.INT, strtol(c->value, NULL, 10));
+			}
+
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+
+	check_invalid(unit_invalid, sizeof(unit_invalid) / sizeof(unit_invalid[0]));
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	test_float();
+	test_float_random();
+	test_int();
+	test_fixed();
+	test_units();
+
+	return test_done("number");
+}
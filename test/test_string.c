@@ -0,0 +1,212 @@
+#include "test.h"
+
+// Streamed strings (SCPI_DT_STRING_STREAM), escapes cut between pieces of input.
+
+static scpi_ctx_t session;
+
+static char got[256];
+static size_t got_len;
+static int pieces;
+
+static bool called;
+static uint32_t arg_len;
+static int32_t arg_int;
+
+static char sbuf[32];
+
+
+static void str_cb(scpi_ctx_t *ctx, const char *data, size_t len, uint32_t offset)
+{
+	(void)ctx;
+	CHECK_EQ(offset, got_len);
+
+	if (got_len + len <= sizeof(got)) {
+		memcpy(&got[got_len], data, len);
+	}
+	got_len += len;
+	pieces++;
+}
+
+
+static void text_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	(void)ctx;
+	called = true;
+	arg_len = args[0].STRING_LEN;
+}
+
+
+static void text_int_cb(scpi_ctx_t *ctx, const SCPI_argval_t *args)
+{
+	text_cb(ctx, args);
+	arg_int = args[1].INT;
+}
+
+
+static const SCPI_param_ext_t text_ext = {
+	.string_callback = str_cb,
+	.string_buf = sbuf,
+	.string_buf_len = sizeof(sbuf),
+};
+
+static const SCPI_param_ext_t stream_ext = {
+	.string_callback = str_cb,
+};
+
+const SCPI_command_t scpi_commands[] = {
+	{
+		.levels = {"TEXT"},
+		.params = {SCPI_DT_STRING_STREAM},
+		.callback = text_cb,
+		.ext = &text_ext,
+	},
+	{
+		.levels = {"TEXT", "STReam"},
+		.params = {SCPI_DT_STRING_STREAM, SCPI_DT_INT},
+		.callback = text_int_cb,
+		.ext = &stream_ext,
+	},
+	{/*END*/}
+};
+
+
+typedef struct {
+	const char *msg;
+	const char *expect;
+} string_case_t;
+
+static const string_case_t valid[] = {
+	{"TEXT \"hello world\"\n", "hello world"},
+	{"TEXT 'a\\'b'\n", "a'b"},
+	{"TEXT \"a\\\"b\\\\c\"\n", "a\"b\\c"},
+	{"TEXT \"\\\\\\\\\"\n", "\\\\"},
+	{"TEXT \"it's\"\n", "it's"}, // the other quote is a plain char
+	{"TEXT 'say \"hi\"'\n", "say \"hi\""},
+	{"TEXT \"a\\zb\"\n", "azb"}, // any char can be escaped
+	{"TEXT \"\"\n", ""},
+	{"TEXT \"\\\"\"\n", "\""},
+	{"TEXT \"0123456789abcdefghijklmnopqrstu\"\n", "0123456789abcdefghijklmnopqrstu"}, // fills sbuf
+};
+
+typedef struct {
+	const char *msg;
+	int16_t error;
+} string_error_t;
+
+static const string_error_t invalid[] = {
+	{"TEXT \"abc\n", E_CMD_STRING_DATA_ERROR},
+	{"TEXT \"abc\\\n", E_CMD_STRING_DATA_ERROR}, // newline after a backslash ends the message too
+	{"TEXT 'abc\\'\n", E_CMD_STRING_DATA_ERROR},
+	{"TEXT abc\n", E_CMD_INVALID_STRING_DATA},
+	{"TEXT \"0123456789abcdefghijklmnopqrstuv\"\n", E_EXE_TOO_MUCH_DATA}, // one more than fits
+};
+
+
+static void run_split(const char *msg, size_t at)
+{
+	called = false;
+	arg_len = 0;
+	got_len = 0;
+	pieces = 0;
+	memset(sbuf, 'X', sizeof(sbuf)); // terminated by the parser
+	test_feed_split(&session, msg, strlen(msg), at);
+}
+
+
+static void test_valid(void)
+{
+	for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+		const string_case_t *c = &valid[i];
+		const size_t len = strlen(c->expect);
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(called);
+			CHECK_EQ(arg_len, len);
+			CHECK_EQ(got_len, len);
+			CHECK(got_len == len && memcmp(got, c->expect, len) == 0);
+			CHECK(strcmp(sbuf, c->expect) == 0);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+}
+
+
+static void test_invalid(void)
+{
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		const string_error_t *c = &invalid[i];
+		test_case = c->msg;
+
+		for (size_t at = 0; at <= strlen(c->msg); at++) {
+			run_split(c->msg, at);
+
+			CHECK(!called);
+			CHECK_EQ(test_errors(&session), c->error);
+
+			// the next command is parsed normally
+			run_split("TEXT 'ok'\n", 0);
+			CHECK(called && arg_len == 2 && strcmp(sbuf, "ok") == 0);
+			CHECK_EQ(test_errors(&session), 0);
+		}
+	}
+}
+
+
+/** Long string without a buffer, passed on in runs between escapes and input pieces */
+static void test_stream(void)
+{
+	static char msg[300];
+	static char expect[256];
+	size_t m = 0, e = 0;
+
+	m += sprintf(&msg[m], "TEXT:STR \"");
+	for (int i = 0; i < 200; i++) {
+		const char c = (i % 17 == 5) ? '"' : (i % 23 == 7) ? '\\' : (char)('a' + i % 26);
+		if (c == '"' || c == '\\') msg[m++] = '\\';
+		msg[m++] = c;
+		expect[e++] = c;
+	}
+	m += sprintf(&msg[m], "\", -42\n");
+
+	test_case = "stream";
+
+	for (size_t at = 0; at <= m; at++) {
+		arg_int = 0;
+		run_split(msg, at);
+
+		CHECK(called);
+		CHECK_EQ(arg_len, e);
+		CHECK_EQ(got_len, e);
+		CHECK(got_len == e && memcmp(got, expect, e) == 0);
+		CHECK_EQ(arg_int, -42);
+		CHECK_EQ(test_errors(&session), 0);
+	}
+
+	// in one piece, plain runs are passed on whole - not char by char
+	run_split(msg, 0);
+	CHECK(pieces < (int) e / 2);
+
+	// byte by byte
+	called = false;
+	got_len = 0;
+	test_feed(&session, msg, m, 1);
+	CHECK(called);
+	CHECK(got_len == e && memcmp(got, expect, e) == 0);
+	CHECK_EQ(test_errors(&session), 0);
+}
+
+
+int main(void)
+{
+	scpi_init();
+	scpi_ctx_init(&session, NULL);
+
+	test_valid();
+	test_invalid();
+	test_stream();
+
+	return test_done("string");
+}